@@ -1,8 +1,23 @@
 
 #include <portaudio.h>
 
+// The ring buffer is not exported by the portaudio lib. Compile it in, the way pablio does.
+#include "portaudio/src/common/pa_ringbuffer.c"
+
 #include <limits.h>
 
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <semaphore.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AUDIO_MIX_SSE2
+#endif
+
 enum class ItemEndBehavior {
     NEXT_ELEM,
     REPEAT,
@@ -10,7 +25,8 @@ enum class ItemEndBehavior {
 
 /* // Assumed to be stereo at 44100 */
 struct SampleQueueItem {
-    short* samples;
+    void* samples;  // short or float, see format.
+    AudioSampleFormat format;
     int playback_position;
     int num_samples;
     ItemEndBehavior end_behavior;
@@ -27,6 +43,161 @@ struct AudioQueue {
 static AudioQueue g_audio_queues[k_num_audio_queues];
 static PaStream *g_stream;
 
+// Pull mode: a mixer thread renders ahead into a lock-free FIFO of stereo frames and the
+// callback only copies out of it. Mixing never runs on the realtime thread.
+static const int k_fifo_num_frames    = 2048;  // Power of two, required by PaUtilRingBuffer.
+static const int k_fifo_target_frames = 512;   // ~11ms at 44100. Render ahead up to this much.
+static const int k_mix_block_frames   = 128;
+
+// The callback posts this after every read, and the mixer waits on it to top the FIFO
+// back up. A callback takes half the target, so the mixer has to run between any two of
+// them. Sleeping can't promise that: on Windows a 1ms sleep is rounded up to the
+// scheduler tick, ~15.6ms, longer than the whole FIFO lasts.
+#if defined(_WIN32)
+static HANDLE g_mixer_wake;
+#else
+static sem_t  g_mixer_wake;
+#endif
+
+static AudioDriverMode    g_driver_mode;
+static PaUtilRingBuffer   g_fifo;
+static float              g_fifo_data[k_fifo_num_frames * 2];
+static std::thread        g_mixer_thread;
+static std::atomic<bool>  g_mixer_running;
+static std::atomic<int>   g_fifo_min_fill;  // Written by the callback.
+static std::atomic<int>   g_fifo_underruns; // Written by the callback.
+
+// 16 bit samples are scaled by 1/65536, which leaves 6dB of headroom for mixing. Float
+// samples get the same gain so both formats play at the same volume.
+static const float k_s16_mix_scale = 1.0f / (1 << 16);
+static const float k_f32_mix_scale = 0.5f;
+
+// Add num_frames stereo frames of in to out.
+static void mix_run(float* out, const short* in, int num_frames)
+{
+    int i = 0;
+#ifdef AUDIO_MIX_SSE2
+    const __m128 scale = _mm_set1_ps(k_s16_mix_scale);
+    for ( ; i + 4 <= num_frames; i += 4 ) {
+        // 4 frames, 8 samples. Sign extend to 32 bits by shifting down from the high half.
+        __m128i s16 = _mm_loadu_si128((const __m128i*)(in + 2*i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s16, s16), 16));
+        _mm_storeu_ps(out + 2*i,     _mm_add_ps(_mm_loadu_ps(out + 2*i),     _mm_mul_ps(lo, scale)));
+        _mm_storeu_ps(out + 2*i + 4, _mm_add_ps(_mm_loadu_ps(out + 2*i + 4), _mm_mul_ps(hi, scale)));
+    }
+#endif
+    for ( ; i < num_frames; ++i ) {
+        out[2*i]   += (float)in[2*i]   * k_s16_mix_scale;
+        out[2*i+1] += (float)in[2*i+1] * k_s16_mix_scale;
+    }
+}
+
+static void mix_run(float* out, const float* in, int num_frames)
+{
+    int i = 0;
+#ifdef AUDIO_MIX_SSE2
+    const __m128 scale = _mm_set1_ps(k_f32_mix_scale);
+    for ( ; i + 2 <= num_frames; i += 2 ) {
+        _mm_storeu_ps(out + 2*i, _mm_add_ps(_mm_loadu_ps(out + 2*i),
+                                            _mm_mul_ps(_mm_loadu_ps(in + 2*i), scale)));
+    }
+#endif
+    for ( ; i < num_frames; ++i ) {
+        out[2*i]   += in[2*i]   * k_f32_mix_scale;
+        out[2*i+1] += in[2*i+1] * k_f32_mix_scale;
+    }
+}
+
+// False where there are no unnamed semaphores, e.g. macOS.
+static bool mixer_wake_init()
+{
+#if defined(_WIN32)
+    g_mixer_wake = CreateSemaphoreA(NULL, 0, LONG_MAX, NULL);
+    return g_mixer_wake != NULL;
+#else
+    return sem_init(&g_mixer_wake, 0, 0) == 0;
+#endif
+}
+
+// Safe to call from the callback, it doesn't lock or allocate.
+static void mixer_wake_post()
+{
+#if defined(_WIN32)
+    ReleaseSemaphore(g_mixer_wake, 1, NULL);
+#else
+    sem_post(&g_mixer_wake);
+#endif
+}
+
+static void mixer_wake_wait()
+{
+#if defined(_WIN32)
+    if ( WaitForSingleObject(g_mixer_wake, INFINITE) != WAIT_OBJECT_0 ) {
+        die_gracefully("mixer wakeup failed\n");
+    }
+#else
+    while ( sem_wait(&g_mixer_wake) != 0 ) {
+        if ( errno != EINTR ) {
+            die_gracefully("mixer wakeup failed\n");
+        }
+        // Interrupted by a signal, keep waiting.
+    }
+#endif
+}
+
+static void mixer_wake_destroy()
+{
+#if defined(_WIN32)
+    CloseHandle(g_mixer_wake);
+#else
+    sem_destroy(&g_mixer_wake);
+#endif
+}
+
+// Mix all the audio queues into out (stereo, interleaved).
+static void audio_mix(float* out, unsigned long framesPerBuffer)
+{
+    memset(out, 0, framesPerBuffer * 2 * sizeof(float));
+
+    for (int aq_i = 0; aq_i < k_num_audio_queues; ++aq_i) {
+        auto& audio_queue = g_audio_queues[aq_i];
+        int i = 0;
+        // Mix in runs that go up to the end of the buffer or the end of the current item.
+        while ( i < (int)framesPerBuffer && audio_queue.tail != audio_queue.head ) {
+            SampleQueueItem* qitem = &audio_queue.items[audio_queue.head];
+            int frames_left = qitem->num_samples - qitem->playback_position / 2;
+            if ( frames_left <= 0 ) {
+                break;
+            }
+            int run = (int)framesPerBuffer - i;
+            if ( run > frames_left ) {
+                run = frames_left;
+            }
+            if ( qitem->format == AudioSampleFormat::F32 ) {
+                mix_run(out + 2*i, (float*)qitem->samples + qitem->playback_position, run);
+            } else {
+                mix_run(out + 2*i, (short*)qitem->samples + qitem->playback_position, run);
+            }
+            qitem->playback_position += 2*run;
+            i += run;
+
+            assert  (qitem->num_samples*2 >= qitem->playback_position);
+            if ( qitem->num_samples*2 == qitem->playback_position ) {
+                // Consumed one
+                switch (qitem->end_behavior) {
+                case ItemEndBehavior::NEXT_ELEM: {
+                    audio_queue.head = (audio_queue.head + 1) % k_max_audio_items_queued;
+                } break;
+                case ItemEndBehavior::REPEAT: {
+                    qitem->playback_position = 0;
+                } break;
+                }
+            }
+        }
+    }
+}
+
 /* This routine will be called by the PortAudio engine when audio is needed.
  ** It may called at interrupt level on some machines so don't do anything
  ** that could mess up the system like calling malloc() or free().
@@ -38,64 +209,76 @@ static int sgl_PA_Callback( const void *inputBuffer, void *outputBuffer,
                            void *userData )
 {
     float *out = (float*)outputBuffer;
-    unsigned int i;
     (void) inputBuffer; /* Prevent unused variable warning. */
 
-    // Clear out.
-    for( i=0; i < framesPerBuffer; i++ ) {
-        *(out + 2*i)     = 0;
-        *(out + 2*i + 1) = 0;
+    if ( g_driver_mode == AudioDriverMode::MIX_IN_CALLBACK ) {
+        audio_mix(out, framesPerBuffer);
+        return 0;
     }
 
-    for (int aq_i = 0; aq_i < k_num_audio_queues; ++aq_i) {
-        auto& audio_queue = g_audio_queues[aq_i];
-        if (audio_queue.tail != audio_queue.head) {
-            SampleQueueItem* qitem = &audio_queue.items[audio_queue.head];
-            for( i=0; i < framesPerBuffer; i++ ) {
-                if (qitem && qitem->num_samples) {
-                    auto* samples = qitem->samples;
-                    short left16  = samples[qitem->playback_position++];
-                    short right16 = samples[qitem->playback_position++];
-
-                    float left = (float)left16 / (1 << 16);
-                    float right = (float)right16 / (1 << 16);
-
-                    *(out + 2*i)   += left;
-                    *(out + 2*i+1) += right;
-
-                    assert  (qitem->num_samples*2 >= qitem->playback_position);
-                    if ( qitem->num_samples*2 == qitem->playback_position ) {
-                        // Consumed one
-                        switch (qitem->end_behavior) {
-                        case ItemEndBehavior::NEXT_ELEM: {
-                            audio_queue.head = (audio_queue.head + 1) % k_max_audio_items_queued;
-                            if (audio_queue.head == audio_queue.tail) {
-                                qitem = NULL;
-                            } else {
-                                qitem = &audio_queue.items[audio_queue.head];
-                            }
-                        } break;
-                        case ItemEndBehavior::REPEAT: {
-                            qitem->playback_position = 0;
-                        } break;
-                        }
-                    }
-                } else {
-                    *(out + 2*i)   = 0;
-                    *(out + 2*i+1) = 0;
-                }
+    int fill = (int)PaUtil_GetRingBufferReadAvailable(&g_fifo);
+    if ( fill < g_fifo_min_fill.load(std::memory_order_relaxed) ) {
+        g_fifo_min_fill.store(fill, std::memory_order_relaxed);
+    }
+
+    int num_read = (int)PaUtil_ReadRingBuffer(&g_fifo, out, (ring_buffer_size_t)framesPerBuffer);
+    if ( num_read < (int)framesPerBuffer ) {
+        // Mixer thread fell behind. Play silence for the rest.
+        memset(out + 2*num_read, 0, (framesPerBuffer - num_read) * 2 * sizeof(float));
+        g_fifo_underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    mixer_wake_post();
+    return 0;
+}
+
+// Top up the FIFO to the target fill level. Mixes straight into the ring buffer memory.
+static void audio_render_ahead()
+{
+    int fill = (int)PaUtil_GetRingBufferReadAvailable(&g_fifo);
+    while ( fill < k_fifo_target_frames ) {
+        void* data[2];
+        ring_buffer_size_t sizes[2];
+        PaUtil_GetRingBufferWriteRegions(&g_fifo, k_mix_block_frames,
+                                         &data[0], &sizes[0], &data[1], &sizes[1]);
+        if ( sizes[0] + sizes[1] == 0 ) {
+            break;
+        }
+        for ( int r = 0; r < 2; ++r ) {
+            if ( sizes[r] ) {
+                audio_mix((float*)data[r], sizes[r]);
             }
         }
+        PaUtil_AdvanceRingBufferWriteIndex(&g_fifo, sizes[0] + sizes[1]);
+        fill += sizes[0] + sizes[1];
     }
-end:
-    return 0;
 }
 
-void audio_push_sample(int queue_i, short* samples, int num_samples, int n_loops)
+static void audio_mixer_thread()
+{
+    while ( g_mixer_running.load() ) {
+        audio_render_ahead();
+        mixer_wake_wait();
+    }
+}
+
+AudioFifoStats audio_fifo_stats()
+{
+    AudioFifoStats stats = {};
+    if ( g_driver_mode == AudioDriverMode::PULL ) {
+        stats.fill_frames     = (int)PaUtil_GetRingBufferReadAvailable(&g_fifo);
+        stats.min_fill_frames = g_fifo_min_fill.load();
+        stats.target_frames   = k_fifo_target_frames;
+        stats.underruns       = g_fifo_underruns.load();
+    }
+    return stats;
+}
+
+static void audio_push(int queue_i, void* samples, AudioSampleFormat format, int num_samples, int n_loops)
 {
     auto add_elem = [&](ItemEndBehavior b) {
         SampleQueueItem it;
         it.samples = samples;
+        it.format = format;
         it.num_samples = num_samples;
         it.playback_position = 0;
         it.end_behavior = b;
@@ -112,10 +295,37 @@ void audio_push_sample(int queue_i, short* samples, int num_samples, int n_loops
     }
 }
 
-void audio_init()
+void audio_push_sample(int queue_i, short* samples, int num_samples, int n_loops)
+{
+    audio_push(queue_i, samples, AudioSampleFormat::S16, num_samples, n_loops);
+}
+
+void audio_push_sample(int queue_i, float* samples, int num_samples, int n_loops)
+{
+    audio_push(queue_i, samples, AudioSampleFormat::F32, num_samples, n_loops);
+}
+
+void audio_init(AudioDriverMode mode)
 {
     PaError err;
 
+    if ( mode == AudioDriverMode::PULL && !mixer_wake_init() ) {
+        printf("[DEBUG] No semaphore to wake the mixer, mixing in the callback.\n");
+        mode = AudioDriverMode::MIX_IN_CALLBACK;
+    }
+    g_driver_mode = mode;
+    if ( mode == AudioDriverMode::PULL ) {
+        if ( PaUtil_InitializeRingBuffer(&g_fifo, 2 * sizeof(float), k_fifo_num_frames, g_fifo_data) < 0 ) {
+            die_gracefully("audio fifo size is not a power of two\n");
+        }
+        g_fifo_min_fill = k_fifo_num_frames;
+        g_fifo_underruns = 0;
+        // Prime the FIFO so the first callbacks don't count as underruns.
+        audio_render_ahead();
+        g_mixer_running = true;
+        g_mixer_thread = std::thread(audio_mixer_thread);
+    }
+
     err = Pa_Initialize();
     if( err != paNoError ) goto error;
 
@@ -151,4 +361,15 @@ void audio_deinit()
     if( err != paNoError ) goto error;
 error:
     Pa_Terminate();
+
+    if ( g_driver_mode == AudioDriverMode::PULL ) {
+        g_mixer_running = false;
+        mixer_wake_post();
+        g_mixer_thread.join();
+        mixer_wake_destroy();
+
+        AudioFifoStats stats = audio_fifo_stats();
+        printf("[DEBUG] Audio FIFO: min fill %d of %d target frames, %d underruns.\n",
+               stats.min_fill_frames, stats.target_frames, stats.underruns);
+    }
 }
@@ -1,5 +1,26 @@
 #pragma once
 
-void audio_init();
+enum class AudioDriverMode {
+    MIX_IN_CALLBACK,  // Mix inside the PortAudio callback.
+    PULL,             // Mix on a separate thread into a FIFO, the callback only copies.
+};
+
+// Fill level of the pull mode FIFO, in stereo frames. All zeros in MIX_IN_CALLBACK mode.
+struct AudioFifoStats {
+    int fill_frames;
+    int min_fill_frames;  // Lowest fill seen by the callback since audio_init.
+    int target_frames;
+    int underruns;        // Callbacks that found less than a buffer's worth.
+};
+
+// How a pushed sample is stored. Both are stereo, interleaved, at 44100.
+enum class AudioSampleFormat {
+    S16,  // Converted to float as it is mixed.
+    F32,  // Mixed as is. Twice the memory, no conversion.
+};
+
+void audio_init(AudioDriverMode mode = AudioDriverMode::PULL);
 void audio_push_sample(int queue_i, short* samples, int num_samples, int n_loops = 1);
+void audio_push_sample(int queue_i, float* samples, int num_samples, int n_loops = 1);
+AudioFifoStats audio_fifo_stats();
 void audio_deinit();
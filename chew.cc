@@ -13,12 +13,14 @@
  */
 
 #include <atomic>
+#include <chrono>
 #include <thread>
 
 #include <math.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #ifdef _WIN32
@@ -35,16 +37,26 @@ static void die_gracefully(char* msg);
 #define SGL_GL_HELPERS_IMPLEMENTATION
 #include "gl_helpers.h"
 
+#include "shader_cache.h"
+
 #include "audio.h"
 
+#include "pack.h"
+
 #include "text.h"
 
 #include "vector.hh"
 
+#include "soft_render.h"
+
+#include "frame_capture.h"
+
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
+#include "texture_cache.h"  // Needs stbi_parallel.
+
 #include "stb/stb_vorbis.c"
 
 #include "glfw/glfw3.h"
@@ -87,7 +99,8 @@ struct AudioInfo {
     int num_channels;
     int rate;
     int num_samples;
-    short* samples;
+    AudioSampleFormat format;
+    void* samples;  // short or float, by format.
 };
 
 
@@ -126,6 +139,7 @@ struct EatableQueue {
 
 
 static GLuint quad_program;
+static ShaderProgram g_quad_shader;
 
 static int g_input_flags;
 
@@ -178,8 +192,47 @@ const float GameState::rhythm_period = 0.28571428;
 
 static ImageInfo    g_image_info[ImageIndex::COUNT];
 static AudioInfo    g_audio_items[AudioIndex::COUNT];
+static AssetPack    g_pack;  // Empty when there is no chew.pack, assets are read from loose files then.
 static int          g_enabled_tex2d;
 
+// CHEW_RENDERER=soft draws the sprites on the CPU and shows the frame as one
+// texture. Text still goes through GL.
+enum class RenderBackend {
+    GL,
+    SOFTWARE,
+};
+
+static RenderBackend g_render_backend = RenderBackend::GL;
+static GLuint        g_soft_frame_tex;
+
+// CHEW_CAPTURE=<target> captures every frame, see frame_capture.h for targets.
+static bool       g_capturing;
+static GLReadback g_readback;
+
+// Retained rendering, on unless CHEW_RETAINED=0.
+//
+// The insides, jaw and head top only change when the jaw moves, a few frames
+// after each chew. They are drawn into the head layer then, and the layer goes
+// on screen as one quad every frame. The head's scale changes every frame, it
+// is applied to that quad. The layer covers k_head_layer_extent screens each
+// way so a shrunk head still fits, and holds premultiplied alpha so it blends
+// the way the sprites in it would.
+//
+// Nothing on the dead screen moves but the score, so once it is up frames are
+// neither drawn nor presented until the score changes or the window needs a
+// repaint. Not while capturing, which wants every frame.
+static const float k_head_layer_extent = 2;
+static const int   k_idle_frame_ms     = 30;  // How often input is checked meanwhile.
+
+static bool           g_retained;
+static GLRenderTarget g_head_layer;
+static bool           g_head_layer_valid;
+static float          g_head_layer_jaw_vpos;
+static float          g_head_layer_jaw_angle;
+static int            g_head_layer_redraws;
+static bool           g_head_layer_resized;  // The framebuffer changed size, make it again.
+static bool           g_needs_present;
+
 static const float k_jaw_up_position   = -0.5;
 static const float k_jaw_down_position = -1.0;
 static const float kPi                 = 3.141592654f;
@@ -188,6 +241,10 @@ static const float kPi                 = 3.141592654f;
 static float g_jaw_vpos = k_jaw_down_position;
 static float g_jaw_angle;
 
+static const float k_jaw_width         = 0.4f;
+static const float k_jaw_height        = 0.7f;
+static const float k_pendulum_height   = 0.3f;
+
 
 // Immediate mode scaling
 static v2f      g_scale_center;
@@ -234,6 +291,16 @@ static void sleep_ms(int ms)
 
 static void chew_input(ChewDir dir);
 
+static void refresh_callback(GLFWwindow* win)
+{
+    g_needs_present = true;  // Uncovered or resized, what was presented is gone.
+}
+
+static void framebuffer_size_callback(GLFWwindow* win, int width, int height)
+{
+    g_head_layer_resized = true;
+}
+
 // Key callback
 static void key_callback(GLFWwindow* win, int key, int scancode, int action, int mods)
 {
@@ -255,12 +322,51 @@ static void key_callback(GLFWwindow* win, int key, int scancode, int action, int
     }
 }
 
+static const int k_max_image_tasks = 8;
+
+static stbi_parallel g_image_parallel;
+
+// Task runner for stbi_load_from_memory_parallel. Task 0 runs on the calling
+// thread, the rest get a thread each.
+static void run_image_tasks(void* user, void (*task)(void* task_data, int i), void* task_data, int count)
+{
+    std::thread workers[k_max_image_tasks];
+    int num_workers = count - 1 < k_max_image_tasks ? count - 1 : k_max_image_tasks;
+    for (int i = 0; i < num_workers; ++i) {
+        workers[i] = std::thread(task, task_data, i + 1);
+    }
+    task(task_data, 0);
+    for (int i = num_workers + 1; i < count; ++i) {
+        task(task_data, i);
+    }
+    for (int i = 0; i < num_workers; ++i) {
+        workers[i].join();
+    }
+}
+
 static void load_image(ImageIndex idx, char* fname)
 {
     int i = (int)idx;
 
     int w,h,num_components;
-    uint8_t* data = stbi_load(fname, &w, &h, &num_components, 0);
+    uint8_t* data;
+    const PackEntry* entry = pack_find(&g_pack, fname);
+    if (entry && entry->payload == PackPayload::RGBA8) {
+        // Decoded by the packer. bits is never written or freed, it can point into the mapping.
+        w = entry->params[0];
+        h = entry->params[1];
+        num_components = 4;
+        data = (uint8_t*)pack_data(&g_pack, entry);
+    } else if (entry) {
+        data = stbi_load_from_memory_parallel(pack_data(&g_pack, entry), (int)entry->size,
+                                              &w, &h, &num_components, 0, &g_image_parallel);
+    } else {
+        TexCacheResult cache_result;
+        data = texcache_load(fname, &w, &h, &num_components, &cache_result, &g_image_parallel);
+        if (cache_result == TexCacheResult::MISS) {
+            printf("[DEBUG] Decoded %s, cached for next time.\n", fname);
+        }
+    }
 
     if (!data) {
         die_gracefully("Could not read file.");
@@ -297,6 +403,251 @@ static void load_image(ImageIndex idx, char* fname)
     }
 }
 
+// Ogg decoding is split across threads. Each worker opens its own decoder over
+// the file in memory, out of its slice of one arena, seeks to the start of its
+// chunk and decodes to the end of it. The decoder numbers samples by page
+// granule, which can disagree with a plain count by a few samples, so each
+// worker crops its frames by the offsets the decoder reports and the chunks
+// are packed together afterwards.
+static const int k_max_decode_workers = 16;
+static const int k_min_decode_chunk_samples = 44100 * 2;
+
+template <typename T>
+struct VorbisDecodeChunk {
+    unsigned int begin;     // Sample offsets, as stb_vorbis_seek counts them.
+    unsigned int end;
+    const stb_vorbis_seek_entry* seek_table;  // Shared, so workers don't probe the file.
+    int seek_table_count;
+    stb_vorbis_alloc arena;
+    T* out;
+    int capacity;           // In samples per channel
+    int count;
+    bool ok;
+};
+
+// Decode the next frame, interleaved, and return its length. dst must have
+// room for a whole frame.
+static int get_frame_interleaved(stb_vorbis* v, int num_channels, short* dst, int capacity)
+{
+    return stb_vorbis_get_frame_short_interleaved(v, num_channels, dst, capacity * num_channels);
+}
+
+static int get_frame_interleaved(stb_vorbis* v, int num_channels, float* dst, int capacity)
+{
+    float** frame;
+    int n = stb_vorbis_get_frame_float(v, NULL, &frame);
+    assert (n <= capacity);
+    for (int c = 0; c < num_channels; ++c) {
+        for (int i = 0; i < n; ++i) {
+            dst[i * num_channels + c] = frame[c][i];
+        }
+    }
+    return n;
+}
+
+template <typename T>
+static void decode_vorbis_chunk(const unsigned char* data, int len, VorbisDecodeChunk<T>* chunk)
+{
+    int error;
+    stb_vorbis* v = stb_vorbis_open_memory(data, len, &error, &chunk->arena);
+    if (!v) {
+        return;
+    }
+    stb_vorbis_info info = stb_vorbis_get_info(v);
+    int num_channels = info.channels;
+    if (chunk->seek_table) {
+        stb_vorbis_set_seek_table(v, chunk->seek_table, chunk->seek_table_count);
+    }
+
+    // Seeking fails where a page granule jumps past the target. Start a
+    // little earlier then, anything before begin gets dropped anyway.
+    unsigned int start = chunk->begin;
+    while (start > 0 && !stb_vorbis_seek_frame(v, start)) {
+        start = (start > (unsigned int)info.max_frame_size) ? start - info.max_frame_size : 0;
+        if (start == 0) {
+            stb_vorbis_seek_start(v);
+        }
+    }
+
+    // Decode a frame at a time so the offset after each one is exact.
+    while (chunk->capacity - chunk->count >= info.max_frame_size) {
+        T* dst = chunk->out + chunk->count * num_channels;
+        int n = get_frame_interleaved(v, num_channels, dst, chunk->capacity - chunk->count);
+        if (n == 0) {
+            chunk->ok = true;  // End of stream.
+            break;
+        }
+        // Take the frame position from the offset after it. The decoder
+        // resyncs to the granule when it finishes a page.
+        int frame_end = stb_vorbis_get_sample_offset(v);
+        int frame_start = frame_end - n;
+        int64_t first = (int64_t)chunk->begin - frame_start;
+        int64_t last = (int64_t)chunk->end - frame_start;
+        if (first < 0) {
+            first = 0;
+        }
+        if (last > n) {
+            last = n;
+        }
+        if (last > first) {
+            if (first > 0) {
+                memmove(dst, dst + first * num_channels, (last - first) * num_channels * sizeof(T));
+            }
+            chunk->count += (int)(last - first);
+        }
+        if ((unsigned int)frame_end >= chunk->end) {
+            chunk->ok = true;
+            break;
+        }
+    }
+    stb_vorbis_close(v);
+}
+
+// Same contract as stb_vorbis_decode_memory, plus sample_padding samples of
+// silence at the end of the buffer which are not included in the count. T is
+// short or float.
+template <typename T>
+static int decode_vorbis_parallel_memory(const unsigned char* data, int len, int sample_padding,
+                                         int* out_num_channels, int* out_sample_rate, T** out_samples,
+                                         int num_workers = 0)
+{
+    int error;
+    stb_vorbis* v = stb_vorbis_open_memory(data, len, &error, NULL);
+    if (!v) {
+        return -1;
+    }
+    stb_vorbis_info info = stb_vorbis_get_info(v);
+    int num_channels = info.channels;
+    int seek_table_count = stb_vorbis_build_seek_table(v);
+    const stb_vorbis_seek_entry* seek_table = stb_vorbis_get_seek_table(v, NULL);
+    int stream_length = (int)stb_vorbis_stream_length_in_samples(v);
+
+    if (num_workers == 0) {
+        num_workers = (int)std::thread::hardware_concurrency();
+        if (num_workers > stream_length / k_min_decode_chunk_samples) {
+            num_workers = stream_length / k_min_decode_chunk_samples;
+        }
+        if (num_workers > k_max_decode_workers) {
+            num_workers = k_max_decode_workers;
+        }
+        if (num_workers < 1) {
+            num_workers = 1;
+        }
+    }
+
+    // Every chunk gets some slack, a worker writes whole frames and its count
+    // can drift from the granules by a few samples.
+    int slack = 2 * info.max_frame_size;
+    size_t buffer_samples = (size_t)stream_length + num_workers * slack + sample_padding;
+    T* samples = (T*)malloc(buffer_samples * num_channels * sizeof(T));
+
+    // The decoders allocate nothing once they are given their memory, so
+    // the workers don't contend on the heap.
+    int arena_slice = stb_vorbis_memory_required(data, len, &error);
+    arena_slice += (seek_table_count * (int)sizeof(stb_vorbis_seek_entry) + 3) & ~3;
+    char* arena = (char*)malloc((size_t)arena_slice * num_workers);
+
+    if (!samples || !arena) {
+        stb_vorbis_close(v);
+        free(samples);
+        free(arena);
+        return -1;
+    }
+
+    VorbisDecodeChunk<T> chunks[k_max_decode_workers] = {};
+    std::thread workers[k_max_decode_workers];
+    for (int w = 0; w < num_workers; ++w) {
+        VorbisDecodeChunk<T>* chunk = &chunks[w];
+        chunk->begin = (unsigned int)((int64_t)stream_length * w / num_workers);
+        chunk->end = (unsigned int)((int64_t)stream_length * (w + 1) / num_workers);
+        chunk->seek_table = seek_table;
+        chunk->seek_table_count = seek_table_count;
+        chunk->arena.alloc_buffer = arena + (size_t)arena_slice * w;
+        chunk->arena.alloc_buffer_length_in_bytes = arena_slice;
+        chunk->out = samples + (chunk->begin + w * slack) * num_channels;
+        chunk->capacity = (int)(chunk->end - chunk->begin) + slack;
+        if (w == num_workers - 1) {
+            chunk->end = ~0U;  // Through to the end of the stream, whatever the granule says.
+        }
+        workers[w] = std::thread(decode_vorbis_chunk<T>, data, len, chunk);
+    }
+
+    int num_samples = 0;
+    for (int w = 0; w < num_workers; ++w) {
+        workers[w].join();
+        if (!chunks[w].ok) {
+            num_samples = -1;
+        }
+        if (num_samples >= 0) {
+            // Chunks only ever move towards the start of the buffer.
+            memmove(samples + num_samples * num_channels, chunks[w].out,
+                    chunks[w].count * num_channels * sizeof(T));
+            num_samples += chunks[w].count;
+        }
+    }
+    stb_vorbis_close(v);
+    free(arena);
+
+    if (num_samples < 0) {
+        free(samples);
+        if (num_workers > 1) {
+            return decode_vorbis_parallel_memory(data, len, sample_padding,
+                                                 out_num_channels, out_sample_rate, out_samples, 1);
+        }
+        return -1;
+    }
+
+    memset(samples + num_samples * num_channels, 0, sample_padding * num_channels * sizeof(T));
+
+    *out_num_channels = num_channels;
+    *out_sample_rate = info.sample_rate;
+    *out_samples = samples;
+    return num_samples;
+}
+
+// Same, for loose files. The decoders all share the file in memory.
+template <typename T>
+static int decode_vorbis_parallel(char* fname, int sample_padding,
+                                  int* out_num_channels, int* out_sample_rate, T** out_samples)
+{
+    FILE* fd = fopen(fname, "rb");
+    if (!fd) {
+        return -1;
+    }
+    fseek(fd, 0, SEEK_END);
+    int len = (int)ftell(fd);
+    fseek(fd, 0, SEEK_SET);
+    unsigned char* data = (unsigned char*)malloc(len);
+    if (!data || fread(data, 1, len, fd) != (size_t)len) {
+        fclose(fd);
+        free(data);
+        return -1;
+    }
+    fclose(fd);
+
+    int num_samples = decode_vorbis_parallel_memory(data, len, sample_padding,
+                                                    out_num_channels, out_sample_rate, out_samples);
+    free(data);
+    return num_samples;
+}
+
+// Decode an ogg from the pack if it has it, from the loose file otherwise.
+template <typename T>
+static int decode_vorbis_asset(char* fname, int sample_padding,
+                               int* out_num_channels, int* out_sample_rate, T** out_samples)
+{
+    const PackEntry* entry = pack_find(&g_pack, fname);
+    if (entry && entry->payload == PackPayload::FILE) {
+        return decode_vorbis_parallel_memory(pack_data(&g_pack, entry), (int)entry->size, sample_padding,
+                                             out_num_channels, out_sample_rate, out_samples);
+    }
+    return decode_vorbis_parallel(fname, sample_padding, out_num_channels, out_sample_rate, out_samples);
+}
+
+// F32 keeps the decoder's output as is and the mixer only adds it up. S16 is
+// half the memory, and the mixer converts it back to float as it plays.
+static const AudioSampleFormat k_audio_sample_format = AudioSampleFormat::F32;
+
 static void load_audio(AudioIndex idx, char* fname, int sample_padding = 0)
 {
     int i = (int)idx;
@@ -305,31 +656,47 @@ static void load_audio(AudioIndex idx, char* fname, int sample_padding = 0)
     }
 
     int num_channels, sample_rate;
-    short* samples;
-
-    int num_samples = stb_vorbis_decode_filename(fname, &num_channels, &sample_rate, &samples);
+    void* samples;
+    int num_samples;
+    AudioSampleFormat format = k_audio_sample_format;
+
+    const PackEntry* entry = pack_find(&g_pack, fname);
+    if (entry && (entry->payload == PackPayload::PCM_S16 || entry->payload == PackPayload::PCM_F32)) {
+        // Decoded by the packer, in whichever format it was told. The mixer takes either.
+        format = entry->payload == PackPayload::PCM_F32 ? AudioSampleFormat::F32 : AudioSampleFormat::S16;
+        num_channels = entry->params[0];
+        sample_rate = entry->params[1];
+        num_samples = entry->params[2];
+        if (sample_padding == 0) {
+            // Played straight out of the mapping.
+            samples = (void*)pack_data(&g_pack, entry);
+        } else {
+            size_t frame_size = (size_t)entry->size / (num_samples > 0 ? num_samples : 1);
+            samples = malloc((size_t)entry->size + sample_padding * frame_size);
+            if (samples) {
+                memcpy(samples, pack_data(&g_pack, entry), (size_t)entry->size);
+                memset((uint8_t*)samples + entry->size, 0, sample_padding * frame_size);
+            } else {
+                num_samples = -1;
+            }
+        }
+    } else if (format == AudioSampleFormat::F32) {
+        num_samples = decode_vorbis_asset(fname, sample_padding, &num_channels, &sample_rate, (float**)&samples);
+    } else {
+        num_samples = decode_vorbis_asset(fname, sample_padding, &num_channels, &sample_rate, (short**)&samples);
+    }
     if (num_samples == -1)  {
         printf("trying to open file %s\n", fname);
         die_gracefully("stb vorbis could not open or decode");
     }
-
-    if ( sample_padding ) {
-        size_t new_size = (num_samples*num_channels + sample_padding*num_channels) * sizeof(short);
-        short* new_samples = (short*)calloc(1, new_size);
-        if (!new_samples) {
-            die_gracefully("could not allocate memory for sample padding ");
-        }
-        memcpy(new_samples, samples, num_samples*num_channels * sizeof(short));
-        free(samples);
-        samples = new_samples;
-        num_samples = num_samples + sample_padding;
-    }
+    num_samples += sample_padding;
 
     // These assumptions might change later, so data structures still keep the info..
     assert ( num_channels == 2 );
     assert ( sample_rate == 44100 );
 
     // We are good to go.
+    g_audio_items[i].format = format;
     g_audio_items[i].samples = samples;
     g_audio_items[i].rate = sample_rate;
     g_audio_items[i].num_channels = num_channels;
@@ -345,17 +712,23 @@ static void push_audio(int queue_i, AudioIndex idx, AudioOpts opts = AudioOpts::
         die_gracefully("audio not loaded.");
     }
 
+    int n_loops = 1;
     switch ( opts ) {
     case AudioOpts::NOTHING:
-        audio_push_sample(queue_i, ai->samples, ai->num_samples);
         break;
     case AudioOpts::LOOP_FOREVER:
-        audio_push_sample(queue_i, ai->samples, ai->num_samples, -1);
+        n_loops = -1;
         break;
     default:
         assert (!"not implemented\n");
     }
 
+    if (ai->format == AudioSampleFormat::F32) {
+        audio_push_sample(queue_i, (float*)ai->samples, ai->num_samples, n_loops);
+    } else {
+        audio_push_sample(queue_i, (short*)ai->samples, ai->num_samples, n_loops);
+    }
+
 }
 
 
@@ -371,32 +744,49 @@ static void enable_image(ImageIndex idx)
 //  |        |
 //  b--------c
 
-static void draw_sprite(ImageIndex idx,
-                        v2f a, v2f b, v2f c, v2f d)
-{
-    enable_image(idx);
+// Images are top row first, render targets bottom row first.
+static const v2f k_sprite_uvs[4] = { {0, 1}, {0, 0}, {1, 0}, {1, 1} };
+static const v2f k_target_uvs[4] = { {0, 0}, {0, 1}, {1, 1}, {1, 0} };
 
-    a -= g_scale_center;
-    a = a * g_scale_factor;
-    b -= g_scale_center;
-    b = b * g_scale_factor;
-    c -= g_scale_center;
-    c = c * g_scale_factor;
-    d -= g_scale_center;
-    d = d * g_scale_factor;
+static v2f scaled(v2f p)
+{
+    p -= g_scale_center;
+    return p * g_scale_factor;
+}
 
+static void draw_quad(v2f a, v2f b, v2f c, v2f d, const v2f uvs[4])
+{
     glBegin(GL_QUADS);
-    glTexCoord2f(0, 1);
+    glTexCoord2f(uvs[0].x, uvs[0].y);
     glVertex3f(a.x,a.y,0);
-    glTexCoord2f(0, 0);
+    glTexCoord2f(uvs[1].x, uvs[1].y);
     glVertex3f(b.x,b.y,0);
-    glTexCoord2f(1, 0);
+    glTexCoord2f(uvs[2].x, uvs[2].y);
     glVertex3f(c.x,c.y,0);
-    glTexCoord2f(1, 1);
+    glTexCoord2f(uvs[3].x, uvs[3].y);
     glVertex3f(d.x,d.y,0);
     glEnd();
 }
 
+static void draw_sprite(ImageIndex idx,
+                        v2f a, v2f b, v2f c, v2f d)
+{
+    a = scaled(a);
+    b = scaled(b);
+    c = scaled(c);
+    d = scaled(d);
+
+    if (g_render_backend == RenderBackend::SOFTWARE) {
+        const ImageInfo* info = &g_image_info[(int)idx];
+        v2f pos[4] = { a, b, c, d };
+        soft_draw_quad(info->bits, info->w, info->h, pos, k_sprite_uvs);
+        return;
+    }
+
+    enable_image(idx);
+    draw_quad(a, b, c, d, k_sprite_uvs);
+}
+
 static void draw_square_sprite(ImageIndex idx, float x, float y, float w)
 {
     float ar = (float)g_win_width / g_win_height;
@@ -407,6 +797,18 @@ static void draw_square_sprite(ImageIndex idx, float x, float y, float w)
                 {x + w, y - ar*w});
 }
 
+// Rasterizes the queued sprites and covers the window with them.
+static void present_soft_frame()
+{
+    const uint8_t* pixels = soft_end_frame();
+    GLCHK (glBindTexture(GL_TEXTURE_2D, g_soft_frame_tex));
+    GLCHK (glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, g_win_width, g_win_height,
+                           GL_RGBA, GL_UNSIGNED_BYTE, pixels));
+    glDisable(GL_BLEND);
+    draw_quad({-1, -1}, {-1, 1}, {1, 1}, {1, -1}, k_sprite_uvs);
+    glEnable(GL_BLEND);
+}
+
 static bool collide_squares(float x1, float y1, float w1,
                             float x2, float y2, float w2)
 {
@@ -649,6 +1051,17 @@ static void game_tick(double dt, GameState* gs)
 
 }
 
+// Makes the quad program current and points its sampler at texture unit 0.
+static void use_quad_program()
+{
+    quad_program = g_quad_shader.program;
+    GLCHK (glUseProgramObjectARB(quad_program));
+
+    GLint sampler_loc = glGetUniformLocationARB(quad_program, "raster_buffer");
+    assert (sampler_loc >= 0);
+    GLCHK (glUniform1iARB(sampler_loc, 0 /*GL_TEXTURE0*/));
+}
+
 static void render_score(GameState* gs, bool with_multiplier = true)
 {
     // Text test
@@ -667,45 +1080,27 @@ static void render_score(GameState* gs, bool with_multiplier = true)
     //glEnable(GL_BLEND);
 }
 
-static void game_render(double dt, GameState* gs)
+// The head scales around this.
+static v2f head_center()
 {
-    if (gs->dead) {
-        draw_sprite(ImageIndex::DEAD_SCREEN,
-                    {-1, -1},
-                    {-1, 1},
-                    {1, 1},
-                    {1, -1});
-        render_score(gs, false);
-        return;
-    }
-
-    auto to_positive = [](float f) -> float {
-        float res = (f + 1)/2;
-        return res;
-    };
+    return { 0, g_jaw_vpos + (k_jaw_height / 2) + k_pendulum_height };
+}
 
+// Insides, jaw and head top, scaled by whatever begin_scale says.
+static void draw_head()
+{
     float left_height  = g_jaw_vpos;
     float right_height = g_jaw_vpos;
 
-    float jaw_width = 0.4;
-    float jaw_height = 0.7;
+    float headtop_width = k_jaw_width * 1.1;
+    float headtop_height = k_jaw_height * 0.8;
 
-    float headtop_width = jaw_width * 1.1;
-    float headtop_height = jaw_height * 0.8;
-
-
-    v2f a = {-jaw_width, left_height};
-    v2f b = {-jaw_width, left_height + jaw_height};
-    v2f c = {jaw_width, right_height + jaw_height};
-    v2f d = {jaw_width, right_height};
-
-
-    float pendulum_height = 0.3f;
-
-    ////////////////////////////////////////////////////////////
-    // Render face
+    v2f a = {-k_jaw_width, left_height};
+    v2f b = {-k_jaw_width, left_height + k_jaw_height};
+    v2f c = {k_jaw_width, right_height + k_jaw_height};
+    v2f d = {k_jaw_width, right_height};
 
-    v2f center = { 0, g_jaw_vpos + (jaw_height / 2) + pendulum_height };
+    v2f center = head_center();
 
     auto rotated = [&](v2f p, float a) -> v2f {
         v2f res;
@@ -725,13 +1120,11 @@ static void game_render(double dt, GameState* gs)
         return res;
     };
 
-    begin_scale(center, gs->head_scale);
-
     draw_sprite(ImageIndex::INSIDES,
-                {-0.8f * jaw_width, g_jaw_vpos +0.7f +0.7f*jaw_height },
-                {-0.8f * jaw_width, g_jaw_vpos +0.7f -0.7f*jaw_height },
-                {0.8f * jaw_width,  g_jaw_vpos +0.7f -0.7f*jaw_height },
-                {0.8f * jaw_width,  g_jaw_vpos +0.7f +0.7f*jaw_height });
+                {-0.8f * k_jaw_width, g_jaw_vpos +0.7f +0.7f*k_jaw_height },
+                {-0.8f * k_jaw_width, g_jaw_vpos +0.7f -0.7f*k_jaw_height },
+                {0.8f * k_jaw_width,  g_jaw_vpos +0.7f -0.7f*k_jaw_height },
+                {0.8f * k_jaw_width,  g_jaw_vpos +0.7f +0.7f*k_jaw_height });
 
     draw_sprite(ImageIndex::JAW,
                 rotated(a, g_jaw_angle), rotated(b, g_jaw_angle), rotated(c, g_jaw_angle), rotated(d, g_jaw_angle));
@@ -741,8 +1134,104 @@ static void game_render(double dt, GameState* gs)
                 {-headtop_width, 0.45f +  headtop_height},
                 {headtop_width,  0.45f +  headtop_height},
                 {headtop_width,  0.45f + -headtop_height});
+}
+
+// Makes the head layer for the framebuffer's current size. When that fails the
+// head is drawn directly, as without framebuffer objects.
+static void create_head_layer(GLFWwindow* window)
+{
+    gl_target_destroy(&g_head_layer);
+    g_head_layer_valid = false;
+
+    int fb_width, fb_height;
+    glfwGetFramebufferSize(window, &fb_width, &fb_height);
+    if (fb_width <= 0 || fb_height <= 0) {
+        return;  // Minimized.
+    }
+    float w = fb_width * k_head_layer_extent;
+    float h = fb_height * k_head_layer_extent;
+    // Past the limit the layer has fewer texels than pixels, the head gets a bit softer.
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    float largest = w > h ? w : h;
+    if (max_size > 0 && largest > max_size) {
+        w = w * max_size / largest;
+        h = h * max_size / largest;
+    }
+    if (!gl_target_init(&g_head_layer, (int)w, (int)h)) {
+        printf("[DEBUG] Could not make a %dx%d head layer, the head is drawn every frame.\n", (int)w, (int)h);
+    }
+}
+
+// Needs the context, so it goes before the window does.
+static void stop_capture()
+{
+    if (!g_capturing) {
+        return;
+    }
+    CaptureStats stats = capture_close();
+    printf("[DEBUG] Captured %d frames, %d written, %d dropped.\n",
+           stats.frames, stats.written, stats.dropped);
+    gl_readback_destroy(&g_readback);
+    g_capturing = false;
+}
 
+static void render_head(GameState* gs)
+{
+    v2f center = head_center();
+    if (!g_head_layer.fbo) {
+        begin_scale(center, gs->head_scale);
+        draw_head();
+        end_scale();
+        return;
+    }
+
+    if (!g_head_layer_valid ||
+        g_head_layer_jaw_vpos != g_jaw_vpos || g_head_layer_jaw_angle != g_jaw_angle) {
+        gl_target_begin(&g_head_layer);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glClearColor(1, 1, 1, 1);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        begin_scale({0, 0}, 1 / k_head_layer_extent);
+        draw_head();
+        end_scale();
+        gl_target_end(&g_head_layer);
+        g_head_layer_valid = true;
+        g_head_layer_jaw_vpos = g_jaw_vpos;
+        g_head_layer_jaw_angle = g_jaw_angle;
+        ++g_head_layer_redraws;
+    }
+
+    float e = k_head_layer_extent;
+    begin_scale(center, gs->head_scale);
+    GLCHK (glBindTexture(GL_TEXTURE_2D, g_head_layer.tex));
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    draw_quad(scaled({-e, -e}), scaled({-e, e}), scaled({e, e}), scaled({e, -e}), k_target_uvs);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     end_scale();
+}
+
+static void game_render(double dt, GameState* gs)
+{
+    if (gs->dead) {
+        draw_sprite(ImageIndex::DEAD_SCREEN,
+                    {-1, -1},
+                    {-1, 1},
+                    {1, 1},
+                    {1, -1});
+        return;
+    }
+
+    auto to_positive = [](float f) -> float {
+        float res = (f + 1)/2;
+        return res;
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Render face
+
+    render_head(gs);
 
     // End of Render Face
     ////////////////////////////////////////////////////////////
@@ -785,8 +1274,6 @@ static void game_render(double dt, GameState* gs)
                                k_eatable_width);
         }
     }
-
-    render_score(gs);
 }
 
 
@@ -822,6 +1309,8 @@ int main()
 
     glfwSetCursorPosCallback(window, cursor_pos_callback);
     glfwSetKeyCallback(window, key_callback);
+    glfwSetWindowRefreshCallback(window, refresh_callback);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
 
     // Load extensions
@@ -847,6 +1336,16 @@ int main()
 
     audio_init();
 
+    if (pack_open(&g_pack, "chew.pack")) {
+        printf("[DEBUG] Loading assets from chew.pack, %d entries.\n", g_pack.num_entries);
+    }
+
+    g_image_parallel.run = run_image_tasks;
+    g_image_parallel.num_threads = (int)std::thread::hardware_concurrency();
+    if (g_image_parallel.num_threads > k_max_image_tasks + 1) {
+        g_image_parallel.num_threads = k_max_image_tasks + 1;
+    }
+
     load_image(ImageIndex::BACKGROUND, "background.png");
     load_image(ImageIndex::JAW, "jaw.png");
     load_image(ImageIndex::HEADTOP, "headtop.png");
@@ -893,19 +1392,17 @@ int main()
             //"   out_color = color; \n"
             "}\n";
 
-    GLuint shader_objects[2] = {0};
-    for ( int i = 0; i < 2; ++i ) {
-        GLuint shader_type = (GLuint)((i == 0) ? GL_VERTEX_SHADER_ARB : GL_FRAGMENT_SHADER_ARB);
-        shader_objects[i] = gl_compile_shader(shader_contents[i], shader_type);
+    // Save either one as quad.vert or quad.frag to override it, and to edit it live.
+    double shader_start = glfwGetTime();
+    ShaderCacheResult shader_result = shader_load(&g_quad_shader, shader_contents[0], shader_contents[1],
+                                                  "quad.vert", "quad.frag", "quad.progcache");
+    if (shader_result == ShaderCacheResult::FAILED) {
+        die_gracefully("Could not build the shaders.\n");
     }
-    quad_program = glCreateProgramObjectARB();
-    gl_link_program(quad_program, shader_objects, 2);
-
-    GLCHK (glUseProgramObjectARB(quad_program));
-
-    GLint sampler_loc = glGetUniformLocationARB(quad_program, "raster_buffer");
-    assert (sampler_loc >= 0);
-    GLCHK (glUniform1iARB(sampler_loc, 0 /*GL_TEXTURE0*/));
+    printf("[DEBUG] Quad shader %s in %.2f ms.\n",
+           shader_result == ShaderCacheResult::HIT ? "loaded from cache" : "compiled",
+           (glfwGetTime() - shader_start) * 1000);
+    use_quad_program();
 
     glEnable (GL_BLEND);
     glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -913,6 +1410,40 @@ int main()
 
     glClearColor(1,1,1,1);
 
+    const char* renderer = getenv("CHEW_RENDERER");
+    if (renderer && strcmp(renderer, "soft") == 0) {
+        g_render_backend = RenderBackend::SOFTWARE;
+        soft_init(g_win_width, g_win_height, (int)std::thread::hardware_concurrency());
+
+        GLCHK (glGenTextures(1, &g_soft_frame_tex));
+        GLCHK (glBindTexture(GL_TEXTURE_2D, g_soft_frame_tex));
+        GLCHK (glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        GLCHK (glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        GLCHK (glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, g_win_width, g_win_height, 0,
+                            GL_RGBA, GL_UNSIGNED_BYTE, NULL));
+        printf("[DEBUG] Software renderer, %d threads.\n", (int)std::thread::hardware_concurrency());
+    }
+
+    const char* capture_target = getenv("CHEW_CAPTURE");
+    if (capture_target) {
+        int fb_width, fb_height;
+        glfwGetFramebufferSize(window, &fb_width, &fb_height);
+        g_capturing = gl_readback_init(&g_readback, fb_width, fb_height) &&
+                      capture_open(capture_target, fb_width, fb_height);
+        if (g_capturing) {
+            printf("[DEBUG] Capturing %dx%d frames to %s.\n", fb_width, fb_height, capture_target);
+        } else {
+            gl_readback_destroy(&g_readback);
+            printf("[DEBUG] Could not capture to %s.\n", capture_target);
+        }
+    }
+
+    const char* retained = getenv("CHEW_RETAINED");
+    g_retained = !(retained && strcmp(retained, "0") == 0);
+    if (g_retained && g_render_backend == RenderBackend::GL) {
+        create_head_layer(window);
+    }
+
     // Push d7samurai's Duke Nukem quote remix of awesomeness.
     push_audio(1, AudioIndex::DUKE);
     push_audio(1, AudioIndex::LOOP, AudioOpts::LOOP_FOREVER);
@@ -927,34 +1458,92 @@ int main()
 
     GameState gs = {};
 
+    int  presented_frames = 0, idle_frames = 0;
+    bool presented_dead = false;
+    int  presented_score = 0;
+
     srand(time(NULL));
 
     while (!glfwWindowShouldClose(window)) {
         double now = glfwGetTime();
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+#ifndef RELEASE_CHEW
+        if (shader_hot_reload(&g_quad_shader)) {
+            printf("[DEBUG] Reloaded the quad shader.\n");
+            use_quad_program();
+            g_needs_present = true;
+        }
+#endif
 
         double dt = now - then;
 
         game_tick(dt, &gs);
 
-        game_render(dt, &gs);
+        bool idle = g_retained && !g_capturing && !g_needs_present &&
+                    gs.dead && presented_dead && presented_score == gs.score;
+        if (idle) {
+            ++idle_frames;
+            sleep_ms(k_idle_frame_ms);
+        } else {
+            if (g_head_layer_resized) {
+                g_head_layer_resized = false;
+                if (g_retained && g_render_backend == RenderBackend::GL) {
+                    create_head_layer(window);
+                }
+            }
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (g_render_backend == RenderBackend::SOFTWARE) {
+                soft_begin_frame(0xffffffff);  // The clear color.
+            }
 
+            game_render(dt, &gs);
+            if (g_render_backend == RenderBackend::SOFTWARE) {
+                present_soft_frame();
+            }
+            render_score(&gs, !gs.dead);  // Over the sprites, whichever way they were drawn.
 
-        glfwSwapBuffers(window);
+            if (g_capturing) {
+                // The frame before this one, the read of this one is still in flight.
+                const uint8_t* pixels = gl_readback_frame(&g_readback);
+                if (pixels) {
+                    capture_frame(pixels, true);
+                }
+                gl_readback_done(&g_readback);
+            }
+
+            glfwSwapBuffers(window);
+            ++presented_frames;
+            presented_dead = gs.dead;
+            presented_score = gs.score;
+            g_needs_present = false;
+        }
         glfwPollEvents();
 
         if (g_should_quit) {
+            stop_capture();
             glfwDestroyWindow(window);
         }
 
         then = now;
     }
 
+    if (g_render_backend == RenderBackend::SOFTWARE) {
+        soft_deinit();
+    }
+    printf("[DEBUG] Presented %d frames, %d idle on the dead screen, head layer drawn %d times.\n",
+           presented_frames, idle_frames, g_head_layer_redraws);
+    stop_capture();
     audio_deinit();
+    pack_close(&g_pack);  // After the mixer is done with any samples in it.
+    texcache_release_all();
     glfwTerminate();
     return 0;
 }
 
 #include "audio.cc"
+#include "pack.cc"
+#include "texture_cache.cc"
+#include "shader_cache.cc"
 #include "text.cc"
+#include "soft_render.cc"
+#include "frame_capture.cc"
@@ -0,0 +1,358 @@
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(_WIN32)
+#define capture_popen(cmd)  _popen(cmd, "wb")
+#define capture_pclose      _pclose
+#else
+#include <signal.h>
+#define capture_popen(cmd)  popen(cmd, "w")
+#define capture_pclose      pclose
+#endif
+
+enum class CaptureOutput {
+    PNG_SEQUENCE,
+    PPM_SEQUENCE,
+    RAW_FILE,
+    RAW_PIPE,
+};
+
+struct CaptureSlot {
+    uint8_t* pixels;
+    bool     bottom_up;
+    int      frame;
+};
+
+static CaptureOutput g_capture_output;
+static char          g_capture_target[1024];
+static FILE*         g_capture_stream;   // RAW_FILE and RAW_PIPE.
+static bool          g_capture_failed;   // The stream broke, what is left is dropped.
+static bool          g_capture_warned;   // A write failed, said once.
+static int           g_capture_w, g_capture_h;
+static uint8_t*      g_capture_rgb;      // Writer scratch, a frame of RGB8 top row first.
+static uint8_t*      g_capture_png;      // Writer scratch, the zlib stream of a frame.
+static uint32_t      g_capture_crc_table[256];
+
+static CaptureSlot             g_capture_slots[k_capture_slots];
+static int                     g_capture_head;   // Next slot to fill.
+static int                     g_capture_count;  // Filled and not yet written.
+static CaptureStats            g_capture_stats;
+static bool                    g_capture_quit;
+static bool                    g_capture_open;
+static std::mutex              g_capture_mutex;
+static std::condition_variable g_capture_wake;
+static std::thread             g_capture_writer;
+
+static uint32_t capture_crc(uint32_t crc, const uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        crc = g_capture_crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void capture_put32be(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static bool capture_write_chunk(FILE* fd, const char* type, const uint8_t* data, uint32_t size)
+{
+    uint8_t header[8];
+    capture_put32be(header, size);
+    memcpy(header + 4, type, 4);
+    uint8_t footer[4];
+    capture_put32be(footer, capture_crc(capture_crc(0xffffffff, header + 4, 4), data, size) ^ 0xffffffff);
+    return fwrite(header, 1, 8, fd) == 8 && fwrite(data, 1, size, fd) == size && fwrite(footer, 1, 4, fd) == 4;
+}
+
+// Stored deflate blocks, so writing a frame costs about what copying it does.
+// Run the sequence through an optimizer, or use a pipe to an encoder, for
+// smaller files.
+static bool capture_write_png(FILE* fd, const uint8_t* rgb, int w, int h)
+{
+    static const uint8_t k_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    uint8_t ihdr[13];
+    capture_put32be(ihdr, (uint32_t)w);
+    capture_put32be(ihdr + 4, (uint32_t)h);
+    ihdr[8] = 8;   // Bits per channel.
+    ihdr[9] = 2;   // RGB.
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+    size_t row_size = (size_t)w * 3 + 1;
+    size_t raw_size = row_size * h;
+    uint8_t* p = g_capture_png;
+    *p++ = 0x78;  // Deflate, 32K window, no compression.
+    *p++ = 0x01;
+    uint32_t s1 = 1, s2 = 0;  // Adler-32 of the raw rows.
+    size_t block_left = 0, raw_left = raw_size;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* row = rgb + (size_t)y * (row_size - 1);
+        for (size_t i = 0; i < row_size; ++i) {
+            if (block_left == 0) {
+                block_left = raw_left < 0xffff ? raw_left : 0xffff;
+                *p++ = raw_left == block_left ? 1 : 0;  // Last block or not, stored.
+                *p++ = (uint8_t)block_left;
+                *p++ = (uint8_t)(block_left >> 8);
+                *p++ = (uint8_t)~block_left;
+                *p++ = (uint8_t)(~block_left >> 8);
+            }
+            uint8_t b = i == 0 ? 0 : row[i - 1];  // Filter type none.
+            *p++ = b;
+            s1 += b;
+            if (s1 >= 65521) {
+                s1 -= 65521;
+            }
+            s2 += s1;
+            if (s2 >= 65521) {
+                s2 -= 65521;
+            }
+            --block_left;
+            --raw_left;
+        }
+    }
+    capture_put32be(p, (s2 << 16) | s1);
+    p += 4;
+
+    return fwrite(k_signature, 1, 8, fd) == 8 &&
+           capture_write_chunk(fd, "IHDR", ihdr, sizeof(ihdr)) &&
+           capture_write_chunk(fd, "IDAT", g_capture_png, (uint32_t)(p - g_capture_png)) &&
+           capture_write_chunk(fd, "IEND", NULL, 0);
+}
+
+static bool capture_write(const CaptureSlot* slot)
+{
+    // Alpha is whatever blending left in the framebuffer, so it is not kept.
+    int w = g_capture_w, h = g_capture_h;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* src = slot->pixels + (size_t)(slot->bottom_up ? h - 1 - y : y) * w * 4;
+        uint8_t* dst = g_capture_rgb + (size_t)y * w * 3;
+        for (int x = 0; x < w; ++x) {
+            dst[x * 3 + 0] = src[x * 4 + 0];
+            dst[x * 3 + 1] = src[x * 4 + 1];
+            dst[x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
+    size_t size = (size_t)w * h * 3;
+
+    if (g_capture_output == CaptureOutput::RAW_FILE || g_capture_output == CaptureOutput::RAW_PIPE) {
+        return fwrite(g_capture_rgb, 1, size, g_capture_stream) == size;
+    }
+    char fname[1024];
+    snprintf(fname, sizeof(fname), g_capture_target, slot->frame);
+    FILE* fd = fopen(fname, "wb");
+    if (!fd) {
+        return false;
+    }
+    bool ok;
+    if (g_capture_output == CaptureOutput::PNG_SEQUENCE) {
+        ok = capture_write_png(fd, g_capture_rgb, w, h);
+    } else {
+        ok = fprintf(fd, "P6\n%d %d\n255\n", w, h) > 0 && fwrite(g_capture_rgb, 1, size, fd) == size;
+    }
+    return fclose(fd) == 0 && ok;
+}
+
+static void capture_writer()
+{
+    std::unique_lock<std::mutex> lock(g_capture_mutex);
+    for (;;) {
+        g_capture_wake.wait(lock, [] { return g_capture_quit || g_capture_count > 0; });
+        if (g_capture_count == 0) {
+            return;  // Quitting, and everything is written.
+        }
+        int tail = (g_capture_head - g_capture_count + k_capture_slots) % k_capture_slots;
+        const CaptureSlot* slot = &g_capture_slots[tail];
+        bool failed = g_capture_failed;
+        lock.unlock();
+
+        bool ok = !failed && capture_write(slot);
+        if (!ok && !g_capture_warned) {
+            g_capture_warned = true;
+            printf("[DEBUG] Could not write captured frame %d to %s.\n", slot->frame, g_capture_target);
+        }
+
+        lock.lock();
+        --g_capture_count;
+        if (ok) {
+            ++g_capture_stats.written;
+        } else {
+            ++g_capture_stats.dropped;
+            // A broken stream stays broken. A file in a sequence can fail on its own.
+            g_capture_failed = g_capture_failed || g_capture_output == CaptureOutput::RAW_FILE ||
+                               g_capture_output == CaptureOutput::RAW_PIPE;
+        }
+    }
+}
+
+static bool capture_ends_with(const char* s, const char* suffix)
+{
+    size_t len = strlen(s), suffix_len = strlen(suffix);
+    return len >= suffix_len && strcmp(s + len - suffix_len, suffix) == 0;
+}
+
+// The target of a sequence is a printf format for the frame number: one %d,
+// with flags and width if wanted, and no other conversions besides %%.
+static bool capture_is_frame_pattern(const char* s)
+{
+    int conversions = 0;
+    for ( ; *s; ++s) {
+        if (*s != '%') {
+            continue;
+        }
+        ++s;
+        if (*s == '%') {
+            continue;
+        }
+        while (*s && strchr("-+ #0", *s)) {
+            ++s;
+        }
+        while (*s >= '0' && *s <= '9') {
+            ++s;
+        }
+        if (*s != 'd') {
+            return false;
+        }
+        ++conversions;
+    }
+    return conversions == 1;
+}
+
+// Closes the stream and frees the buffers, whichever of them are there.
+static void capture_release()
+{
+    if (g_capture_stream) {
+        if (g_capture_output == CaptureOutput::RAW_PIPE) {
+            capture_pclose(g_capture_stream);
+        } else {
+            fclose(g_capture_stream);
+        }
+    }
+    g_capture_stream = NULL;
+    for (int i = 0; i < k_capture_slots; ++i) {
+        free(g_capture_slots[i].pixels);
+        g_capture_slots[i].pixels = NULL;
+    }
+    free(g_capture_rgb);
+    free(g_capture_png);
+    g_capture_rgb = g_capture_png = NULL;
+}
+
+bool capture_open(const char* target, int w, int h)
+{
+    if (g_capture_open || w <= 0 || h <= 0) {
+        return false;
+    }
+    if (target[0] == '|') {
+        g_capture_output = CaptureOutput::RAW_PIPE;
+    } else if (capture_ends_with(target, ".png")) {
+        g_capture_output = CaptureOutput::PNG_SEQUENCE;
+    } else if (capture_ends_with(target, ".ppm")) {
+        g_capture_output = CaptureOutput::PPM_SEQUENCE;
+    } else {
+        g_capture_output = CaptureOutput::RAW_FILE;
+    }
+    if ((g_capture_output == CaptureOutput::PNG_SEQUENCE || g_capture_output == CaptureOutput::PPM_SEQUENCE) &&
+        !capture_is_frame_pattern(target)) {
+        return false;
+    }
+    snprintf(g_capture_target, sizeof(g_capture_target), "%s",
+             g_capture_output == CaptureOutput::RAW_PIPE ? target + 1 : target);
+
+    if (g_capture_output == CaptureOutput::RAW_PIPE) {
+#if !defined(_WIN32)
+        signal(SIGPIPE, SIG_IGN);  // A command that exits early fails the write instead.
+#endif
+        g_capture_stream = capture_popen(g_capture_target);
+    } else if (g_capture_output == CaptureOutput::RAW_FILE) {
+        g_capture_stream = fopen(g_capture_target, "wb");
+    }
+    if ((g_capture_output == CaptureOutput::RAW_PIPE || g_capture_output == CaptureOutput::RAW_FILE) &&
+        !g_capture_stream) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) {
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        g_capture_crc_table[i] = c;
+    }
+    size_t raw_size = ((size_t)w * 3 + 1) * h;
+    g_capture_w = w;
+    g_capture_h = h;
+    g_capture_rgb = (uint8_t*)malloc((size_t)w * h * 3);
+    g_capture_png = (uint8_t*)malloc(2 + raw_size + (raw_size / 0xffff + 1) * 5 + 4);
+    bool allocated = g_capture_rgb && g_capture_png;
+    for (int i = 0; i < k_capture_slots; ++i) {
+        g_capture_slots[i].pixels = (uint8_t*)malloc((size_t)w * h * 4);
+        allocated = allocated && g_capture_slots[i].pixels;
+    }
+    if (!allocated) {
+        capture_release();
+        return false;
+    }
+    g_capture_head = 0;
+    g_capture_count = 0;
+    g_capture_stats = {};
+    g_capture_failed = false;
+    g_capture_warned = false;
+    g_capture_quit = false;
+    g_capture_open = true;
+    g_capture_writer = std::thread(capture_writer);
+    return true;
+}
+
+void capture_frame(const uint8_t* rgba, bool bottom_up)
+{
+    if (!g_capture_open) {
+        return;
+    }
+    CaptureSlot* slot = NULL;
+    {
+        std::lock_guard<std::mutex> lock(g_capture_mutex);
+        int frame = g_capture_stats.frames++;
+        if (g_capture_count == k_capture_slots) {
+            ++g_capture_stats.dropped;
+            return;
+        }
+        slot = &g_capture_slots[g_capture_head];
+        slot->frame = frame;
+        slot->bottom_up = bottom_up;
+    }
+    // The writer only touches slots that are counted, this one isn't yet.
+    memcpy(slot->pixels, rgba, (size_t)g_capture_w * g_capture_h * 4);
+    {
+        std::lock_guard<std::mutex> lock(g_capture_mutex);
+        g_capture_head = (g_capture_head + 1) % k_capture_slots;
+        ++g_capture_count;
+    }
+    g_capture_wake.notify_one();
+}
+
+CaptureStats capture_stats()
+{
+    std::lock_guard<std::mutex> lock(g_capture_mutex);
+    return g_capture_stats;
+}
+
+CaptureStats capture_close()
+{
+    if (!g_capture_open) {
+        return {};
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_capture_mutex);
+        g_capture_quit = true;
+    }
+    g_capture_wake.notify_one();
+    g_capture_writer.join();
+    capture_release();
+    g_capture_open = false;
+    return g_capture_stats;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// Captures frames to disk or to another program, for visual tests and
+// trailers, without holding up the frame.
+//
+// capture_frame copies the pixels into a free slot of a small ring and
+// returns. A writer thread empties the ring in order. When the writer falls
+// behind and the ring is full the frame is dropped, and counted.
+//
+// target picks the output:
+//   frames/%05d.png   A PNG per frame, named by printf with the frame number.
+//                     Exactly one %d, flags and width allowed, and %% for a
+//                     literal %. capture_open fails on anything else.
+//   frames/%05d.ppm   Same, binary PPM. Cheaper to write.
+//   out.raw           Every frame, packed RGB8 top row first, into one file.
+//   |command          The same raw frames piped to command, eg.
+//                     |ffmpeg -f rawvideo -pix_fmt rgb24 -s 800x600 -r 60 -i - out.mp4
+
+static const int k_capture_slots = 8;
+
+struct CaptureStats {
+    int frames;    // Given to capture_frame.
+    int written;
+    int dropped;   // Ring full, or a write failed.
+};
+
+bool capture_open(const char* target, int w, int h);
+// rgba is w * h RGBA8 pixels, bottom row first when bottom_up, as GL reads them.
+// Only a copy is kept.
+void capture_frame(const uint8_t* rgba, bool bottom_up);
+CaptureStats capture_stats();
+// Writes what is queued, then stops the writer.
+CaptureStats capture_close();
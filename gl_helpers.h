@@ -14,6 +14,7 @@
 #define GLCHK(stmt) stmt; gl_query_error(#stmt, __FILE__, __LINE__)
 
 #include <assert.h>
+#include <string.h>
 
 #ifdef _WIN32
 //#include <Windows.h>
@@ -21,8 +22,95 @@
 
 void gl_log(char* str);
 void gl_query_error(const char* expr, const char* file, int line);
-static GLuint gl_compile_shader(const char* src, GLuint type);
-static void gl_link_program(GLuint obj, GLuint shaders[], int64_t num_shaders);
+// Errors are logged and returned.
+static bool gl_try_compile_shader(const char* src, GLuint type, GLuint* obj);
+static bool gl_try_link_program(GLuint obj, GLuint shaders[], int64_t num_shaders);
+
+// Streaming vertex buffers.
+//
+// A ring of buffer space for vertices that are written once and drawn once,
+// the way immediate mode would send them. gl_stream_map hands out the next
+// free range, gl_stream_unmap makes it ready to draw from. The buffer is left
+// bound to its target.
+//
+// How the ring is reused depends on what the driver has, best first:
+//  MAP_FENCED  glMapBufferRange without synchronization. The ring is cut in
+//              regions, a fence goes in when one is left and is waited on
+//              before it is written again.
+//  MAP_ORPHAN  glMapBufferRange without synchronization, and the storage is
+//              orphaned with glBufferData when the ring wraps.
+//  SUB_DATA    Written to memory and sent with glBufferSubData, orphaning on
+//              wraps too.
+
+enum class GLStreamMode {
+    SUB_DATA,
+    MAP_ORPHAN,
+    MAP_FENCED,
+};
+
+static const int k_gl_stream_regions = 4;
+
+struct GLStreamBuffer {
+    GLuint       vbo;
+    GLenum       target;
+    GLStreamMode mode;
+    size_t       size;
+    size_t       head;            // Next free byte.
+    int          region;          // Region the head is in, for MAP_FENCED.
+    GLsync       fences[k_gl_stream_regions];
+    uint8_t*     staging;         // SUB_DATA only.
+    size_t       mapped_offset;
+    size_t       mapped_bytes;
+    int          stalls;          // Fence waits that had to block.
+    int          orphans;
+};
+
+// Sizes over size / k_gl_stream_regions can't be mapped in MAP_FENCED mode.
+static bool gl_stream_init(GLStreamBuffer* sb, GLenum target, size_t size);
+// Room for bytes of vertices, which start at *offset in the buffer. NULL when
+// bytes is more than the ring can take.
+static void* gl_stream_map(GLStreamBuffer* sb, size_t bytes, size_t* offset);
+// False if the mapped data was lost, in which case there is nothing to draw.
+static bool gl_stream_unmap(GLStreamBuffer* sb);
+static void gl_stream_destroy(GLStreamBuffer* sb);
+
+// Asynchronous readback of the color buffer.
+//
+// With pixel buffer objects there are two of them. gl_readback_frame starts
+// reading the frame into one and maps the other, which the call before filled,
+// so the pixels come out a frame late but the read doesn't wait on the frame
+// that was just drawn. Without them it falls back to a plain glReadPixels.
+
+struct GLReadback {
+    GLuint   pbos[2];      // Both 0 without pixel buffer objects.
+    int      w, h;
+    int      frame;        // Frames read so far.
+    bool     mapped;
+    uint8_t* pixels;       // Fallback only.
+};
+
+static bool gl_readback_init(GLReadback* rb, int w, int h);
+// RGBA8 pixels, bottom row first as GL has them, or NULL when there are none
+// yet. Valid until gl_readback_done.
+static const uint8_t* gl_readback_frame(GLReadback* rb);
+static void gl_readback_done(GLReadback* rb);
+static void gl_readback_destroy(GLReadback* rb);
+
+// Offscreen color target, an RGBA8 texture behind a framebuffer object.
+// Between gl_target_begin and gl_target_end everything draws into the
+// texture, with the viewport set to cover it.
+
+struct GLRenderTarget {
+    GLuint fbo;   // 0 when there are no framebuffer objects.
+    GLuint tex;
+    int    w, h;
+};
+
+// False, with nothing created, without framebuffer objects.
+static bool gl_target_init(GLRenderTarget* rt, int w, int h);
+static void gl_target_begin(GLRenderTarget* rt);
+static void gl_target_end(GLRenderTarget* rt);
+static void gl_target_destroy(GLRenderTarget* rt);
 
 #ifdef SGL_GL_HELPERS_IMPLEMENTATION
 
@@ -44,9 +132,10 @@ void gl_log(char* str)
 
 #endif
 
-static GLuint gl_compile_shader(const char* src, GLuint type)
+static bool gl_try_compile_shader(const char* src, GLuint type, GLuint* out_obj)
 {
     GLuint obj = (GLuint)glCreateShaderObjectARB(type);
+    *out_obj = obj;
 
     GLCHK ( glShaderSourceARB(obj, 1, &src, NULL) );
     GLCHK ( glCompileShaderARB(obj) );
@@ -65,9 +154,9 @@ static GLuint gl_compile_shader(const char* src, GLuint type)
         gl_log("Shader compilation failed. \n    ---- Info log:\n");
         gl_log(log);
         free(log);
-        assert(!"Shader compilation error");
+        return false;
     }
-    return obj;
+    return true;
 }
 
 #if defined(__MACH__)
@@ -83,7 +172,7 @@ static GLuint gl_compile_shader(const char* src, GLuint type)
 #define glUseProgramObjectARB glUseProgram
 #endif
 
-static void gl_link_program(GLuint obj, GLuint shaders[], int64_t num_shaders)
+static bool gl_try_link_program(GLuint obj, GLuint shaders[], int64_t num_shaders)
 {
     //assert(glIsProgramARB(obj));
     for (int i = 0; i < num_shaders; ++i)
@@ -112,10 +201,12 @@ static void gl_link_program(GLuint obj, GLuint shaders[], int64_t num_shaders)
         glGetInfoLogARB(obj, (GLsizei)len, &written_len, log);
         gl_log(log);
         free(log);
-        assert(!"program linking error");
+        return false;
     }
     GLCHK ( glValidateProgramARB(obj) );
+    return true;
 }
+
 #if defined(__MACH__)
 #undef glGetObjectParameterivARB
 #undef glGetInfoLogARB
@@ -125,6 +216,225 @@ static void gl_link_program(GLuint obj, GLuint shaders[], int64_t num_shaders)
 #undef glUseProgramObjectARB
 #endif
 
+static bool gl_stream_init(GLStreamBuffer* sb, GLenum target, size_t size)
+{
+    memset(sb, 0, sizeof(*sb));
+    sb->target = target;
+    sb->size = size;
+    if (glMapBufferRange && glUnmapBuffer && glFenceSync && glClientWaitSync && glDeleteSync) {
+        sb->mode = GLStreamMode::MAP_FENCED;
+    } else if (glMapBufferRange && glUnmapBuffer) {
+        sb->mode = GLStreamMode::MAP_ORPHAN;
+    } else {
+        sb->mode = GLStreamMode::SUB_DATA;
+        sb->staging = (uint8_t*)malloc(size);
+        if (!sb->staging) {
+            return false;
+        }
+    }
+    GLCHK ( glGenBuffers(1, &sb->vbo) );
+    GLCHK ( glBindBuffer(target, sb->vbo) );
+    GLCHK ( glBufferData(target, (GLsizeiptr)size, NULL, GL_STREAM_DRAW) );
+    return sb->vbo != 0;
+}
+
+// Blocks until the GPU is done with what a fence covers, and deletes it.
+static void gl_stream_wait(GLStreamBuffer* sb, GLsync* fence)
+{
+    if (!*fence) {
+        return;
+    }
+    GLenum res = glClientWaitSync(*fence, 0, 0);
+    if (res == GL_TIMEOUT_EXPIRED) {
+        ++sb->stalls;
+        do {
+            res = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);  // 1ms
+        } while (res == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(*fence);
+    *fence = NULL;
+}
+
+static void* gl_stream_map(GLStreamBuffer* sb, size_t bytes, size_t* offset)
+{
+    bytes = (bytes + 15) & ~(size_t)15;
+    GLCHK ( glBindBuffer(sb->target, sb->vbo) );
+    if (sb->mode == GLStreamMode::MAP_FENCED) {
+        size_t region_size = sb->size / k_gl_stream_regions;
+        if (bytes > region_size) {
+            return NULL;
+        }
+        // Ranges never straddle regions, so a fence covers all draws from its region.
+        if (sb->head + bytes > (size_t)(sb->region + 1) * region_size) {
+            sb->fences[sb->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            sb->region = (sb->region + 1) % k_gl_stream_regions;
+            sb->head = sb->region * region_size;
+            gl_stream_wait(sb, &sb->fences[sb->region]);
+        }
+    } else {
+        if (bytes > sb->size) {
+            return NULL;
+        }
+        if (sb->head + bytes > sb->size) {
+            GLCHK ( glBufferData(sb->target, (GLsizeiptr)sb->size, NULL, GL_STREAM_DRAW) );
+            sb->head = 0;
+            ++sb->orphans;
+        }
+    }
+    *offset = sb->head;
+    sb->mapped_offset = sb->head;
+    sb->mapped_bytes = bytes;
+    sb->head += bytes;
+    if (sb->mode == GLStreamMode::SUB_DATA) {
+        return sb->staging + sb->mapped_offset;
+    }
+    return glMapBufferRange(sb->target, (GLintptr)sb->mapped_offset, (GLsizeiptr)bytes,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+static bool gl_stream_unmap(GLStreamBuffer* sb)
+{
+    if (sb->mode == GLStreamMode::SUB_DATA) {
+        GLCHK ( glBufferSubData(sb->target, (GLintptr)sb->mapped_offset, (GLsizeiptr)sb->mapped_bytes,
+                                sb->staging + sb->mapped_offset) );
+        return true;
+    }
+    return glUnmapBuffer(sb->target) == GL_TRUE;
+}
+
+static void gl_stream_destroy(GLStreamBuffer* sb)
+{
+    for (int i = 0; i < k_gl_stream_regions; ++i) {
+        if (sb->fences[i]) {
+            glDeleteSync(sb->fences[i]);
+        }
+    }
+    if (sb->vbo) {
+        glDeleteBuffers(1, &sb->vbo);
+    }
+    free(sb->staging);
+    memset(sb, 0, sizeof(*sb));
+}
+
+static bool gl_readback_init(GLReadback* rb, int w, int h)
+{
+    memset(rb, 0, sizeof(*rb));
+    rb->w = w;
+    rb->h = h;
+    size_t size = (size_t)w * h * 4;
+    if ((GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object) && glMapBuffer && glUnmapBuffer) {
+        GLCHK ( glGenBuffers(2, rb->pbos) );
+        for (int i = 0; i < 2; ++i) {
+            GLCHK ( glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbos[i]) );
+            GLCHK ( glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)size, NULL, GL_STREAM_READ) );
+        }
+        GLCHK ( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+        return rb->pbos[0] != 0 && rb->pbos[1] != 0;
+    }
+    rb->pixels = (uint8_t*)malloc(size);
+    return rb->pixels != NULL;
+}
+
+static const uint8_t* gl_readback_frame(GLReadback* rb)
+{
+    // The window isn't necessarily a multiple of 4 wide.
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    if (!rb->pbos[0]) {
+        GLCHK ( glReadPixels(0, 0, rb->w, rb->h, GL_RGBA, GL_UNSIGNED_BYTE, rb->pixels) );
+        glPopClientAttrib();
+        ++rb->frame;
+        return rb->pixels;
+    }
+    GLCHK ( glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbos[rb->frame % 2]) );
+    GLCHK ( glReadPixels(0, 0, rb->w, rb->h, GL_RGBA, GL_UNSIGNED_BYTE, NULL) );
+    glPopClientAttrib();
+    const uint8_t* pixels = NULL;
+    if (rb->frame > 0) {
+        GLCHK ( glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbos[(rb->frame + 1) % 2]) );
+        pixels = (const uint8_t*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        rb->mapped = pixels != NULL;
+    }
+    ++rb->frame;
+    if (!rb->mapped) {
+        GLCHK ( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+    }
+    return pixels;
+}
+
+static void gl_readback_done(GLReadback* rb)
+{
+    if (rb->mapped) {
+        // A lost mapping only loses one captured frame, there is nothing to redo.
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        GLCHK ( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+        rb->mapped = false;
+    }
+}
+
+static void gl_readback_destroy(GLReadback* rb)
+{
+    gl_readback_done(rb);
+    if (rb->pbos[0]) {
+        glDeleteBuffers(2, rb->pbos);
+    }
+    free(rb->pixels);
+    memset(rb, 0, sizeof(*rb));
+}
+
+static bool gl_target_init(GLRenderTarget* rt, int w, int h)
+{
+    memset(rt, 0, sizeof(*rt));
+    if (!glGenFramebuffers || !glBindFramebuffer || !glFramebufferTexture2D ||
+        !glCheckFramebufferStatus || !glDeleteFramebuffers) {
+        return false;
+    }
+    rt->w = w;
+    rt->h = h;
+    GLCHK ( glGenTextures(1, &rt->tex) );
+    GLCHK ( glBindTexture(GL_TEXTURE_2D, rt->tex) );
+    GLCHK ( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR) );
+    GLCHK ( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR) );
+    GLCHK ( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE) );
+    GLCHK ( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE) );
+    GLCHK ( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL) );
+    GLCHK ( glGenFramebuffers(1, &rt->fbo) );
+    GLCHK ( glBindFramebuffer(GL_FRAMEBUFFER, rt->fbo) );
+    GLCHK ( glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rt->tex, 0) );
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    GLCHK ( glBindFramebuffer(GL_FRAMEBUFFER, 0) );
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        gl_target_destroy(rt);
+        return false;
+    }
+    return true;
+}
+
+static void gl_target_begin(GLRenderTarget* rt)
+{
+    glPushAttrib(GL_VIEWPORT_BIT);
+    GLCHK ( glBindFramebuffer(GL_FRAMEBUFFER, rt->fbo) );
+    GLCHK ( glViewport(0, 0, rt->w, rt->h) );
+}
+
+static void gl_target_end(GLRenderTarget* rt)
+{
+    GLCHK ( glBindFramebuffer(GL_FRAMEBUFFER, 0) );
+    glPopAttrib();
+}
+
+static void gl_target_destroy(GLRenderTarget* rt)
+{
+    if (rt->fbo) {
+        glDeleteFramebuffers(1, &rt->fbo);
+    }
+    if (rt->tex) {
+        glDeleteTextures(1, &rt->tex);
+    }
+    memset(rt, 0, sizeof(*rt));
+}
+
 void gl_query_error(const char* expr, const char* file, int line)
 {
     GLenum err = glGetError();
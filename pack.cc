@@ -0,0 +1,154 @@
+#include <string.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Size a payload must have given its params, 0 for payloads that can have any size.
+static uint64_t pack_payload_size(const PackEntry* entry)
+{
+    const uint32_t* p = entry->params;
+    switch (entry->payload) {
+    case PackPayload::RGBA8:   return (uint64_t)p[0] * p[1] * 4;
+    case PackPayload::PCM_S16: return (uint64_t)p[0] * p[2] * sizeof(short);
+    case PackPayload::PCM_F32: return (uint64_t)p[0] * p[2] * sizeof(float);
+    default:                   return 0;
+    }
+}
+
+static bool pack_check(const uint8_t* base, size_t size)
+{
+    if (size < sizeof(PackHeader)) {
+        return false;
+    }
+    const PackHeader* header = (const PackHeader*)base;
+    if (header->magic != k_pack_magic || header->version != k_pack_version) {
+        return false;
+    }
+    if (header->num_entries > (size - sizeof(PackHeader)) / sizeof(PackEntry)) {
+        return false;
+    }
+    const PackEntry* entries = (const PackEntry*)(base + sizeof(PackHeader));
+    for (uint32_t i = 0; i < header->num_entries; ++i) {
+        const PackEntry* e = &entries[i];
+        if (memchr(e->name, 0, k_pack_max_name) == NULL) {
+            return false;
+        }
+        if ((uint32_t)e->payload > (uint32_t)PackPayload::PCM_F32) {
+            return false;
+        }
+        if (e->offset % k_pack_alignment != 0 || e->offset > size || e->size > size - e->offset) {
+            return false;
+        }
+        if (e->payload != PackPayload::FILE && e->size != pack_payload_size(e)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool map_file(MappedFile* mf, const char* fname)
+{
+    memset(mf, 0, sizeof(*mf));
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    const void* base = NULL;
+    if (mapping) {
+        base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!base) {
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+    mf->base = (const uint8_t*)base;
+    mf->size = (size_t)file_size.QuadPart;
+    mf->file = file;
+    mf->mapping = mapping;
+#else
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);  // The mapping keeps the file alive.
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    // Whatever gets mapped is loaded at startup, read it in ahead.
+    madvise(p, (size_t)st.st_size, MADV_WILLNEED);
+    mf->base = (const uint8_t*)p;
+    mf->size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void unmap_file(MappedFile* mf)
+{
+    if (mf->base) {
+#if defined(_WIN32)
+        UnmapViewOfFile(mf->base);
+        CloseHandle((HANDLE)mf->mapping);
+        CloseHandle((HANDLE)mf->file);
+#else
+        munmap((void*)mf->base, mf->size);
+#endif
+    }
+    memset(mf, 0, sizeof(*mf));
+}
+
+bool pack_open(AssetPack* pack, const char* fname)
+{
+    memset(pack, 0, sizeof(*pack));
+    if (!map_file(&pack->view, fname)) {
+        return false;
+    }
+    if (!pack_check(pack->view.base, pack->view.size)) {
+        unmap_file(&pack->view);
+        return false;
+    }
+    pack->entries = (const PackEntry*)(pack->view.base + sizeof(PackHeader));
+    pack->num_entries = (int)((const PackHeader*)pack->view.base)->num_entries;
+    return true;
+}
+
+void pack_close(AssetPack* pack)
+{
+    unmap_file(&pack->view);
+    memset(pack, 0, sizeof(*pack));
+}
+
+const PackEntry* pack_find(const AssetPack* pack, const char* name)
+{
+    for (int i = 0; i < pack->num_entries; ++i) {
+        if (strcmp(pack->entries[i].name, name) == 0) {
+            return &pack->entries[i];
+        }
+    }
+    return NULL;
+}
+
+const uint8_t* pack_data(const AssetPack* pack, const PackEntry* entry)
+{
+    return pack->view.base + entry->offset;
+}
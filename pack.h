@@ -0,0 +1,66 @@
+#pragma once
+
+// Asset pack: every asset in one file, mapped once at startup, so loading is
+// a lookup instead of an open/read/close per file. Built by tools/pack_assets.
+//
+// Layout, all little endian:
+//
+//   PackHeader
+//   PackEntry[num_entries]      Table of contents.
+//   blobs                       Each starts on a multiple of header.alignment.
+//
+// A blob is either the loose file's bytes, decoded when it's loaded, or a
+// payload decoded by the packer that the game uses as is.
+
+static const uint32_t k_pack_magic     = 0x50574843;  // "CHWP"
+static const uint32_t k_pack_version   = 1;
+static const uint32_t k_pack_alignment = 64;
+static const int      k_pack_max_name  = 48;
+
+enum class PackPayload : uint32_t {
+    FILE,     // The file as it was on disk. No params.
+    RGBA8,    // Decoded image, 4 bytes per pixel. params: w, h.
+    PCM_S16,  // Decoded audio, interleaved. params: num_channels, rate, num_samples.
+    PCM_F32,  // Same, as floats.
+};
+
+struct PackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_entries;
+    uint32_t alignment;
+};
+
+struct PackEntry {
+    char        name[k_pack_max_name];  // Loose file name, NUL terminated.
+    PackPayload payload;
+    uint32_t    params[3];
+    uint64_t    offset;                 // From the start of the pack.
+    uint64_t    size;
+};
+
+// A whole file, mapped read only.
+struct MappedFile {
+    const uint8_t*  base;  // NULL when nothing is mapped.
+    size_t          size;
+    void*           file;  // Windows handles, kept until unmap_file.
+    void*           mapping;
+};
+
+struct AssetPack {
+    MappedFile        view;
+    const PackEntry*  entries;
+    int               num_entries;
+};
+
+// False for missing or empty files.
+bool map_file(MappedFile* mf, const char* fname);
+void unmap_file(MappedFile* mf);
+
+// Maps the pack read only and checks the table of contents. Returns false,
+// leaving pack empty, if the file is missing or malformed.
+bool pack_open(AssetPack* pack, const char* fname);
+void pack_close(AssetPack* pack);
+// NULL if the pack is empty or has no entry by that name.
+const PackEntry* pack_find(const AssetPack* pack, const char* name);
+const uint8_t* pack_data(const AssetPack* pack, const PackEntry* entry);
@@ -88,6 +88,51 @@ PaError PaAlsa_GetStreamOutputCard( PaStream *s, int *card );
  */
 PaError PaAlsa_SetNumPeriods( int numPeriods );
 
+/** Number of bins in PaAlsaStreamStats::callbackHistogram. */
+#define paAlsaCallbackHistogramBins 16
+
+/** Runtime statistics of an ALSA stream, see PaAlsa_GetStreamStats. */
+typedef struct PaAlsaStreamStats
+{
+    unsigned long underrunCount;    /**< Playback xruns recovered from */
+    unsigned long overrunCount;     /**< Capture xruns recovered from */
+
+    unsigned long callbackCount;
+    /** Callback durations, bin i counts callbacks that took less than 2^i microseconds (and
+     * at least 2^(i-1)); the last bin also counts everything longer. */
+    unsigned long callbackHistogram[paAlsaCallbackHistogramBins];
+    PaTime maxCallbackDuration;     /**< Seconds */
+
+    /** Deviation of the interval between two callback thread wakeups from the period time, in seconds */
+    PaTime meanWakeupJitter;
+    PaTime maxWakeupJitter;
+
+    unsigned int numPeriods;        /**< Playback periods currently kept filled */
+    unsigned int maxPeriods;        /**< Periods in the ALSA playback buffer */
+}
+PaAlsaStreamStats;
+
+/** Get xrun, callback duration and wakeup jitter statistics of a running stream.
+ *
+ * Callback durations and wakeup jitter are only collected for callback streams. The statistics
+ * are updated from the audio thread, so a snapshot may be slightly inconsistent.
+ */
+PaError PaAlsa_GetStreamStats( PaStream *s, PaAlsaStreamStats *stats );
+
+/** Clear the statistics of a stream. The audio thread performs the reset on its next wakeup. */
+PaError PaAlsa_ResetStreamStats( PaStream *s );
+
+/** Instruct whether to adapt the number of filled playback periods at run-time.
+ *
+ * The ALSA buffer allocated when opening the stream (see suggestedLatency) is the upper bound,
+ * two periods are the lower bound. When enabled the stream keeps the whole buffer filled
+ * initially, and withholds one more period from the device every time stableSeconds pass
+ * without an xrun. After xrunsToGrow xruns at the current size, one period is given back.
+ * @param xrunsToGrow Pass 0 for the default (2).
+ * @param stableSeconds Pass 0 for the default (10 seconds).
+ */
+PaError PaAlsa_EnableAdaptivePeriods( PaStream *s, int enable, int xrunsToGrow, double stableSeconds );
+
 /** Set the maximum number of times to retry opening busy device (sleeping for a
  * short interval inbetween).
  */
@@ -1071,6 +1071,42 @@ PaTime Pa_GetStreamTime( PaStream *stream );
 double Pa_GetStreamCpuLoad( PaStream* stream );
 
 
+/** Per-callback timing of a callback stream.
+
+ Durations are in seconds and cover the same processing as Pa_GetStreamCpuLoad().
+ Percentiles are taken from a histogram and are accurate to about 25%.
+
+ @see Pa_GetStreamTimingStats
+*/
+typedef struct PaStreamTimingStats
+{
+    unsigned long callbackCount;
+    /** Number of callbacks that took longer than the duration of the audio they processed. */
+    unsigned long overBudgetCount;
+    PaTime minCallbackDuration;
+    PaTime maxCallbackDuration;
+    PaTime callbackDuration50thPercentile;
+    PaTime callbackDuration95thPercentile;
+    PaTime callbackDuration99thPercentile;
+} PaStreamTimingStats;
+
+
+/** Retrieve per-callback timing information for the specified stream, collected
+ since the stream was last started.
+
+ Unlike Pa_GetStreamCpuLoad() this reports the worst case and the distribution
+ of the processing time of individual callbacks, so single spikes which cause
+ glitches are not averaged away. All fields are zero for blocking read/write
+ streams, and for host APIs which do not measure their callback.
+
+ This function may be called from the stream callback function or the
+ application.
+
+ @return paNoError on success, or an error code if the stream pointer is invalid.
+*/
+PaError Pa_GetStreamTimingStats( PaStream* stream, PaStreamTimingStats *stats );
+
+
 /** Read samples from an input stream. The function doesn't return until
  the entire buffer has been filled - this may involve waiting for the operating
  system to supply the data.
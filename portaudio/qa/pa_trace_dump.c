@@ -0,0 +1,207 @@
+/** @file pa_trace_dump.c
+	@ingroup qa_src
+	@brief Convert a binary trace written by PaUtil_WriteBinaryTrace() to Chrome trace JSON.
+
+	Usage: pa_trace_dump trace.bin [trace.json]
+
+	The output can be loaded in chrome://tracing or any other viewer of the
+	Trace Event Format. Every trace buffer becomes a thread, records with
+	paUtilTraceBegin/paUtilTraceEnd become spans.
+
+	Build with: cc -I src/common qa/pa_trace_dump.c -o pa_trace_dump
+*/
+/*
+ * This program uses the PortAudio Portable Audio Library.
+ * For more information see: http://www.portaudio.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however,
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also
+ * requested that these non-binding requests be included along with the
+ * license above.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pa_trace.h"
+
+#define MAX_STRING_LENGTH  (1024)
+
+static int ReadUint( FILE* f, PaUint32* value )
+{
+    return fread( value, sizeof(*value), 1, f ) == 1;
+}
+
+/* Read a length prefixed string, returns a malloced, terminated copy */
+static char* ReadString( FILE* f )
+{
+    PaUint32 length;
+    char* str;
+
+    if( !ReadUint( f, &length ) || length > MAX_STRING_LENGTH )
+        return NULL;
+    str = (char*)malloc( length + 1 );
+    if( str == NULL )
+        return NULL;
+    if( fread( str, 1, length, f ) != length )
+    {
+        free( str );
+        return NULL;
+    }
+    str[length] = 0;
+    return str;
+}
+
+/* Print a string as a JSON string literal */
+static void PrintJsonString( FILE* out, const char* str )
+{
+    fputc( '"', out );
+    for( ; *str; ++str )
+    {
+        if( *str == '"' || *str == '\\' )
+            fprintf( out, "\\%c", *str );
+        else if( (unsigned char)*str < 0x20 )
+            fprintf( out, "\\u%04x", (unsigned char)*str );
+        else
+            fputc( *str, out );
+    }
+    fputc( '"', out );
+}
+
+int main( int argc, char* argv[] )
+{
+    PaUtilTraceFileHeader header;
+    char* eventNames[PA_MAX_TRACE_EVENT_NAMES];
+    FILE* in;
+    FILE* out = stdout;
+    PaUint32 i, j;
+    int first = 1;
+    int result = EXIT_FAILURE;
+
+    memset( eventNames, 0, sizeof(eventNames) );
+
+    if( argc < 2 )
+    {
+        fprintf( stderr, "usage: %s trace.bin [trace.json]\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+    in = fopen( argv[1], "rb" );
+    if( in == NULL )
+    {
+        fprintf( stderr, "Could not open %s\n", argv[1] );
+        return EXIT_FAILURE;
+    }
+    if( argc > 2 )
+    {
+        out = fopen( argv[2], "w" );
+        if( out == NULL )
+        {
+            fprintf( stderr, "Could not open %s\n", argv[2] );
+            fclose( in );
+            return EXIT_FAILURE;
+        }
+    }
+
+    if( fread( &header, sizeof(header), 1, in ) != 1 ||
+            header.magic != PA_TRACE_FILE_MAGIC || header.version != PA_TRACE_FILE_VERSION )
+    {
+        fprintf( stderr, "%s is not a binary trace of version %d\n", argv[1], PA_TRACE_FILE_VERSION );
+        goto done;
+    }
+
+    for( i=0; i<header.numEventNames; i++ )
+    {
+        PaUint32 eventId;
+        char* name;
+        if( !ReadUint( in, &eventId ) || (name = ReadString( in )) == NULL )
+            goto truncated;
+        if( eventId < PA_MAX_TRACE_EVENT_NAMES )
+        {
+            free( eventNames[eventId] );
+            eventNames[eventId] = name;
+        }
+        else
+        {
+            free( name );
+        }
+    }
+
+    fprintf( out, "{\"traceEvents\":[\n" );
+    for( i=0; i<header.numBuffers; i++ )
+    {
+        PaUint32 numRecords, dropped;
+        char* threadName = ReadString( in );
+
+        if( threadName == NULL || !ReadUint( in, &numRecords ) || !ReadUint( in, &dropped ) )
+        {
+            free( threadName );
+            goto truncated;
+        }
+
+        fprintf( out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",\n", (unsigned)i );
+        PrintJsonString( out, threadName );
+        fprintf( out, "}}" );
+        first = 0;
+        if( dropped > 0 )
+            fprintf( stderr, "%s: %u oldest records were overwritten\n", threadName, (unsigned)dropped );
+        free( threadName );
+
+        for( j=0; j<numRecords; j++ )
+        {
+            PaUtilTraceRecord record;
+            static const char* phases[] = { "i", "B", "E" };
+            const char* phase;
+
+            if( fread( &record, sizeof(record), 1, in ) != 1 )
+                goto truncated;
+
+            phase = record.phase < 3 ? phases[record.phase] : "i";
+            fprintf( out, ",\n{\"name\":" );
+            if( record.eventId < PA_MAX_TRACE_EVENT_NAMES && eventNames[record.eventId] != NULL )
+                PrintJsonString( out, eventNames[record.eventId] );
+            else
+                fprintf( out, "\"event %u\"", (unsigned)record.eventId );
+            fprintf( out, ",\"ph\":\"%s\",%s\"ts\":%.3f,\"pid\":0,\"tid\":%u,\"args\":{\"arg0\":%ld,\"arg1\":%ld}}",
+                    phase, record.phase == paUtilTraceInstant ? "\"s\":\"t\"," : "",
+                    record.timeStamp * 1000000., (unsigned)i, (long)record.arg0, (long)record.arg1 );
+        }
+    }
+    fprintf( out, "\n]}\n" );
+    result = EXIT_SUCCESS;
+    goto done;
+
+truncated:
+    fprintf( stderr, "%s is truncated\n", argv[1] );
+done:
+    for( i=0; i<PA_MAX_TRACE_EVENT_NAMES; i++ )
+        free( eventNames[i] );
+    fclose( in );
+    if( out != stdout )
+        fclose( out );
+    return result;
+}
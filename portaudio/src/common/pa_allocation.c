@@ -44,83 +44,72 @@
 */
 
 
+#include <assert.h>
+
 #include "pa_allocation.h"
 #include "pa_util.h"
 
 
 /*
-    Maintain 3 singly linked lists...
-    linkBlocks: the buffers used to allocate the links
-    spareLinks: links available for use in the allocations list
-    allocations: the buffers currently allocated using PaUtil_ContextAllocateMemory()
-
-    Link block size is doubled every time new links are allocated.
+    Blocks are allocated from a singly linked list of chunks, most recent
+    first. The head chunk is the one being bumped; once it is full a new
+    chunk twice its size (up to PA_MAX_CHUNK_SIZE_) is put in front of it.
+    Blocks larger than a quarter of the maximum chunk size get a dedicated
+    chunk of their own, which is inserted behind the head so that the head
+    keeps serving small blocks and the large block can be returned to the
+    system by PaUtil_GroupFreeMemory.
 */
 
 
-#define PA_INITIAL_LINK_COUNT_    16
+#define PA_INITIAL_CHUNK_SIZE_    1024
+#define PA_MAX_CHUNK_SIZE_        (64 * 1024)
+#define PA_DEDICATED_BLOCK_SIZE_  (PA_MAX_CHUNK_SIZE_ / 4)
+#define PA_BLOCK_ALIGNMENT_       16
+
+#define PA_ALIGN_( size ) \
+    ( ((size) + PA_BLOCK_ALIGNMENT_ - 1) & ~(long)(PA_BLOCK_ALIGNMENT_ - 1) )
 
-struct PaUtilAllocationGroupLink
+struct PaUtilAllocationGroupChunk
 {
-    struct PaUtilAllocationGroupLink *next;
-    void *buffer;
+    struct PaUtilAllocationGroupChunk *next;
+    long size;          /* bytes available for blocks */
+    long used;          /* bytes handed out */
+    long lastBlock;     /* offset of the most recent block, so freeing it can roll back */
+    int dedicated;      /* holds a single large block */
 };
 
-/*
-    Allocate a block of links. The first link will have it's buffer member
-    pointing to the block, and it's next member set to <nextBlock>. The remaining
-    links will have NULL buffer members, and each link will point to
-    the next link except the last, which will point to <nextSpare>
-*/
-static struct PaUtilAllocationGroupLink *AllocateLinks( long count,
-        struct PaUtilAllocationGroupLink *nextBlock,
-        struct PaUtilAllocationGroupLink *nextSpare )
+#define PA_CHUNK_HEADER_SIZE_     PA_ALIGN_( (long)sizeof(struct PaUtilAllocationGroupChunk) )
+#define PA_CHUNK_DATA_( chunk )   ( (char*)(chunk) + PA_CHUNK_HEADER_SIZE_ )
+
+
+static struct PaUtilAllocationGroupChunk *AllocateChunk( long size, int dedicated )
 {
-    struct PaUtilAllocationGroupLink *result;
-    int i;
-    
-    result = (struct PaUtilAllocationGroupLink *)PaUtil_AllocateMemory(
-            sizeof(struct PaUtilAllocationGroupLink) * count );
+    struct PaUtilAllocationGroupChunk *result;
+
+    result = (struct PaUtilAllocationGroupChunk *)PaUtil_AllocateMemory( PA_CHUNK_HEADER_SIZE_ + size );
     if( result )
     {
-        /* the block link */
-        result[0].buffer = result;
-        result[0].next = nextBlock;
-
-        /* the spare links */
-        for( i=1; i<count; ++i )
-        {
-            result[i].buffer = 0;
-            result[i].next = &result[i+1];
-        }
-        result[count-1].next = nextSpare;
+        result->next = 0;
+        result->size = size;
+        result->used = 0;
+        result->lastBlock = -1;
+        result->dedicated = dedicated;
     }
-    
+
     return result;
 }
 
 
 PaUtilAllocationGroup* PaUtil_CreateAllocationGroup( void )
 {
-    PaUtilAllocationGroup* result = 0;
-    struct PaUtilAllocationGroupLink *links;
+    PaUtilAllocationGroup* result;
 
-
-    links = AllocateLinks( PA_INITIAL_LINK_COUNT_, 0, 0 );
-    if( links != 0 )
+    /* The first chunk is allocated lazily, many groups stay small */
+    result = (PaUtilAllocationGroup*)PaUtil_AllocateMemory( sizeof(PaUtilAllocationGroup) );
+    if( result )
     {
-        result = (PaUtilAllocationGroup*)PaUtil_AllocateMemory( sizeof(PaUtilAllocationGroup) );
-        if( result )
-        {
-            result->linkCount = PA_INITIAL_LINK_COUNT_;
-            result->linkBlocks = &links[0];
-            result->spareLinks = &links[1];
-            result->allocations = 0;
-        }
-        else
-        {
-            PaUtil_FreeMemory( links );
-        }
+        result->nextChunkSize = PA_INITIAL_CHUNK_SIZE_;
+        result->chunks = 0;
     }
 
     return result;
@@ -129,13 +118,13 @@ PaUtilAllocationGroup* PaUtil_CreateAllocationGroup( void )
 
 void PaUtil_DestroyAllocationGroup( PaUtilAllocationGroup* group )
 {
-    struct PaUtilAllocationGroupLink *current = group->linkBlocks;
-    struct PaUtilAllocationGroupLink *next;
+    struct PaUtilAllocationGroupChunk *current = group->chunks;
+    struct PaUtilAllocationGroupChunk *next;
 
     while( current )
     {
         next = current->next;
-        PaUtil_FreeMemory( current->buffer );
+        PaUtil_FreeMemory( current );
         current = next;
     }
 
@@ -145,99 +134,116 @@ void PaUtil_DestroyAllocationGroup( PaUtilAllocationGroup* group )
 
 void* PaUtil_GroupAllocateMemory( PaUtilAllocationGroup* group, long size )
 {
-    struct PaUtilAllocationGroupLink *links, *link;
-    void *result = 0;
-    
-    /* allocate more links if necessary */
-    if( !group->spareLinks )
+    struct PaUtilAllocationGroupChunk *chunk = group->chunks;
+    long alignedSize = PA_ALIGN_( size > 0 ? size : 1 );
+    void *result;
+
+    if( alignedSize >= PA_DEDICATED_BLOCK_SIZE_ )
     {
-        /* double the link count on each block allocation */
-        links = AllocateLinks( group->linkCount, group->linkBlocks, group->spareLinks );
-        if( links )
+        chunk = AllocateChunk( alignedSize, 1 );
+        if( !chunk )
+            return 0;
+
+        if( group->chunks )
+        {
+            chunk->next = group->chunks->next;
+            group->chunks->next = chunk;
+        }
+        else
         {
-            group->linkCount += group->linkCount;
-            group->linkBlocks = &links[0];
-            group->spareLinks = &links[1];
+            group->chunks = chunk;
         }
     }
-
-    if( group->spareLinks )
+    else if( !chunk || chunk->dedicated || chunk->size - chunk->used < alignedSize )
     {
-        result = PaUtil_AllocateMemory( size );
-        if( result )
-        {
-            link = group->spareLinks;
-            group->spareLinks = link->next;
+        /* double the chunk size on each chunk allocation */
+        while( group->nextChunkSize < alignedSize )
+            group->nextChunkSize += group->nextChunkSize;
 
-            link->buffer = result;
-            link->next = group->allocations;
+        chunk = AllocateChunk( group->nextChunkSize, 0 );
+        if( !chunk )
+            return 0;
 
-            group->allocations = link;
-        }
+        if( group->nextChunkSize < PA_MAX_CHUNK_SIZE_ )
+            group->nextChunkSize += group->nextChunkSize;
+
+        chunk->next = group->chunks;
+        group->chunks = chunk;
     }
 
-    return result;    
+    result = PA_CHUNK_DATA_( chunk ) + chunk->used;
+    chunk->lastBlock = chunk->used;
+    chunk->used += alignedSize;
+
+    return result;
 }
 
 
 void PaUtil_GroupFreeMemory( PaUtilAllocationGroup* group, void *buffer )
 {
-    struct PaUtilAllocationGroupLink *current = group->allocations;
-    struct PaUtilAllocationGroupLink *previous = 0;
+    struct PaUtilAllocationGroupChunk *current = group->chunks;
+    struct PaUtilAllocationGroupChunk *previous = 0;
 
     if( buffer == 0 )
         return;
 
-    /* find the right link and remove it */
+    /* find the chunk holding the block */
     while( current )
     {
-        if( current->buffer == buffer )
+        char *data = PA_CHUNK_DATA_( current );
+
+        if( (char*)buffer >= data && (char*)buffer < data + current->size )
         {
-            if( previous )
+            if( current->dedicated )
             {
-                previous->next = current->next;
+                if( previous )
+                    previous->next = current->next;
+                else
+                    group->chunks = current->next;
+
+                PaUtil_FreeMemory( current );
             }
-            else
+            else if( (char*)buffer == data + current->lastBlock )
             {
-                group->allocations = current->next;
+                current->used = current->lastBlock;
+                current->lastBlock = -1;
             }
+            /* otherwise the space is reclaimed by PaUtil_FreeAllAllocations */
 
-            current->buffer = 0;
-            current->next = group->spareLinks;
-            group->spareLinks = current;
-
-            break;
+            return;
         }
-        
+
         previous = current;
         current = current->next;
     }
 
-    PaUtil_FreeMemory( buffer ); /* free the memory whether we found it in the list or not */
+    assert( !"PaUtil_GroupFreeMemory: block was not allocated from this group" );
 }
 
 
 void PaUtil_FreeAllAllocations( PaUtilAllocationGroup* group )
 {
-    struct PaUtilAllocationGroupLink *current = group->allocations;
-    struct PaUtilAllocationGroupLink *previous = 0;
+    struct PaUtilAllocationGroupChunk *current = group->chunks;
+    struct PaUtilAllocationGroupChunk *next;
+    struct PaUtilAllocationGroupChunk *kept = 0;
 
-    /* free all buffers in the allocations list */
+    /* keep the most recent regular chunk, it is the largest one */
     while( current )
     {
-        PaUtil_FreeMemory( current->buffer );
-        current->buffer = 0;
-
-        previous = current;
-        current = current->next;
+        next = current->next;
+        if( !kept && !current->dedicated )
+        {
+            kept = current;
+            kept->next = 0;
+            kept->used = 0;
+            kept->lastBlock = -1;
+        }
+        else
+        {
+            PaUtil_FreeMemory( current );
+        }
+        current = next;
     }
 
-    /* link the former allocations list onto the front of the spareLinks list */
-    if( previous )
-    {
-        previous->next = group->spareLinks;
-        group->spareLinks = group->allocations;
-        group->allocations = 0;
-    }
+    group->chunks = kept;
 }
-
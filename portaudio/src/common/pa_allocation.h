@@ -52,7 +52,10 @@
  can be usefull for cleaning up after a partially initialized object fails.
 
  The allocation group implementation is built on top of the lower
- level allocation functions defined in pa_util.h
+ level allocation functions defined in pa_util.h. Blocks are carved out of
+ larger chunks (a bump allocator), so a group only calls PaUtil_AllocateMemory
+ when a chunk is exhausted, and freeing everything costs one
+ PaUtil_FreeMemory per chunk.
 */
 
 
@@ -64,10 +67,8 @@ extern "C"
 
 typedef struct
 {
-    long linkCount;
-    struct PaUtilAllocationGroupLink *linkBlocks;
-    struct PaUtilAllocationGroupLink *spareLinks;
-    struct PaUtilAllocationGroupLink *allocations;
+    long nextChunkSize;
+    struct PaUtilAllocationGroupChunk *chunks; /* Most recently allocated first */
 }PaUtilAllocationGroup;
 
 
@@ -76,7 +77,9 @@ typedef struct
 */
 PaUtilAllocationGroup* PaUtil_CreateAllocationGroup( void );
 
-/** Destroy an allocation group, but not the memory allocated through the group.
+/** Destroy an allocation group. The memory allocated through the group lives
+ in the group's chunks, so call this only once the blocks are no longer used,
+ normally right after PaUtil_FreeAllAllocations.
 */
 void PaUtil_DestroyAllocationGroup( PaUtilAllocationGroup* group );
 
@@ -88,12 +91,17 @@ void* PaUtil_GroupAllocateMemory( PaUtilAllocationGroup* group, long size );
  group. Calling this function is a relatively time consuming operation.
  Under normal circumstances clients should call PaUtil_FreeAllAllocations to
  free all allocated blocks simultaneously.
+
+ Large blocks are returned to the system immediately. Small blocks are only
+ reclaimed if they were the most recent allocation, otherwise their space is
+ held until PaUtil_FreeAllAllocations is called.
  @see PaUtil_FreeAllAllocations
 */
 void PaUtil_GroupFreeMemory( PaUtilAllocationGroup* group, void *buffer );
 
 /** Free all blocks of memory which have been allocated through the allocation
- group. This function doesn't destroy the group itself.
+ group. This function doesn't destroy the group itself. The most recent
+ chunk is kept for reuse by later allocations.
 */
 void PaUtil_FreeAllAllocations( PaUtilAllocationGroup* group );
 
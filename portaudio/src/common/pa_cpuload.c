@@ -57,17 +57,69 @@
 #include "pa_util.h"   /* for PaUtil_GetTime() */
 
 
+#define SUBBINS     PA_CPULOAD_HISTOGRAM_SUBBINS
+
+/* Map a duration to a histogram bin. Below SUBBINS microseconds bins are
+ one microsecond wide, every power of two above that is split into SUBBINS
+ equally wide bins, keeping the relative error of percentiles bounded.
+*/
+static int DurationToBin( double seconds )
+{
+    unsigned long usecs = (unsigned long)(seconds * 1000000.);
+    unsigned long mantissa = usecs;
+    int octave = 0, bin;
+
+    if( usecs < SUBBINS )
+        return (int)usecs;
+
+    while( mantissa >= 2 * SUBBINS )
+    {
+        mantissa >>= 1;
+        ++octave;
+    }
+
+    bin = SUBBINS + octave * SUBBINS + (int)(mantissa - SUBBINS);
+    return bin < PA_CPULOAD_HISTOGRAM_BINS ? bin : PA_CPULOAD_HISTOGRAM_BINS - 1;
+}
+
+/* Upper bound of a histogram bin in seconds. */
+static double BinToDuration( int bin )
+{
+    int octave, mantissa;
+
+    if( bin < SUBBINS )
+        return (bin + 1) * .000001;
+
+    octave = (bin - SUBBINS) / SUBBINS;
+    mantissa = (bin - SUBBINS) % SUBBINS + SUBBINS;
+    return (double)((unsigned long)(mantissa + 1) << octave) * .000001;
+}
+
+static void ResetTiming( PaUtilCpuLoadMeasurer* measurer )
+{
+    int i;
+
+    measurer->callbackCount = 0;
+    measurer->overBudgetCount = 0;
+    measurer->minDuration = 0.;
+    measurer->maxDuration = 0.;
+    for( i=0; i < PA_CPULOAD_HISTOGRAM_BINS; ++i )
+        measurer->histogram[i] = 0;
+}
+
 void PaUtil_InitializeCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer, double sampleRate )
 {
     assert( sampleRate > 0 );
 
     measurer->samplingPeriod = 1. / sampleRate;
     measurer->averageLoad = 0.;
+    ResetTiming( measurer );
 }
 
 void PaUtil_ResetCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer )
 {
     measurer->averageLoad = 0.;
+    ResetTiming( measurer );
 }
 
 void PaUtil_BeginCpuLoadMeasurement( PaUtilCpuLoadMeasurer* measurer )
@@ -78,7 +130,7 @@ void PaUtil_BeginCpuLoadMeasurement( PaUtilCpuLoadMeasurer* measurer )
 
 void PaUtil_EndCpuLoadMeasurement( PaUtilCpuLoadMeasurer* measurer, unsigned long framesProcessed )
 {
-    double measurementEndTime, secondsFor100Percent, measuredLoad;
+    double measurementEndTime, secondsFor100Percent, measuredLoad, duration;
 
     if( framesProcessed > 0 ){
         measurementEndTime = PaUtil_GetTime();
@@ -86,7 +138,17 @@ void PaUtil_EndCpuLoadMeasurement( PaUtilCpuLoadMeasurer* measurer, unsigned lon
         assert( framesProcessed > 0 );
         secondsFor100Percent = framesProcessed * measurer->samplingPeriod;
 
-        measuredLoad = (measurementEndTime - measurer->measurementStartTime) / secondsFor100Percent;
+        duration = measurementEndTime - measurer->measurementStartTime;
+        measuredLoad = duration / secondsFor100Percent;
+
+        if( measurer->callbackCount == 0 || duration < measurer->minDuration )
+            measurer->minDuration = duration;
+        if( duration > measurer->maxDuration )
+            measurer->maxDuration = duration;
+        if( duration > secondsFor100Percent )
+            ++measurer->overBudgetCount;
+        ++measurer->histogram[ DurationToBin( duration ) ];
+        ++measurer->callbackCount;
 
         /* Low pass filter the calculated CPU load to reduce jitter using a simple IIR low pass filter. */
         /** FIXME @todo these coefficients shouldn't be hardwired see: http://www.portaudio.com/trac/ticket/113 */
@@ -103,3 +165,49 @@ double PaUtil_GetCpuLoad( PaUtilCpuLoadMeasurer* measurer )
 {
     return measurer->averageLoad;
 }
+
+
+void PaUtil_GetCpuLoadTimingStats( PaUtilCpuLoadMeasurer* measurer, PaStreamTimingStats *stats )
+{
+    unsigned long histogram[ PA_CPULOAD_HISTOGRAM_BINS ];
+    unsigned long total = 0, count = 0;
+    unsigned long p50, p95, p99;
+    int i;
+
+    /* The measuring thread keeps counting while we read, work on a copy so
+     the percentiles are at least consistent with each other. */
+    for( i=0; i < PA_CPULOAD_HISTOGRAM_BINS; ++i )
+    {
+        histogram[i] = measurer->histogram[i];
+        total += histogram[i];
+    }
+
+    stats->callbackCount = measurer->callbackCount;
+    stats->overBudgetCount = measurer->overBudgetCount;
+    stats->minCallbackDuration = measurer->minDuration;
+    stats->maxCallbackDuration = measurer->maxDuration;
+    stats->callbackDuration50thPercentile = 0.;
+    stats->callbackDuration95thPercentile = 0.;
+    stats->callbackDuration99thPercentile = 0.;
+
+    if( total == 0 )
+        return;
+
+    /* Rank of the sample each percentile falls on, rounded up */
+    p50 = (total * 50 + 99) / 100;
+    p95 = (total * 95 + 99) / 100;
+    p99 = (total * 99 + 99) / 100;
+
+    for( i=0; i < PA_CPULOAD_HISTOGRAM_BINS; ++i )
+    {
+        unsigned long previous = count;
+        count += histogram[i];
+
+        if( previous < p50 && count >= p50 )
+            stats->callbackDuration50thPercentile = BinToDuration( i );
+        if( previous < p95 && count >= p95 )
+            stats->callbackDuration95thPercentile = BinToDuration( i );
+        if( previous < p99 && count >= p99 )
+            stats->callbackDuration99thPercentile = BinToDuration( i );
+    }
+}
@@ -47,16 +47,33 @@
 */
 
 
+#include "portaudio.h"
+
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif /* __cplusplus */
 
 
-typedef struct {
+/** Callback durations below this many microseconds get a bin each, above it
+ every power of two is split into this many bins.
+*/
+#define PA_CPULOAD_HISTOGRAM_SUBBINS    (4)
+#define PA_CPULOAD_HISTOGRAM_BINS       (PA_CPULOAD_HISTOGRAM_SUBBINS * 21)
+
+typedef struct PaUtilCpuLoadMeasurer {
     double samplingPeriod;
     double measurementStartTime;
     double averageLoad;
+
+    /* Per-callback timing. Only written by the thread calling
+     PaUtil_EndCpuLoadMeasurement(), so readers never block it. */
+    unsigned long callbackCount;
+    unsigned long overBudgetCount;
+    double minDuration;
+    double maxDuration;
+    unsigned long histogram[ PA_CPULOAD_HISTOGRAM_BINS ];
 } PaUtilCpuLoadMeasurer; /**< @todo need better name than measurer */
 
 void PaUtil_InitializeCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer, double sampleRate );
@@ -65,6 +82,11 @@ void PaUtil_EndCpuLoadMeasurement( PaUtilCpuLoadMeasurer* measurer, unsigned lon
 void PaUtil_ResetCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer );
 double PaUtil_GetCpuLoad( PaUtilCpuLoadMeasurer* measurer );
 
+/** Fill in stats from the per-callback timing collected so far. The
+ percentiles are upper bounds of the histogram bins they fall into.
+*/
+void PaUtil_GetCpuLoadTimingStats( PaUtilCpuLoadMeasurer* measurer, PaStreamTimingStats *stats );
+
 
 #ifdef __cplusplus
 }
@@ -73,6 +73,7 @@
 #include "pa_types.h"
 #include "pa_hostapi.h"
 #include "pa_stream.h"
+#include "pa_cpuload.h"
 #include "pa_trace.h" /* still usefull?*/
 #include "pa_debugprint.h"
 
@@ -1593,6 +1594,32 @@ double Pa_GetStreamCpuLoad( PaStream* stream )
 }
 
 
+PaError Pa_GetStreamTimingStats( PaStream* stream, PaStreamTimingStats *stats )
+{
+    PaError result = PaUtil_ValidateStreamPointer( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_GetStreamTimingStats" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tPaStreamTimingStats* stats: 0x%p\n", stats ));
+
+    if( result == paNoError )
+    {
+        if( PA_STREAM_REP(stream)->cpuLoadMeasurer == NULL )
+        {
+            memset( stats, 0, sizeof(PaStreamTimingStats) );
+        }
+        else
+        {
+            PaUtil_GetCpuLoadTimingStats( PA_STREAM_REP(stream)->cpuLoadMeasurer, stats );
+        }
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_GetStreamTimingStats", result );
+
+    return result;
+}
+
+
 PaError Pa_ReadStream( PaStream* stream,
                        void *buffer,
                        unsigned long frames )
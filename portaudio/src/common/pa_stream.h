@@ -152,6 +152,8 @@ typedef struct PaUtilStreamRepresentation {
     PaStreamFinishedCallback *streamFinishedCallback;
     void *userData;
     PaStreamInfo streamInfo;
+    /** The host API's callback measurer, used by Pa_GetStreamTimingStats(). May be NULL. */
+    struct PaUtilCpuLoadMeasurer *cpuLoadMeasurer;
 } PaUtilStreamRepresentation;
 
 
@@ -52,6 +52,7 @@
 #include "pa_trace.h"
 #include "pa_util.h"
 #include "pa_debugprint.h"
+#include "pa_memorybarrier.h"
 
 #if PA_TRACE_REALTIME_EVENTS
 
@@ -227,6 +228,206 @@ void PaUtil_DiscardHighSpeedLog( LogHandle hLog )
     PaUtil_FreeMemory(pLog);
 }
 
+/************************************************************************/
+/* Binary trace                                                         */
+/************************************************************************/
+
+struct PaUtilTraceBuffer
+{
+    struct PaUtilTraceBuffer* next;
+    const char*         threadName;
+    PaUtilTraceRecord*  records;
+    unsigned            maxRecords;
+    /* Total number of records ever added. Only the owning thread writes it,
+       readers use it to find the live part of the ring. */
+    volatile unsigned   writeCount;
+};
+
+static PaUtilTraceBuffer* traceBuffers = 0;
+static const char* traceEventNames[PA_MAX_TRACE_EVENT_NAMES];
+static double traceRefTime = 0.;
+
+void PaUtil_InitializeBinaryTrace( void )
+{
+    PaUtil_TerminateBinaryTrace();
+    memset( (void*)traceEventNames, 0, sizeof(traceEventNames) );
+    traceRefTime = PaUtil_GetTime();
+}
+
+PaUtilTraceBuffer* PaUtil_CreateBinaryTraceBuffer( const char *threadName, unsigned maxRecords )
+{
+    PaUtilTraceBuffer* buffer = (PaUtilTraceBuffer*)PaUtil_AllocateMemory( sizeof(PaUtilTraceBuffer) );
+    if( buffer == 0 )
+    {
+        return 0;
+    }
+    assert( maxRecords > 0 );
+
+    buffer->records = (PaUtilTraceRecord*)PaUtil_AllocateMemory( maxRecords * sizeof(PaUtilTraceRecord) );
+    if( buffer->records == 0 )
+    {
+        PaUtil_FreeMemory( buffer );
+        return 0;
+    }
+    buffer->threadName = threadName;
+    buffer->maxRecords = maxRecords;
+    buffer->writeCount = 0;
+
+    buffer->next = traceBuffers;
+    PaUtil_WriteMemoryBarrier();
+    traceBuffers = buffer;
+    return buffer;
+}
+
+void PaUtil_SetBinaryTraceEventName( unsigned eventId, const char *name )
+{
+    if( eventId < PA_MAX_TRACE_EVENT_NAMES )
+    {
+        traceEventNames[eventId] = name;
+    }
+}
+
+void PaUtil_AddBinaryTraceRecord( PaUtilTraceBuffer *buffer, unsigned eventId,
+        PaUtilTracePhase phase, PaInt32 arg0, PaInt32 arg1 )
+{
+    PaUtilTraceRecord* record;
+    unsigned writeCount;
+
+    if( buffer == 0 )
+    {
+        return;
+    }
+    writeCount = buffer->writeCount;
+    record = &buffer->records[ writeCount % buffer->maxRecords ];
+    record->timeStamp = PaUtil_GetTime() - traceRefTime;
+    record->eventId = (PaUint16)eventId;
+    record->phase = (PaUint16)phase;
+    record->reserved = 0;
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+
+    /* Publish the record only once it is complete */
+    PaUtil_WriteMemoryBarrier();
+    buffer->writeCount = writeCount + 1;
+}
+
+static int WriteTraceUint( FILE* f, PaUint32 value )
+{
+    return fwrite( &value, sizeof(value), 1, f ) == 1;
+}
+
+static int WriteTraceString( FILE* f, const char* str )
+{
+    PaUint32 length = (PaUint32)strlen( str );
+    return WriteTraceUint( f, length ) && fwrite( str, 1, length, f ) == length;
+}
+
+static int WriteTraceBuffer( FILE* f, PaUtilTraceBuffer* buffer )
+{
+    PaUtilTraceRecord* copy;
+    unsigned before, after, first, count, i;
+    int ok;
+
+    copy = (PaUtilTraceRecord*)PaUtil_AllocateMemory( buffer->maxRecords * sizeof(PaUtilTraceRecord) );
+    if( copy == 0 )
+    {
+        return 0;
+    }
+
+    before = buffer->writeCount;
+    PaUtil_ReadMemoryBarrier();
+    count = before < buffer->maxRecords ? before : buffer->maxRecords;
+    first = before - count;
+    for( i=0; i<count; i++ )
+    {
+        copy[i] = buffer->records[ (first + i) % buffer->maxRecords ];
+    }
+    PaUtil_ReadMemoryBarrier();
+    after = buffer->writeCount;
+
+    /* The writer may have lapped the oldest records while we were copying.
+       Record `after` may be half written too: it goes into its slot before
+       writeCount is published, so the record sharing that slot counts as lost. */
+    if( after + 1 - first > buffer->maxRecords )
+    {
+        unsigned overwritten = after + 1 - first - buffer->maxRecords;
+        if( overwritten > count )
+        {
+            overwritten = count;
+        }
+        memmove( copy, copy + overwritten, (count - overwritten) * sizeof(PaUtilTraceRecord) );
+        count -= overwritten;
+        first += overwritten;
+    }
+
+    ok = WriteTraceString( f, buffer->threadName ? buffer->threadName : "" )
+            && WriteTraceUint( f, count )
+            && WriteTraceUint( f, first )   /* dropped */
+            && fwrite( copy, sizeof(PaUtilTraceRecord), count, f ) == count;
+
+    PaUtil_FreeMemory( copy );
+    return ok;
+}
+
+int PaUtil_WriteBinaryTrace( const char *fileName )
+{
+    PaUtilTraceFileHeader header;
+    PaUtilTraceBuffer* buffer;
+    unsigned i;
+    int ok;
+    FILE* f = fopen( fileName, "wb" );
+    if( f == 0 )
+    {
+        return paInternalError;
+    }
+
+    header.magic = PA_TRACE_FILE_MAGIC;
+    header.version = PA_TRACE_FILE_VERSION;
+    header.numEventNames = 0;
+    header.numBuffers = 0;
+    for( i=0; i<PA_MAX_TRACE_EVENT_NAMES; i++ )
+    {
+        if( traceEventNames[i] != 0 )
+        {
+            header.numEventNames++;
+        }
+    }
+    for( buffer = traceBuffers; buffer != 0; buffer = buffer->next )
+    {
+        header.numBuffers++;
+    }
+
+    ok = fwrite( &header, sizeof(header), 1, f ) == 1;
+    for( i=0; ok && i<PA_MAX_TRACE_EVENT_NAMES; i++ )
+    {
+        if( traceEventNames[i] != 0 )
+        {
+            ok = WriteTraceUint( f, i ) && WriteTraceString( f, traceEventNames[i] );
+        }
+    }
+    for( buffer = traceBuffers; ok && buffer != 0; buffer = buffer->next )
+    {
+        ok = WriteTraceBuffer( f, buffer );
+    }
+
+    if( fclose( f ) != 0 )
+    {
+        ok = 0;
+    }
+    return ok ? paNoError : paInternalError;
+}
+
+void PaUtil_TerminateBinaryTrace( void )
+{
+    while( traceBuffers != 0 )
+    {
+        PaUtilTraceBuffer* next = traceBuffers->next;
+        PaUtil_FreeMemory( traceBuffers->records );
+        PaUtil_FreeMemory( traceBuffers );
+        traceBuffers = next;
+    }
+}
+
 #else
 /* This stub was added so that this file will generate a symbol.
  * Otherwise linker/archiver programs will complain.
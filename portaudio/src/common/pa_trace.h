@@ -63,8 +63,16 @@
 
  @fn PaUtil_DumpTraceMessages
  @brief Print all messages in the trace buffer to stdout and clear the trace buffer.
+
+ The binary trace (PaUtil_CreateBinaryTraceBuffer() and friends) is a lower
+ overhead alternative for tracing several threads at once. Each thread owns a
+ ring of fixed size records (time stamp, event id, two ints), so adding a
+ record never formats text, allocates or takes a lock. PaUtil_WriteBinaryTrace()
+ saves all rings to a file which qa/pa_trace_dump converts to Chrome trace JSON.
 */
 
+#include "pa_types.h"
+
 #ifndef PA_TRACE_REALTIME_EVENTS
 #define PA_TRACE_REALTIME_EVENTS     (0)   /**< Set to 1 to enable logging using the trace functions defined below */
 #endif
@@ -73,12 +81,55 @@
 #define PA_MAX_TRACE_RECORDS      (2048)   /**< Maximum number of records stored in trace buffer */   
 #endif
 
+#ifndef PA_MAX_TRACE_EVENT_NAMES
+#define PA_MAX_TRACE_EVENT_NAMES   (256)   /**< Event ids must be below this to be named in a binary trace */
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif /* __cplusplus */
 
 
+/* Binary trace file layout, shared with the dump tool. All values are in the
+ byte order of the machine which wrote the trace.
+
+ PaUtilTraceFileHeader
+ numEventNames * ( PaUint32 eventId, PaUint32 length, char name[length] )
+ numBuffers * ( PaUint32 length, char threadName[length],
+                PaUint32 numRecords, PaUint32 droppedRecords,
+                PaUtilTraceRecord records[numRecords] )
+*/
+
+#define PA_TRACE_FILE_MAGIC     (0x52544150)   /* "PATR" */
+#define PA_TRACE_FILE_VERSION   (1)
+
+typedef enum PaUtilTracePhase
+{
+    paUtilTraceInstant = 0,     /**< A point in time */
+    paUtilTraceBegin = 1,       /**< Start of a span on this thread */
+    paUtilTraceEnd = 2          /**< End of the innermost open span on this thread */
+} PaUtilTracePhase;
+
+typedef struct PaUtilTraceRecord
+{
+    double timeStamp;           /**< Seconds since PaUtil_InitializeBinaryTrace() */
+    PaUint16 eventId;
+    PaUint16 phase;             /**< A PaUtilTracePhase */
+    PaUint32 reserved;
+    PaInt32 arg0;
+    PaInt32 arg1;
+} PaUtilTraceRecord;
+
+typedef struct PaUtilTraceFileHeader
+{
+    PaUint32 magic;
+    PaUint32 version;
+    PaUint32 numEventNames;
+    PaUint32 numBuffers;
+} PaUtilTraceFileHeader;
+
+
 #if PA_TRACE_REALTIME_EVENTS
 
 void PaUtil_ResetTraceMessages();
@@ -95,6 +146,38 @@ int PaUtil_AddHighSpeedLogMessage(LogHandle hLog, const char* fmt, ...);
 void PaUtil_DumpHighSpeedLog(LogHandle hLog, const char* fileName);
 void PaUtil_DiscardHighSpeedLog(LogHandle hLog);
 
+/* Binary trace */
+
+typedef struct PaUtilTraceBuffer PaUtilTraceBuffer;
+
+/** Reset the time reference and forget previously registered buffers and names. */
+void PaUtil_InitializeBinaryTrace( void );
+
+/** Create the ring buffer one thread writes its records to. Not real-time safe,
+ create buffers during setup, from one thread at a time.
+ @param threadName Must remain valid until PaUtil_WriteBinaryTrace() is called.
+ @param maxRecords Older records are overwritten once this many have been added.
+*/
+PaUtilTraceBuffer* PaUtil_CreateBinaryTraceBuffer( const char *threadName, unsigned maxRecords );
+
+/** Name an event id in the trace output. The string must remain valid. */
+void PaUtil_SetBinaryTraceEventName( unsigned eventId, const char *name );
+
+/** Add a record. Only the thread owning the buffer may call this, it is
+ wait-free and may be called from the audio callback. A NULL buffer is ignored.
+*/
+void PaUtil_AddBinaryTraceRecord( PaUtilTraceBuffer *buffer, unsigned eventId,
+        PaUtilTracePhase phase, PaInt32 arg0, PaInt32 arg1 );
+
+/** Save all buffers to a file. May be called while the traced threads are
+ running; records overwritten during the dump are left out.
+ @return paNoError or paInternalError if the file could not be written.
+*/
+int PaUtil_WriteBinaryTrace( const char *fileName );
+
+/** Free all buffers created by PaUtil_CreateBinaryTraceBuffer(). */
+void PaUtil_TerminateBinaryTrace( void );
+
 #else
 
 #define PaUtil_ResetTraceMessages() /* noop */
@@ -107,6 +190,13 @@ void PaUtil_DiscardHighSpeedLog(LogHandle hLog);
 #define PaUtil_DumpHighSpeedLog(hLog, fileName)
 #define PaUtil_DiscardHighSpeedLog(hLog)
 
+#define PaUtil_InitializeBinaryTrace() /* noop */
+#define PaUtil_CreateBinaryTraceBuffer(threadName, maxRecords)   (0)
+#define PaUtil_SetBinaryTraceEventName(eventId, name) /* noop */
+#define PaUtil_AddBinaryTraceRecord(buffer, eventId, phase, arg0, arg1) /* noop */
+#define PaUtil_WriteBinaryTrace(fileName)   (0)
+#define PaUtil_TerminateBinaryTrace() /* noop */
+
 #endif
 
 
@@ -621,6 +621,7 @@ typedef struct
     StreamDirection streamDir;
 
     snd_pcm_channel_area_t *channelAreas;  /* Needed for channel adaption */
+    snd_pcm_uframes_t reservedFrames;      /* Buffer space withheld from the user by adaptive period sizing */
 } PaAlsaStreamComponent;
 
 /* Implementation specific stream structure */
@@ -654,6 +655,21 @@ typedef struct PaAlsaStream
     PaTime underrun;
     PaTime overrun;
 
+    /* Telemetry, only written by the thread doing the I/O */
+    PaAlsaStreamStats stats;
+    PaTime periodTime;                      /* Nominal interval between wakeups */
+    PaTime lastWakeup;
+    PaTime jitterSum;
+    unsigned long jitterCount;
+    volatile sig_atomic_t resetStats;       /* Set by PaAlsa_ResetStreamStats */
+
+    /* Adaptive period sizing */
+    volatile sig_atomic_t adaptivePeriods;
+    int xrunsToGrow;
+    PaTime stableTimeToShrink;
+    int xrunsSinceResize;
+    PaTime stableSince;
+
     PaAlsaStreamComponent capture, playback;
 }
 PaAlsaStream;
@@ -2176,6 +2192,7 @@ static PaError PaAlsaStream_Initialize( PaAlsaStream *self, PaAlsaHostApiReprese
                     self->playback.nfds ) * sizeof( struct pollfd ) ), paInsufficientMemory );
 
     PaUtil_InitializeCpuLoadMeasurer( &self->cpuLoadMeasurer, sampleRate );
+    self->streamRepresentation.cpuLoadMeasurer = &self->cpuLoadMeasurer;
     ASSERT_CALL_( PaUnixMutex_Initialize( &self->stateMtx ), paNoError );
 
 error:
@@ -2732,6 +2749,9 @@ static PaError PaAlsaStream_Configure( PaAlsaStream *self, const PaStreamParamet
         PA_ENSURE( PaAlsaStreamComponent_FinishConfigure( &self->playback, hwParamsPlayback, outParams, self->primeBuffers, realSr,
                     outputLatency ) );
         PA_DEBUG(( "%s: Playback period size: %lu, latency: %f\n", __FUNCTION__, self->playback.framesPerPeriod, *outputLatency ));
+
+        self->stats.maxPeriods = self->playback.alsaBufferSize / self->playback.framesPerPeriod;
+        self->stats.numPeriods = self->stats.maxPeriods;
     }
 
     /* Should be exact now */
@@ -2754,6 +2774,7 @@ static PaError PaAlsaStream_Configure( PaAlsaStream *self, const PaStreamParamet
         unsigned long minFramesPerHostBuffer = PA_MIN( self->capture.pcm ? self->capture.framesPerPeriod : ULONG_MAX,
             self->playback.pcm ? self->playback.framesPerPeriod : ULONG_MAX );
         self->pollTimeout = CalculatePollTimeout( self, minFramesPerHostBuffer );    /* Period in msecs, rounded up */
+        self->periodTime = minFramesPerHostBuffer / realSr;
 
         /* Time before watchdog unthrottles realtime thread == 1/4 of period time in msecs */
         /* self->threading.throttledSleepTime = (unsigned long) (minFramesPerHostBuffer / sampleRate / 4 * 1000); */
@@ -3248,6 +3269,124 @@ error:
     return result;
 }
 
+/** Keep only a number of periods of the playback buffer filled.
+ *
+ * The rest of the buffer is withheld from the user. Software parameters may be changed while the pcm is running,
+ * avail_min is raised together with the reservation so that poll() only wakes us once a whole period can be written.
+ */
+static PaError PaAlsaStreamComponent_SetFilledPeriods( PaAlsaStreamComponent *self, unsigned int numPeriods )
+{
+    PaError result = paNoError;
+    snd_pcm_sw_params_t* swParams;
+
+    alsa_snd_pcm_sw_params_alloca( &swParams );
+
+    if( numPeriods < self->alsaBufferSize / self->framesPerPeriod )
+        self->reservedFrames = self->alsaBufferSize - numPeriods * self->framesPerPeriod;
+    else
+        self->reservedFrames = 0;
+
+    ENSURE_( alsa_snd_pcm_sw_params_current( self->pcm, swParams ), paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_sw_params_set_avail_min( self->pcm, swParams, self->framesPerPeriod + self->reservedFrames ),
+            paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_sw_params( self->pcm, swParams ), paUnanticipatedHostError );
+
+error:
+    return result;
+}
+
+/** Grow or shrink the filled part of the playback buffer according to the recent xrun history.
+ *
+ * @param xrun Whether we are called because of a playback xrun
+ */
+static PaError PaAlsaStream_AdaptPeriods( PaAlsaStream *self, int xrun )
+{
+    PaError result = paNoError;
+    unsigned int numPeriods = self->stats.numPeriods;
+    PaTime now;
+
+    if( !self->adaptivePeriods || !self->playback.pcm )
+        return result;
+
+    now = PaUtil_GetTime();
+    if( 0. == self->stableSince )
+        self->stableSince = now;
+
+    if( xrun )
+    {
+        self->stableSince = now;
+        if( ++self->xrunsSinceResize >= self->xrunsToGrow && numPeriods < self->stats.maxPeriods )
+            ++numPeriods;
+    }
+    else if( now - self->stableSince >= self->stableTimeToShrink && numPeriods > 2 )
+    {
+        --numPeriods;
+    }
+
+    if( numPeriods != self->stats.numPeriods )
+    {
+        PA_DEBUG(( "%s: Keeping %u of %u periods filled\n", __FUNCTION__, numPeriods, self->stats.maxPeriods ));
+        PA_ENSURE( PaAlsaStreamComponent_SetFilledPeriods( &self->playback, numPeriods ) );
+        self->stats.numPeriods = numPeriods;
+        self->xrunsSinceResize = 0;
+        self->stableSince = now;
+    }
+
+error:
+    return result;
+}
+
+/** Record the time spent in one invocation of the buffer processor.
+ */
+static void PaAlsaStream_RecordCallbackDuration( PaAlsaStream *self, PaTime duration )
+{
+    unsigned long usecs = (unsigned long)(duration * 1000000.);
+    int bin = 0;
+
+    while( usecs > 0 && bin < paAlsaCallbackHistogramBins - 1 )
+    {
+        usecs >>= 1;
+        ++bin;
+    }
+
+    ++self->stats.callbackCount;
+    ++self->stats.callbackHistogram[bin];
+    if( duration > self->stats.maxCallbackDuration )
+        self->stats.maxCallbackDuration = duration;
+}
+
+/** Record the deviation of the time between two wakeups from the period time.
+ */
+static void PaAlsaStream_RecordWakeup( PaAlsaStream *self )
+{
+    PaTime now = PaUtil_GetTime();
+
+    if( self->lastWakeup > 0. )
+    {
+        PaTime jitter = fabs( now - self->lastWakeup - self->periodTime );
+        self->jitterSum += jitter;
+        ++self->jitterCount;
+        if( jitter > self->stats.maxWakeupJitter )
+            self->stats.maxWakeupJitter = jitter;
+    }
+    self->lastWakeup = now;
+}
+
+/** Clear the statistics, keeping the current period configuration.
+ */
+static void PaAlsaStream_ResetStats( PaAlsaStream *self )
+{
+    unsigned int numPeriods = self->stats.numPeriods, maxPeriods = self->stats.maxPeriods;
+
+    memset( &self->stats, 0, sizeof (PaAlsaStreamStats) );
+    self->stats.numPeriods = numPeriods;
+    self->stats.maxPeriods = maxPeriods;
+    self->jitterSum = 0.;
+    self->jitterCount = 0;
+    self->lastWakeup = 0.;
+    self->resetStats = 0;
+}
+
 /** Recover from xrun state.
  *
  */
@@ -3258,6 +3397,7 @@ static PaError PaAlsaStream_HandleXrun( PaAlsaStream *self )
     PaTime now = PaUtil_GetTime();
     snd_timestamp_t t;
     int restartAlsa = 0; /* do not restart Alsa by default */
+    int playbackXrun = 0;
 
     alsa_snd_pcm_status_alloca( &st );
 
@@ -3268,6 +3408,8 @@ static PaError PaAlsaStream_HandleXrun( PaAlsaStream *self )
         {
             alsa_snd_pcm_status_get_trigger_tstamp( st, &t );
             self->underrun = now * 1000 - ( (PaTime)t.tv_sec * 1000 + (PaTime)t.tv_usec / 1000 );
+            ++self->stats.underrunCount;
+            playbackXrun = 1;
 
             if( !self->playback.canMmap )
             {
@@ -3288,6 +3430,7 @@ static PaError PaAlsaStream_HandleXrun( PaAlsaStream *self )
         {
             alsa_snd_pcm_status_get_trigger_tstamp( st, &t );
             self->overrun = now * 1000 - ((PaTime) t.tv_sec * 1000 + (PaTime) t.tv_usec / 1000);
+            ++self->stats.overrunCount;
 
             if (!self->capture.canMmap)
             {
@@ -3308,6 +3451,13 @@ static PaError PaAlsaStream_HandleXrun( PaAlsaStream *self )
         PA_ENSURE( AlsaRestart( self ) );
     }
 
+    /* The recovery gap is not wakeup jitter */
+    self->lastWakeup = 0.;
+    if( playbackXrun )
+    {
+        PA_ENSURE( PaAlsaStream_AdaptPeriods( self, 1 ) );
+    }
+
 end:
     return result;
 error:
@@ -3620,7 +3770,11 @@ static PaError PaAlsaStreamComponent_GetAvailableFrames( PaAlsaStreamComponent *
         ENSURE_( framesAvail, paUnanticipatedHostError );
     }
 
-    *numFrames = framesAvail;
+    /* Adaptive period sizing keeps part of the playback buffer unavailable */
+    if( (snd_pcm_uframes_t)framesAvail > self->reservedFrames )
+        *numFrames = framesAvail - self->reservedFrames;
+    else
+        *numFrames = 0;
 
 error:
     return result;
@@ -3761,6 +3915,12 @@ static PaError PaAlsaStream_WaitForFrames( PaAlsaStream *self, unsigned long *fr
     assert( self );
     assert( framesAvail );
 
+    if( self->resetStats )
+    {
+        PaAlsaStream_ResetStats( self );
+    }
+    PA_ENSURE( PaAlsaStream_AdaptPeriods( self, 0 ) );
+
     if( !self->callbackMode )
     {
         /* In blocking mode we will only wait if necessary */
@@ -4256,6 +4416,11 @@ static void *CallbackThreadFunc( void *userData )
              */
         }
 
+        if( framesAvail > 0 )
+        {
+            PaAlsaStream_RecordWakeup( stream );
+        }
+
         /* Consume buffer space. Once we have a number of frames available for consumption we must retrieve the
          * mmapped buffers from ALSA, this is contiguously accessible memory however, so we may receive smaller
          * portions at a time than is available as a whole. Therefore we should be prepared to process several
@@ -4324,8 +4489,11 @@ static void *CallbackThreadFunc( void *userData )
 
             if( framesGot > 0 )
             {
+                PaTime callbackStart = PaUtil_GetTime();
+
                 assert( !xrun );
                 PaUtil_EndBufferProcessing( &stream->bufferProcessor, &callbackResult );
+                PaAlsaStream_RecordCallbackDuration( stream, PaUtil_GetTime() - callbackStart );
                 PA_ENSURE( PaAlsaStream_EndProcessing( stream, framesGot, &xrun ) );
             }
             PaUtil_EndCpuLoadMeasurement( &stream->cpuLoadMeasurer, framesGot );
@@ -4468,7 +4636,7 @@ static PaError WriteStream( PaStream* s, const void *buffer, unsigned long frame
         /* Frames residing in buffer */
         PA_ENSURE( err = GetStreamWriteAvailable( stream ) );
         framesAvail = err;
-        hwAvail = stream->playback.alsaBufferSize - framesAvail;
+        hwAvail = stream->playback.alsaBufferSize - stream->playback.reservedFrames - framesAvail;
 
         if( alsa_snd_pcm_state( stream->playback.pcm ) == SND_PCM_STATE_PREPARED &&
                 hwAvail >= stream->playback.framesPerPeriod )
@@ -4615,6 +4783,64 @@ error:
     return result;
 }
 
+PaError PaAlsa_GetStreamStats( PaStream *s, PaAlsaStreamStats *stats )
+{
+    PaAlsaStream *stream;
+    PaError result = paNoError;
+
+    PA_ENSURE( GetAlsaStreamPointer( s, &stream ) );
+
+    *stats = stream->stats;
+    stats->meanWakeupJitter = stream->jitterCount > 0 ? stream->jitterSum / stream->jitterCount : 0.;
+
+error:
+    return result;
+}
+
+PaError PaAlsa_ResetStreamStats( PaStream *s )
+{
+    PaAlsaStream *stream;
+    PaError result = paNoError;
+
+    PA_ENSURE( GetAlsaStreamPointer( s, &stream ) );
+
+    /* Only the audio thread touches the statistics of a running stream */
+    if( stream->isActive )
+        stream->resetStats = 1;
+    else
+        PaAlsaStream_ResetStats( stream );
+
+error:
+    return result;
+}
+
+PaError PaAlsa_EnableAdaptivePeriods( PaStream *s, int enable, int xrunsToGrow, double stableSeconds )
+{
+    PaAlsaStream *stream;
+    PaError result = paNoError;
+
+    PA_ENSURE( GetAlsaStreamPointer( s, &stream ) );
+
+    PA_UNLESS( stream->playback.pcm, paCanNotWriteToAnInputOnlyStream );
+    /* The audio thread owns the software parameters while running */
+    PA_UNLESS( !stream->isActive, paStreamIsNotStopped );
+
+    stream->xrunsToGrow = xrunsToGrow > 0 ? xrunsToGrow : 2;
+    stream->stableTimeToShrink = stableSeconds > 0. ? stableSeconds : 10.;
+    stream->xrunsSinceResize = 0;
+    stream->stableSince = 0.;
+    stream->adaptivePeriods = enable;
+
+    if( !enable && stream->stats.numPeriods != stream->stats.maxPeriods )
+    {
+        PA_ENSURE( PaAlsaStreamComponent_SetFilledPeriods( &stream->playback, stream->stats.maxPeriods ) );
+        stream->stats.numPeriods = stream->stats.maxPeriods;
+    }
+
+error:
+    return result;
+}
+
 PaError PaAlsa_SetRetriesBusy( int retries )
 {
     busyRetries_ = retries;
@@ -1795,6 +1795,7 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
         stream->callbackMode = 0;
     }
     PaUtil_InitializeCpuLoadMeasurer( &stream->cpuLoadMeasurer, sampleRate );
+    stream->baseStreamRep.cpuLoadMeasurer = &stream->cpuLoadMeasurer;
 
     /* Following pa_linux_alsa's lead, we operate with fixed host buffer size by default, */
     /* since other modes will invariably lead to block adaption (maybe Bounded better?) */
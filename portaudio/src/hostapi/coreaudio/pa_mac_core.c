@@ -1800,6 +1800,7 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
     }
 
     PaUtil_InitializeCpuLoadMeasurer( &stream->cpuLoadMeasurer, sampleRate );
+    stream->streamRepresentation.cpuLoadMeasurer = &stream->cpuLoadMeasurer;
 
     
     if( inputParameters )
@@ -2661,6 +2662,7 @@ static PaError StartStream( PaStream *s )
 
     /*FIXME: maybe want to do this on close/abort for faster start? */
     PaUtil_ResetBufferProcessor( &stream->bufferProcessor );
+    PaUtil_ResetCpuLoadMeasurer( &stream->cpuLoadMeasurer );
     if(  stream->inputSRConverter )
        ERR_WRAP( AudioConverterReset( stream->inputSRConverter ) );
 
@@ -664,6 +664,7 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
                                              : &macCoreHostApi->blockingStreamInterface ),
                                            streamCallback, userData );
     PaUtil_InitializeCpuLoadMeasurer( &stream->cpuLoadMeasurer, sampleRate );
+    stream->streamRepresentation.cpuLoadMeasurer = &stream->cpuLoadMeasurer;
     
     *s = (PaStream*)stream;
     PaMacClientData *clientData = PaUtil_AllocateMemory(sizeof(PaMacClientData));
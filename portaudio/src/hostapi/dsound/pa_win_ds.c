@@ -2011,6 +2011,7 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
     stream->streamFlags = streamFlags;
 
     PaUtil_InitializeCpuLoadMeasurer( &stream->cpuLoadMeasurer, sampleRate );
+    stream->streamRepresentation.cpuLoadMeasurer = &stream->cpuLoadMeasurer;
 
 
     if( inputParameters )
@@ -2892,6 +2893,7 @@ static PaError StartStream( PaStream *s )
         
     stream->callbackResult = paContinue;
     PaUtil_ResetBufferProcessor( &stream->bufferProcessor );
+    PaUtil_ResetCpuLoadMeasurer( &stream->cpuLoadMeasurer );
     
     ResetEvent( stream->processingCompleted );
 
@@ -1201,6 +1201,7 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
     }
     srInitialized = 1;
     PaUtil_InitializeCpuLoadMeasurer( &stream->cpuLoadMeasurer, jackSr );
+    stream->streamRepresentation.cpuLoadMeasurer = &stream->cpuLoadMeasurer;
 
     /* create the JACK ports.  We cannot connect them until audio
      * processing begins */
@@ -1598,6 +1599,7 @@ static PaError StartStream( PaStream *s )
 
     /* Ready the processor */
     PaUtil_ResetBufferProcessor( &stream->bufferProcessor );
+    PaUtil_ResetCpuLoadMeasurer( &stream->cpuLoadMeasurer );
 
     /* Connect the ports. Note that the ports may already have been connected by someone else in
      * the meantime, in which case JACK returns EEXIST. */
@@ -496,6 +496,7 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
     }
 
     PaUtil_InitializeCpuLoadMeasurer( &stream->cpuLoadMeasurer, sampleRate );
+    stream->streamRepresentation.cpuLoadMeasurer = &stream->cpuLoadMeasurer;
 
 
     /* we assume a fixed host buffer size in this example, but the buffer processor
@@ -660,6 +661,7 @@ static PaError StartStream( PaStream *s )
     PaSkeletonStream *stream = (PaSkeletonStream*)s;
 
     PaUtil_ResetBufferProcessor( &stream->bufferProcessor );
+    PaUtil_ResetCpuLoadMeasurer( &stream->cpuLoadMeasurer );
 
     /* IMPLEMENT ME, see portaudio.h for required behavior */
 
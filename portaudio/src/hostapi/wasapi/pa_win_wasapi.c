@@ -2935,6 +2935,7 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
 
 	// Initialize CPU measurer
     PaUtil_InitializeCpuLoadMeasurer(&stream->cpuLoadMeasurer, sampleRate);
+    stream->streamRepresentation.cpuLoadMeasurer = &stream->cpuLoadMeasurer;
 
 	if (outputParameters && inputParameters)
 	{
@@ -3226,6 +3227,7 @@ static PaError StartStream( PaStream *s )
 		return paStreamIsNotStopped;
 
     PaUtil_ResetBufferProcessor(&stream->bufferProcessor);
+    PaUtil_ResetCpuLoadMeasurer(&stream->cpuLoadMeasurer);
 
 	// Cleanup handles (may be necessary if stream was stopped by itself due to error)
 	_StreamCleanup(stream);
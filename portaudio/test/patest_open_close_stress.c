@@ -0,0 +1,179 @@
+/** @file patest_open_close_stress.c
+	@ingroup test_src
+	@brief Measure the cost of opening and closing streams, and of allocation group churn.
+
+	Build against the library sources with PA_TRACK_MEMORY=1 to also get
+	allocation counts, eg. compile it together with the .c files in src/common,
+	the host API and os sources, passing -DPA_TRACK_MEMORY=1 and
+	-I include -I src/common -I src/os/unix.
+*/
+/*
+ * This program uses the PortAudio Portable Audio Library.
+ * For more information see: http://www.portaudio.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however,
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also
+ * requested that these non-binding requests be included along with the
+ * license above.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "portaudio.h"
+#include "pa_util.h"
+#include "pa_allocation.h"
+
+#define SAMPLE_RATE        (44100)
+#define FRAMES_PER_BUFFER  (256)
+#define NUM_STREAM_CYCLES  (100)
+#define NUM_GROUP_CYCLES   (10000)
+#define BLOCKS_PER_GROUP   (64)
+
+static int silenceCallback( const void *inputBuffer, void *outputBuffer,
+                            unsigned long framesPerBuffer,
+                            const PaStreamCallbackTimeInfo* timeInfo,
+                            PaStreamCallbackFlags statusFlags,
+                            void *userData )
+{
+    float *out = (float*)outputBuffer;
+    unsigned long i;
+    (void) inputBuffer; (void) timeInfo; (void) statusFlags; (void) userData;
+
+    for( i=0; i<framesPerBuffer*2; i++ )
+        *out++ = 0.f;
+    return paContinue;
+}
+
+/* Fill a group with blocks of the sizes a host API typically allocates
+   (device infos, names, channel arrays) and free them all, repeatedly. */
+static PaError TestGroupChurn( void )
+{
+    PaUtilAllocationGroup *group;
+    PaTime start, elapsed;
+    int blocksBefore, blocksFilled = 0;
+    int cycle, i;
+
+    blocksBefore = PaUtil_CountCurrentlyAllocatedBlocks();
+    group = PaUtil_CreateAllocationGroup();
+    if( group == NULL )
+        return paInsufficientMemory;
+
+    start = PaUtil_GetTime();
+    for( cycle=0; cycle<NUM_GROUP_CYCLES; cycle++ )
+    {
+        for( i=0; i<BLOCKS_PER_GROUP; i++ )
+        {
+            if( PaUtil_GroupAllocateMemory( group, 16 + (i * 37) % 200 ) == NULL )
+            {
+                PaUtil_FreeAllAllocations( group );
+                PaUtil_DestroyAllocationGroup( group );
+                return paInsufficientMemory;
+            }
+        }
+        if( cycle == 0 )
+            blocksFilled = PaUtil_CountCurrentlyAllocatedBlocks() - blocksBefore;
+        PaUtil_FreeAllAllocations( group );
+    }
+    elapsed = PaUtil_GetTime() - start;
+
+    PaUtil_DestroyAllocationGroup( group );
+
+    printf( "Allocation group: %d blocks per cycle, %.3f usec per cycle\n",
+            BLOCKS_PER_GROUP, elapsed * 1000000. / NUM_GROUP_CYCLES );
+    printf( "  system allocations to fill a group: %d\n", blocksFilled );
+    printf( "  blocks leaked: %d\n", PaUtil_CountCurrentlyAllocatedBlocks() - blocksBefore );
+    return paNoError;
+}
+
+static PaError TestStreamChurn( void )
+{
+    PaStream *stream;
+    PaError err;
+    PaTime start, duration, total = 0., worst = 0.;
+    int blocksBefore, cycle;
+
+    if( Pa_GetDefaultOutputDevice() == paNoDevice )
+    {
+        printf( "No default output device, skipping stream open/close.\n" );
+        return paNoError;
+    }
+
+    blocksBefore = PaUtil_CountCurrentlyAllocatedBlocks();
+    for( cycle=0; cycle<NUM_STREAM_CYCLES; cycle++ )
+    {
+        start = PaUtil_GetTime();
+        err = Pa_OpenDefaultStream( &stream, 0, 2, paFloat32, SAMPLE_RATE, FRAMES_PER_BUFFER,
+                                    silenceCallback, NULL );
+        if( err != paNoError )
+            return err;
+        err = Pa_CloseStream( stream );
+        if( err != paNoError )
+            return err;
+        duration = PaUtil_GetTime() - start;
+
+        total += duration;
+        if( duration > worst )
+            worst = duration;
+    }
+
+    printf( "Stream open/close: mean %.3f msec, worst %.3f msec over %d cycles\n",
+            total * 1000. / NUM_STREAM_CYCLES, worst * 1000., NUM_STREAM_CYCLES );
+    printf( "  blocks leaked: %d\n", PaUtil_CountCurrentlyAllocatedBlocks() - blocksBefore );
+    return paNoError;
+}
+
+int main(void);
+int main(void)
+{
+    PaError err;
+
+    printf( "PortAudio Test: open/close stress.\n" );
+#if !PA_TRACK_MEMORY
+    printf( "(Built without PA_TRACK_MEMORY, allocation counts will read 0.)\n" );
+#endif
+
+    err = Pa_Initialize();
+    if( err != paNoError ) goto error;
+
+    err = TestGroupChurn();
+    if( err != paNoError ) goto error;
+
+    err = TestStreamChurn();
+    if( err != paNoError ) goto error;
+
+    Pa_Terminate();
+    printf( "Test finished.\n" );
+    return err;
+
+error:
+    Pa_Terminate();
+    fprintf( stderr, "An error occured while using the portaudio stream\n" );
+    fprintf( stderr, "Error number: %d\n", err );
+    fprintf( stderr, "Error message: %s\n", Pa_GetErrorText( err ) );
+    return err;
+}
@@ -0,0 +1,207 @@
+// Shares map_file with pack.cc, and fnv1a64 and stat_source with texture_cache.cc.
+
+static bool program_binary_supported()
+{
+    if (!glGetProgramBinary || !glProgramBinary || !glProgramParameteri) {
+        return false;
+    }
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    return num_formats > 0;
+}
+
+// The file if it can be read, else the built in source. Either way it has to be freed.
+static char* read_shader_source(const char* fname, const char* builtin, uint64_t* size, int64_t* mtime)
+{
+    *size = 0;
+    *mtime = -1;
+    FILE* fd = NULL;
+    if (fname && stat_source(fname, size, mtime)) {
+        fd = fopen(fname, "rb");
+    }
+    if (!fd) {
+        size_t len = strlen(builtin);
+        char* src = (char*)malloc(len + 1);
+        if (src) {
+            memcpy(src, builtin, len + 1);
+        }
+        return src;
+    }
+    char* src = (char*)malloc((size_t)*size + 1);
+    if (src && fread(src, 1, (size_t)*size, fd) == *size) {
+        src[*size] = '\0';
+    } else {
+        free(src);
+        src = NULL;
+    }
+    fclose(fd);
+    return src;
+}
+
+static uint64_t shader_source_hash(const char* vs, const char* fs)
+{
+    const char* gl_renderer = (const char*)glGetString(GL_RENDERER);
+    const char* gl_version = (const char*)glGetString(GL_VERSION);
+    const char* parts[] = { vs, fs, gl_renderer ? gl_renderer : "", gl_version ? gl_version : "" };
+    uint64_t hashes[4];
+    for (int i = 0; i < 4; ++i) {
+        hashes[i] = fnv1a64((const uint8_t*)parts[i], strlen(parts[i]));
+    }
+    return fnv1a64((const uint8_t*)hashes, sizeof(hashes));
+}
+
+static GLuint build_program(const char* vs, const char* fs, bool retrievable)
+{
+    GLuint shaders[2] = {};
+    bool ok = gl_try_compile_shader(vs, GL_VERTEX_SHADER_ARB, &shaders[0]) &&
+              gl_try_compile_shader(fs, GL_FRAGMENT_SHADER_ARB, &shaders[1]);
+    GLuint program = 0;
+    if (ok) {
+        program = glCreateProgramObjectARB();
+        if (retrievable) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        ok = gl_try_link_program(program, shaders, 2);
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (shaders[i]) {
+            glDeleteObjectARB(shaders[i]);  // Freed with the program, or now if it didn't link.
+        }
+    }
+    if (!ok && program) {
+        glDeleteObjectARB(program);
+        program = 0;
+    }
+    return program;
+}
+
+static GLuint load_cached_program(const char* cache_name, uint64_t hash)
+{
+    MappedFile view;
+    if (!map_file(&view, cache_name)) {
+        return 0;
+    }
+    GLuint program = 0;
+    const ShaderCacheHeader* header = (const ShaderCacheHeader*)view.base;
+    if (view.size >= sizeof(*header) && header->magic == k_shadercache_magic &&
+        header->version == k_shadercache_version && header->source_hash == hash &&
+        header->binary_size == view.size - sizeof(*header)) {
+        program = glCreateProgramObjectARB();
+        glProgramBinary(program, header->binary_format, view.base + sizeof(*header), header->binary_size);
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            // Drivers can refuse their own binaries after an update.
+            glDeleteObjectARB(program);
+            program = 0;
+        }
+    }
+    unmap_file(&view);
+    return program;
+}
+
+static bool write_cached_program(const char* cache_name, uint64_t hash, GLuint program)
+{
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    uint8_t* binary = size > 0 ? (uint8_t*)malloc((size_t)size) : NULL;
+    if (!binary) {
+        return false;
+    }
+    ShaderCacheHeader header = {};
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, size, &written, &format, binary);
+    header.magic = k_shadercache_magic;
+    header.version = k_shadercache_version;
+    header.source_hash = hash;
+    header.binary_format = format;
+    header.binary_size = (uint32_t)written;
+
+    FILE* fd = written > 0 ? fopen(cache_name, "wb") : NULL;
+    bool ok = fd && fwrite(&header, sizeof(header), 1, fd) == 1 &&
+              fwrite(binary, 1, (size_t)written, fd) == (size_t)written;
+    if (fd) {
+        ok = fclose(fd) == 0 && ok;
+        if (!ok) {
+            remove(cache_name);
+        }
+    }
+    free(binary);
+    return ok;
+}
+
+// Builds into sp->program from the current sources, or leaves it alone on failure.
+static ShaderCacheResult shader_build(ShaderProgram* sp)
+{
+    uint64_t vs_size, fs_size;
+    int64_t vs_mtime, fs_mtime;
+    char* vs = read_shader_source(sp->vs_fname, sp->vs_builtin, &vs_size, &vs_mtime);
+    char* fs = read_shader_source(sp->fs_fname, sp->fs_builtin, &fs_size, &fs_mtime);
+    // Keep the stamps even on failure, so a broken file is reported once per save.
+    sp->vs_size = vs_size;
+    sp->vs_mtime = vs_mtime;
+    sp->fs_size = fs_size;
+    sp->fs_mtime = fs_mtime;
+    if (!vs || !fs) {
+        free(vs);
+        free(fs);
+        return ShaderCacheResult::FAILED;
+    }
+
+    ShaderCacheResult result = ShaderCacheResult::FAILED;
+    bool cacheable = sp->cache_name && program_binary_supported();
+    uint64_t hash = cacheable ? shader_source_hash(vs, fs) : 0;
+    GLuint program = cacheable ? load_cached_program(sp->cache_name, hash) : 0;
+    if (program) {
+        result = ShaderCacheResult::HIT;
+    } else {
+        program = build_program(vs, fs, cacheable);
+        if (program) {
+            result = ShaderCacheResult::MISS;
+            if (cacheable && !write_cached_program(sp->cache_name, hash, program)) {
+                printf("[DEBUG] Could not write %s\n", sp->cache_name);
+            }
+        }
+    }
+    free(vs);
+    free(fs);
+    if (program) {
+        if (sp->program) {
+            glDeleteObjectARB(sp->program);
+        }
+        sp->program = program;
+    }
+    return result;
+}
+
+ShaderCacheResult shader_load(ShaderProgram* sp, const char* vs_src, const char* fs_src,
+                              const char* vs_fname, const char* fs_fname, const char* cache_name)
+{
+    memset(sp, 0, sizeof(*sp));
+    sp->vs_builtin = vs_src;
+    sp->fs_builtin = fs_src;
+    sp->vs_fname = vs_fname;
+    sp->fs_fname = fs_fname;
+    sp->cache_name = cache_name;
+    return shader_build(sp);
+}
+
+static bool source_changed(const char* fname, uint64_t size, int64_t mtime)
+{
+    uint64_t new_size = 0;
+    int64_t new_mtime = -1;
+    if (fname) {
+        stat_source(fname, &new_size, &new_mtime);
+    }
+    return new_size != size || new_mtime != mtime;
+}
+
+bool shader_hot_reload(ShaderProgram* sp)
+{
+    if (!source_changed(sp->vs_fname, sp->vs_size, sp->vs_mtime) &&
+        !source_changed(sp->fs_fname, sp->fs_size, sp->fs_mtime)) {
+        return false;
+    }
+    return shader_build(sp) != ShaderCacheResult::FAILED;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// Linked shader programs, cached with glGetProgramBinary as <cache_name> so
+// later launches skip compiling and linking.
+//
+// A cache file is a ShaderCacheHeader and the program binary. It is used when
+// its hash matches the sources and the GL renderer and version, and the driver
+// takes the binary back. Otherwise the program is built from source and the
+// cache written again. Without GL_ARB_get_program_binary it always builds.
+//
+// Sources are read from vs_fname and fs_fname when those files exist, the
+// built in strings are used otherwise. Save a shader to one of those files to
+// edit it while the game runs, shader_hot_reload picks up the changes.
+
+static const uint32_t k_shadercache_magic   = 0x53574843;  // "CHWS"
+static const uint32_t k_shadercache_version = 1;
+
+struct ShaderCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;  // FNV-1a 64 of both sources, GL_RENDERER and GL_VERSION.
+    uint32_t binary_format;
+    uint32_t binary_size;
+};
+
+enum class ShaderCacheResult {
+    HIT,     // Loaded from the program binary.
+    MISS,    // Built from source, and cached when the driver allows.
+    FAILED,  // The sources did not compile or link. Errors are logged.
+};
+
+struct ShaderProgram {
+    GLuint      program;
+    const char* vs_builtin;
+    const char* fs_builtin;
+    const char* vs_fname;
+    const char* fs_fname;
+    const char* cache_name;
+    uint64_t    vs_size, fs_size;  // Of the files read, to notice changes.
+    int64_t     vs_mtime, fs_mtime;
+};
+
+// The strings are kept, not copied. program is 0 on FAILED.
+ShaderCacheResult shader_load(ShaderProgram* sp, const char* vs_src, const char* fs_src,
+                              const char* vs_fname, const char* fs_fname, const char* cache_name);
+// True when a source file changed and the program was rebuilt, which deletes
+// the old one. On a compile error the old program is kept.
+bool shader_hot_reload(ShaderProgram* sp);
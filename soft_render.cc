@@ -0,0 +1,361 @@
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if !defined(SOFT_RENDER_NO_SIMD) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SOFT_RENDER_SSE2
+#include <emmintrin.h>
+#endif
+
+static const int k_soft_tile_size   = 64;  // A multiple of 4, see soft_raster_quad.
+static const int k_soft_max_quads   = 1024;
+static const int k_soft_max_threads = 16;
+
+struct SoftQuad {
+    const uint8_t* texels;
+    int   tw, th;
+    float edges[4][3];  // e[0]*x + e[1]*y + e[2] >= 0 inside, x and y the pixel's index.
+    float tu[3], tv[3]; // Same form, in texels, with the half texel offset of bilinear filtering.
+    int   x0, y0, x1, y1;  // Pixels that can be covered, max exclusive.
+};
+
+static int       g_soft_w, g_soft_h;
+static uint32_t* g_soft_pixels;
+static uint32_t  g_soft_clear;
+static SoftQuad  g_soft_quads[k_soft_max_quads];
+static int       g_soft_num_quads;
+static int       g_soft_tiles_x, g_soft_tiles_y;
+
+static std::atomic<int>        g_soft_next_tile;
+static std::thread             g_soft_workers[k_soft_max_threads];
+static int                     g_soft_num_workers;
+static std::mutex              g_soft_mutex;
+static std::condition_variable g_soft_start;
+static std::condition_variable g_soft_done;
+static uint32_t                g_soft_frame;  // Bumped to send the workers on a frame.
+static int                     g_soft_busy;   // Workers that haven't finished it.
+static bool                    g_soft_quit;
+
+#if defined(SOFT_RENDER_SSE2)
+static __m128 soft_channel(__m128i texels, int shift)
+{
+    return _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, shift), _mm_set1_epi32(0xff)));
+}
+
+static __m128 soft_lerp(__m128 a, __m128 b, __m128 t)
+{
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+// Blends the bilinear samples at (u, v), in texels, into the 4 pixels at dst
+// whose lanes are set in the inside mask. Same arithmetic as the scalar soft_shade,
+// done a channel of four pixels at a time.
+static void soft_shade4(const SoftQuad* q, __m128 u, __m128 v, __m128i inside, uint32_t* dst)
+{
+    __m128 one = _mm_set1_ps(1);
+    __m128 zero = _mm_setzero_ps();
+    __m128 max_x = _mm_set1_ps((float)(q->tw - 1));
+    __m128 max_y = _mm_set1_ps((float)(q->th - 1));
+    // Anything past an edge samples like the edge, keep the ints small.
+    u = _mm_min_ps(_mm_max_ps(u, _mm_set1_ps(-1)), _mm_set1_ps((float)q->tw));
+    v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1)), _mm_set1_ps((float)q->th));
+    __m128 x0 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(u, one))), one);
+    __m128 y0 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(v, one))), one);
+    __m128 fx = _mm_sub_ps(u, x0);
+    __m128 fy = _mm_sub_ps(v, y0);
+    __m128 xa = _mm_min_ps(_mm_max_ps(x0, zero), max_x);
+    __m128 xb = _mm_min_ps(_mm_max_ps(_mm_add_ps(x0, one), zero), max_x);
+    __m128 row_a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(y0, zero), max_y), _mm_set1_ps((float)q->tw));
+    __m128 row_b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_add_ps(y0, one), zero), max_y), _mm_set1_ps((float)q->tw));
+    int offsets[4][4];
+    _mm_storeu_si128((__m128i*)offsets[0], _mm_cvttps_epi32(_mm_add_ps(row_a, xa)));
+    _mm_storeu_si128((__m128i*)offsets[1], _mm_cvttps_epi32(_mm_add_ps(row_a, xb)));
+    _mm_storeu_si128((__m128i*)offsets[2], _mm_cvttps_epi32(_mm_add_ps(row_b, xa)));
+    _mm_storeu_si128((__m128i*)offsets[3], _mm_cvttps_epi32(_mm_add_ps(row_b, xb)));
+    // Pixels outside the quad get transparent texels, which leave dst alone.
+    const uint32_t* texels = (const uint32_t*)q->texels;
+    __m128i t[4];
+    for (int c = 0; c < 4; ++c) {
+        const int* o = offsets[c];
+        t[c] = _mm_and_si128(_mm_set_epi32((int)texels[o[3]], (int)texels[o[2]], (int)texels[o[1]], (int)texels[o[0]]),
+                             inside);
+    }
+    __m128i any = _mm_or_si128(_mm_or_si128(t[0], t[1]), _mm_or_si128(t[2], t[3]));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(any, 24), _mm_setzero_si128())) == 0xffff) {
+        return;  // Transparent, most of a sprite's bounds.
+    }
+
+    __m128i d = _mm_loadu_si128((const __m128i*)dst);
+    __m128 c[4];
+    for (int ch = 0; ch < 4; ++ch) {
+        __m128 top = soft_lerp(soft_channel(t[0], ch * 8), soft_channel(t[1], ch * 8), fx);
+        __m128 bottom = soft_lerp(soft_channel(t[2], ch * 8), soft_channel(t[3], ch * 8), fx);
+        c[ch] = soft_lerp(top, bottom, fy);
+    }
+    // Under half a step of alpha would round back to what is there.
+    __m128 keep = _mm_cmplt_ps(c[3], _mm_set1_ps(0.5f));
+    if (_mm_movemask_ps(keep) == 0xf) {
+        return;
+    }
+    __m128 a = _mm_mul_ps(c[3], _mm_set1_ps(1.0f / 255));
+    __m128i out = _mm_setzero_si128();
+    for (int ch = 0; ch < 4; ++ch) {
+        __m128 blended = soft_lerp(soft_channel(d, ch * 8), c[ch], a);
+        out = _mm_or_si128(out, _mm_slli_epi32(_mm_cvtps_epi32(blended), ch * 8));
+    }
+    __m128i keep_i = _mm_castps_si128(keep);
+    out = _mm_or_si128(_mm_and_si128(keep_i, d), _mm_andnot_si128(keep_i, out));
+    _mm_storeu_si128((__m128i*)dst, out);
+}
+#else
+// Blends the bilinear sample at (u, v), in texels, into dst.
+static void soft_shade(const SoftQuad* q, float u, float v, uint32_t* dst)
+{
+    u = u < -1 ? -1 : u > q->tw ? (float)q->tw : u;
+    v = v < -1 ? -1 : v > q->th ? (float)q->th : v;
+    float x0 = (float)((int)(u + 1) - 1);
+    float y0 = (float)((int)(v + 1) - 1);
+    float fx = u - x0;
+    float fy = v - y0;
+    int xa = (int)(x0 < 0 ? 0 : x0 > q->tw - 1 ? q->tw - 1 : x0);
+    int xb = (int)(x0 + 1 < 0 ? 0 : x0 + 1 > q->tw - 1 ? q->tw - 1 : x0 + 1);
+    int ya = (int)(y0 < 0 ? 0 : y0 > q->th - 1 ? q->th - 1 : y0);
+    int yb = (int)(y0 + 1 < 0 ? 0 : y0 + 1 > q->th - 1 ? q->th - 1 : y0 + 1);
+    const uint8_t* t00 = q->texels + (ya * q->tw + xa) * 4;
+    const uint8_t* t10 = q->texels + (ya * q->tw + xb) * 4;
+    const uint8_t* t01 = q->texels + (yb * q->tw + xa) * 4;
+    const uint8_t* t11 = q->texels + (yb * q->tw + xb) * 4;
+    float c[4];
+    for (int i = 0; i < 4; ++i) {
+        float top = t00[i] + (t10[i] - t00[i]) * fx;
+        float bottom = t01[i] + (t11[i] - t01[i]) * fx;
+        c[i] = top + (bottom - top) * fy;
+    }
+    if (c[3] < 0.5f) {
+        return;  // Would round back to what is there.
+    }
+    float a = c[3] * (1.0f / 255);
+    uint8_t* d = (uint8_t*)dst;
+    for (int i = 0; i < 4; ++i) {
+        d[i] = (uint8_t)lrintf(d[i] + (c[i] - d[i]) * a);
+    }
+}
+#endif
+
+static void soft_raster_quad(const SoftQuad* q, int x0, int y0, int x1, int y1)
+{
+    const float (*e)[3] = q->edges;
+    for (int y = y0; y < y1; ++y) {
+        uint32_t* row = g_soft_pixels + (size_t)y * g_soft_w;
+        float fy = (float)y;
+#if defined(SOFT_RENDER_SSE2)
+        // Groups of 4 start at multiples of 4 so they never reach into another
+        // thread's tile, what is outside the span is masked out.
+        __m128 ys = _mm_set1_ps(fy);
+        for (int x = x0 & ~3; x < x1; x += 4) {
+            __m128 xs = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3, 2, 1, 0));
+            __m128 in = _mm_and_ps(_mm_cmpge_ps(xs, _mm_set1_ps((float)x0)), _mm_cmplt_ps(xs, _mm_set1_ps((float)x1)));
+            for (int i = 0; i < 4; ++i) {
+                __m128 ev = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xs, _mm_set1_ps(e[i][0])),
+                                                  _mm_mul_ps(ys, _mm_set1_ps(e[i][1]))),
+                                       _mm_set1_ps(e[i][2]));
+                in = _mm_and_ps(in, _mm_cmpge_ps(ev, _mm_setzero_ps()));
+            }
+            if (!_mm_movemask_ps(in)) {
+                continue;
+            }
+            __m128i inside = _mm_castps_si128(in);
+            __m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xs, _mm_set1_ps(q->tu[0])),
+                                             _mm_mul_ps(ys, _mm_set1_ps(q->tu[1]))),
+                                  _mm_set1_ps(q->tu[2]));
+            __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xs, _mm_set1_ps(q->tv[0])),
+                                             _mm_mul_ps(ys, _mm_set1_ps(q->tv[1]))),
+                                  _mm_set1_ps(q->tv[2]));
+            if (x + 4 <= g_soft_w) {
+                soft_shade4(q, u, v, inside, &row[x]);
+            } else {
+                // The last pixels of the row, go through a copy to not write past it.
+                uint32_t tail[4] = {};
+                memcpy(tail, &row[x], (g_soft_w - x) * sizeof(uint32_t));
+                soft_shade4(q, u, v, inside, tail);
+                memcpy(&row[x], tail, (g_soft_w - x) * sizeof(uint32_t));
+            }
+        }
+#else
+        for (int x = x0; x < x1; ++x) {
+            float fx = (float)x;
+            bool in = true;
+            for (int i = 0; i < 4 && in; ++i) {
+                in = e[i][0] * fx + e[i][1] * fy + e[i][2] >= 0;
+            }
+            if (in) {
+                soft_shade(q, q->tu[0] * fx + q->tu[1] * fy + q->tu[2], q->tv[0] * fx + q->tv[1] * fy + q->tv[2],
+                           &row[x]);
+            }
+        }
+#endif
+    }
+}
+
+static void soft_raster_tiles()
+{
+    int num_tiles = g_soft_tiles_x * g_soft_tiles_y;
+    for (int tile = g_soft_next_tile++; tile < num_tiles; tile = g_soft_next_tile++) {
+        int x0 = (tile % g_soft_tiles_x) * k_soft_tile_size;
+        int y0 = (tile / g_soft_tiles_x) * k_soft_tile_size;
+        int x1 = x0 + k_soft_tile_size < g_soft_w ? x0 + k_soft_tile_size : g_soft_w;
+        int y1 = y0 + k_soft_tile_size < g_soft_h ? y0 + k_soft_tile_size : g_soft_h;
+        for (int y = y0; y < y1; ++y) {
+            uint32_t* row = g_soft_pixels + (size_t)y * g_soft_w;
+            for (int x = x0; x < x1; ++x) {
+                row[x] = g_soft_clear;
+            }
+        }
+        for (int i = 0; i < g_soft_num_quads; ++i) {
+            const SoftQuad* q = &g_soft_quads[i];
+            int qx0 = q->x0 > x0 ? q->x0 : x0;
+            int qy0 = q->y0 > y0 ? q->y0 : y0;
+            int qx1 = q->x1 < x1 ? q->x1 : x1;
+            int qy1 = q->y1 < y1 ? q->y1 : y1;
+            if (qx0 < qx1 && qy0 < qy1) {
+                soft_raster_quad(q, qx0, qy0, qx1, qy1);
+            }
+        }
+    }
+}
+
+static void soft_worker(uint32_t frame)
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(g_soft_mutex);
+            g_soft_start.wait(lock, [&] { return g_soft_quit || g_soft_frame != frame; });
+            if (g_soft_quit) {
+                return;
+            }
+            frame = g_soft_frame;
+        }
+        soft_raster_tiles();
+        {
+            std::lock_guard<std::mutex> lock(g_soft_mutex);
+            if (--g_soft_busy == 0) {
+                g_soft_done.notify_one();
+            }
+        }
+    }
+}
+
+void soft_init(int w, int h, int num_threads)
+{
+    g_soft_w = w;
+    g_soft_h = h;
+    g_soft_pixels = (uint32_t*)calloc((size_t)w * h, sizeof(uint32_t));
+    g_soft_tiles_x = (w + k_soft_tile_size - 1) / k_soft_tile_size;
+    g_soft_tiles_y = (h + k_soft_tile_size - 1) / k_soft_tile_size;
+    g_soft_num_quads = 0;
+    g_soft_quit = false;
+    g_soft_num_workers = num_threads - 1 < 0 ? 0 :
+                         num_threads - 1 > k_soft_max_threads ? k_soft_max_threads : num_threads - 1;
+    for (int i = 0; i < g_soft_num_workers; ++i) {
+        g_soft_workers[i] = std::thread(soft_worker, g_soft_frame);
+    }
+}
+
+void soft_deinit()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_soft_mutex);
+        g_soft_quit = true;
+    }
+    g_soft_start.notify_all();
+    for (int i = 0; i < g_soft_num_workers; ++i) {
+        g_soft_workers[i].join();
+    }
+    g_soft_num_workers = 0;
+    free(g_soft_pixels);
+    g_soft_pixels = NULL;
+}
+
+void soft_begin_frame(uint32_t clear_rgba)
+{
+    g_soft_clear = clear_rgba;
+    g_soft_num_quads = 0;
+}
+
+void soft_draw_quad(const uint8_t* texels, int tw, int th, const v2f pos[4], const v2f uv[4])
+{
+    if (g_soft_num_quads == k_soft_max_quads || !texels || tw <= 0 || th <= 0) {
+        return;
+    }
+    // To pixels, y down. Pixel centers are at + 0.5, folded in below.
+    float px[4], py[4];
+    for (int i = 0; i < 4; ++i) {
+        px[i] = (pos[i].x + 1) * 0.5f * g_soft_w - 0.5f;
+        py[i] = (1 - pos[i].y) * 0.5f * g_soft_h - 0.5f;
+    }
+    float area = (px[1] - px[0]) * (py[2] - py[0]) - (py[1] - py[0]) * (px[2] - px[0]);
+    if (fabsf(area) < 1e-6f) {
+        return;
+    }
+
+    SoftQuad* q = &g_soft_quads[g_soft_num_quads];
+    float sign = area > 0 ? 1.0f : -1.0f;
+    for (int i = 0; i < 4; ++i) {
+        int j = (i + 1) % 4;
+        float ex = px[j] - px[i];
+        float ey = py[j] - py[i];
+        // Positive on the side the quad turns to.
+        q->edges[i][0] = -ey * sign;
+        q->edges[i][1] = ex * sign;
+        q->edges[i][2] = (ey * px[i] - ex * py[i]) * sign;
+    }
+    // Solves tex = t[0] * x + t[1] * y + t[2] through a, b and c.
+    float du1 = (uv[1].x - uv[0].x) * tw, du2 = (uv[2].x - uv[0].x) * tw;
+    float dv1 = (uv[1].y - uv[0].y) * th, dv2 = (uv[2].y - uv[0].y) * th;
+    float x1 = px[1] - px[0], y1 = py[1] - py[0];
+    float x2 = px[2] - px[0], y2 = py[2] - py[0];
+    q->tu[0] = (du1 * y2 - du2 * y1) / area;
+    q->tu[1] = (du2 * x1 - du1 * x2) / area;
+    q->tu[2] = uv[0].x * tw - 0.5f - q->tu[0] * px[0] - q->tu[1] * py[0];
+    q->tv[0] = (dv1 * y2 - dv2 * y1) / area;
+    q->tv[1] = (dv2 * x1 - dv1 * x2) / area;
+    q->tv[2] = uv[0].y * th - 0.5f - q->tv[0] * px[0] - q->tv[1] * py[0];
+
+    float min_x = px[0], max_x = px[0], min_y = py[0], max_y = py[0];
+    for (int i = 1; i < 4; ++i) {
+        min_x = px[i] < min_x ? px[i] : min_x;
+        max_x = px[i] > max_x ? px[i] : max_x;
+        min_y = py[i] < min_y ? py[i] : min_y;
+        max_y = py[i] > max_y ? py[i] : max_y;
+    }
+    q->x0 = min_x < 0 ? 0 : (int)ceilf(min_x);
+    q->y0 = min_y < 0 ? 0 : (int)ceilf(min_y);
+    q->x1 = max_x >= g_soft_w ? g_soft_w : (int)floorf(max_x) + 1;
+    q->y1 = max_y >= g_soft_h ? g_soft_h : (int)floorf(max_y) + 1;
+    if (q->x0 >= q->x1 || q->y0 >= q->y1) {
+        return;
+    }
+    q->texels = texels;
+    q->tw = tw;
+    q->th = th;
+    ++g_soft_num_quads;
+}
+
+const uint8_t* soft_end_frame()
+{
+    g_soft_next_tile = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_soft_mutex);
+        ++g_soft_frame;
+        g_soft_busy = g_soft_num_workers;
+    }
+    g_soft_start.notify_all();
+    soft_raster_tiles();
+    {
+        std::unique_lock<std::mutex> lock(g_soft_mutex);
+        g_soft_done.wait(lock, [] { return g_soft_busy == 0; });
+    }
+    return (const uint8_t*)g_soft_pixels;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// A CPU stand-in for the GL sprite path, to render frames where there is no GPU.
+//
+// Quads are queued in clip space, the way draw_sprite sends them to GL, and
+// drawn at soft_end_frame. The frame is cut in tiles that worker threads take
+// until none are left, and each tile draws the quads that touch it in the
+// order they came. Textures are sampled bilinearly with clamp to edge and
+// blended with SRC_ALPHA, ONE_MINUS_SRC_ALPHA, as the game sets up GL.
+//
+// Texture coordinates are interpolated from a, b and c, so quads are expected
+// to be parallelograms, which every sprite is.
+
+// num_threads counts the calling thread.
+void soft_init(int w, int h, int num_threads);
+void soft_deinit();
+// clear_rgba is R in the lowest byte, as the pixels are stored.
+void soft_begin_frame(uint32_t clear_rgba);
+// texels are RGBA8, top row first, as stbi_load returns them, and must stay
+// valid until soft_end_frame. Points go a, b, c, d as in draw_sprite.
+void soft_draw_quad(const uint8_t* texels, int tw, int th, const v2f pos[4], const v2f uv[4]);
+// RGBA8 pixels of the frame, top row first. Valid until the next soft_end_frame.
+const uint8_t* soft_end_frame();
@@ -318,9 +318,9 @@ distribute, and modify this file as you see fit.
 //
 // SIMD support
 //
-// The JPEG decoder will try to automatically use SIMD kernels on x86 when
-// supported by the compiler. For ARM Neon support, you must explicitly
-// request it.
+// The JPEG decoder and the PNG unfilter (8-bit, 3 and 4 channel images) will
+// try to automatically use SIMD kernels on x86 when supported by the compiler.
+// For ARM Neon support, you must explicitly request it; it covers JPEG only.
 //
 // (The old do-it-yourself SIMD API is no longer supported in the current
 // code.)
@@ -344,6 +344,32 @@ distribute, and modify this file as you see fit.
 //
 // ===========================================================================
 //
+// Multithreaded decoding
+//
+// stbi_load_from_memory_parallel() decodes a single image on several
+// threads. stb_image creates no threads itself, you pass in a task runner:
+//
+//    run(user, task, task_data, count) must call task(task_data, i) once for
+//    every i in [0,count) and return when all of them have returned. They may
+//    run in any order, on any threads, at once or one after another.
+//
+// num_threads is how many tasks to split work into. With a NULL stbi_parallel
+// or num_threads <= 1 it's the same as stbi_load_from_memory(). What gets
+// spread over threads:
+//
+//    - baseline JPEGs with restart intervals: the intervals are located up
+//      front and their huffman decode and IDCT run as separate tasks. JPEGs
+//      without restart markers, and progressive ones, decode as usual.
+//    - non-interlaced PNGs: one task inflates while another unfilters the
+//      rows inflated so far. Conversion to req_comp happens afterwards.
+//
+// The result is the same as the single threaded decode. Tasks can set the
+// failure reason, which is a global, so only call stbi_failure_reason() once
+// the load has returned. This needs MSVC or a GCC compatible compiler for
+// atomics; with others it decodes on one thread.
+//
+// ===========================================================================
+//
 // HDR image support   (disable by defining STBI_NO_HDR)
 //
 // stb_image now supports loading HDR images in general, and currently
@@ -448,6 +474,16 @@ STBIDEF stbi_uc *stbi_load_from_file  (FILE *f,                  int *x, int *y,
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 #endif
 
+// see "Multithreaded decoding" above
+typedef struct
+{
+   void (*run)(void *user, void (*task)(void *task_data, int i), void *task_data, int count);
+   void  *user;
+   int    num_threads;
+} stbi_parallel;
+
+STBIDEF stbi_uc *stbi_load_from_memory_parallel(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, stbi_parallel const *parallel);
+
 #ifndef STBI_NO_LINEAR
    STBIDEF float *stbi_loadf                 (char const *filename,           int *x, int *y, int *comp, int req_comp);
    STBIDEF float *stbi_loadf_from_memory     (stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
@@ -603,12 +639,14 @@ typedef unsigned short stbi__uint16;
 typedef   signed short stbi__int16;
 typedef unsigned int   stbi__uint32;
 typedef   signed int   stbi__int32;
+typedef unsigned __int64 stbi__uint64;
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t  stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -675,7 +713,7 @@ typedef unsigned char validate_uint32[sizeof(stbi__uint32)==4 ? 1 : -1];
 #define STBI_NO_SIMD
 #endif
 
-#if !defined(STBI_NO_SIMD) && defined(STBI__X86_TARGET)
+#if !defined(STBI_NO_SIMD) && (defined(STBI__X86_TARGET) || defined(STBI__X64_TARGET))
 #define STBI_SSE2
 #include <emmintrin.h>
 
@@ -741,6 +779,29 @@ static int stbi__sse2_available()
 #define STBI_SIMD_ALIGN(type, name) type name
 #endif
 
+// just enough atomics for stbi_load_from_memory_parallel
+#if defined(_MSC_VER)
+#define STBI__PARALLEL
+#include <intrin.h>
+#ifdef __cplusplus
+extern "C"
+#endif
+__declspec(dllimport) int __stdcall SwitchToThread(void);
+typedef volatile long stbi__atomic;
+#define stbi__atomic_inc(p)     (_InterlockedIncrement(p) - 1)
+#define stbi__atomic_store(p,v) _InterlockedExchange(p, v)
+#define stbi__atomic_load(p)    _InterlockedCompareExchange(p, 0, 0)
+#define stbi__yield()           SwitchToThread()
+#elif defined(__GNUC__)
+#define STBI__PARALLEL
+#include <sched.h>
+typedef volatile int stbi__atomic;
+#define stbi__atomic_inc(p)     __sync_fetch_and_add(p, 1)
+#define stbi__atomic_store(p,v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define stbi__atomic_load(p)    __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define stbi__yield()           sched_yield()
+#endif
+
 ///////////////////////////////////////////////
 //
 //  stbi__context struct and start_xxx functions
@@ -761,6 +822,8 @@ typedef struct
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   stbi_parallel const *parallel; // NULL unless loading with stbi_load_from_memory_parallel
 } stbi__context;
 
 
@@ -773,6 +836,7 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
    s->read_from_callbacks = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
    s->img_buffer_end = s->img_buffer_original_end = (stbi_uc *) buffer+len;
+   s->parallel = NULL;
 }
 
 // initialize a callback-based context
@@ -782,6 +846,7 @@ static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *
    s->io_user_data = user;
    s->buflen = sizeof(s->buffer_start);
    s->read_from_callbacks = 1;
+   s->parallel = NULL;
    s->img_buffer_original = s->buffer_start;
    stbi__refill_buffer(s);
    s->img_buffer_original_end = s->img_buffer_end;
@@ -1078,6 +1143,15 @@ STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *u
    return stbi__load_flip(&s,x,y,comp,req_comp);
 }
 
+STBIDEF stbi_uc *stbi_load_from_memory_parallel(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, stbi_parallel const *parallel)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   if (parallel && parallel->num_threads > 1)
+      s.parallel = parallel;
+   return stbi__load_flip(&s,x,y,comp,req_comp);
+}
+
 #ifndef STBI_NO_LINEAR
 static float *stbi__loadf_main(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
@@ -1497,7 +1571,7 @@ typedef struct
       int      coeff_w, coeff_h; // number of 8x8 coefficient blocks
    } img_comp[4];
 
-   stbi__uint32   code_buffer; // jpeg entropy-coded buffer
+   stbi__uint64   code_buffer; // jpeg entropy-coded buffer, next bit in the msb
    int            code_bits;   // number of valid bits
    unsigned char  marker;      // marker seen while filling entropy buffer
    int            nomore;      // flag if we saw a marker so must stop
@@ -1516,6 +1590,8 @@ typedef struct
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
    stbi_uc *(*resample_row_hv_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+   stbi_uc *(*resample_row_v_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+   stbi_uc *(*resample_row_h_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
 } stbi__jpeg;
 
 static int stbi__build_huffman(stbi__huffman *h, int *count)
@@ -1586,8 +1662,30 @@ static void stbi__build_fast_ac(stbi__int16 *fast_ac, stbi__huffman *h)
    }
 }
 
+// top n bits of the entropy buffer, n in 1..32
+#define stbi__jpeg_peek(j,n)  ((unsigned int) ((j)->code_buffer >> (64 - (n))))
+
 static void stbi__grow_buffer_unsafe(stbi__jpeg *j)
 {
+   // fast path: take every whole byte that fits in one go, as long as none
+   // of them is 0xff, which would be a stuffed zero or a marker
+   if (!j->nomore && j->s->img_buffer_end - j->s->img_buffer >= 8) {
+      stbi_uc *p = j->s->img_buffer;
+      int n = (64 - j->code_bits) >> 3;
+      stbi__uint64 v = ((stbi__uint64) p[0] << 56) | ((stbi__uint64) p[1] << 48) |
+                       ((stbi__uint64) p[2] << 40) | ((stbi__uint64) p[3] << 32) |
+                       ((stbi__uint64) p[4] << 24) | ((stbi__uint64) p[5] << 16) |
+                       ((stbi__uint64) p[6] <<  8) |  (stbi__uint64) p[7];
+      stbi__uint64 ff = ~v, keep = ~(stbi__uint64) 0 << (64 - 8*n);
+      // high bit set in each byte of v that was 0xff
+      ff = (ff - 0x0101010101010101ull) & ~ff & 0x8080808080808080ull;
+      if (!(ff & keep)) {
+         j->code_buffer |= (v & keep) >> j->code_bits;
+         j->code_bits += 8*n;
+         j->s->img_buffer += n;
+         return;
+      }
+   }
    do {
       int b = j->nomore ? 0 : stbi__get8(j->s);
       if (b == 0xff) {
@@ -1598,9 +1696,9 @@ static void stbi__grow_buffer_unsafe(stbi__jpeg *j)
             return;
          }
       }
-      j->code_buffer |= b << (24 - j->code_bits);
+      j->code_buffer |= (stbi__uint64) b << (56 - j->code_bits);
       j->code_bits += 8;
-   } while (j->code_bits <= 24);
+   } while (j->code_bits <= 56);
 }
 
 // (1 << n) - 1
@@ -1616,7 +1714,7 @@ stbi_inline static int stbi__jpeg_huff_decode(stbi__jpeg *j, stbi__huffman *h)
 
    // look at the top FAST_BITS and determine what symbol ID it is,
    // if the code is <= FAST_BITS
-   c = (j->code_buffer >> (32 - FAST_BITS)) & ((1 << FAST_BITS)-1);
+   c = stbi__jpeg_peek(j, FAST_BITS);
    k = h->fast[c];
    if (k < 255) {
       int s = h->size[k];
@@ -1633,7 +1731,7 @@ stbi_inline static int stbi__jpeg_huff_decode(stbi__jpeg *j, stbi__huffman *h)
    // end; in other words, regardless of the number of bits, it
    // wants to be compared against something shifted to have 16;
    // that way we don't need to shift inside the loop.
-   temp = j->code_buffer >> 16;
+   temp = stbi__jpeg_peek(j, 16);
    for (k=FAST_BITS+1 ; ; ++k)
       if (temp < h->maxcode[k])
          break;
@@ -1647,8 +1745,8 @@ stbi_inline static int stbi__jpeg_huff_decode(stbi__jpeg *j, stbi__huffman *h)
       return -1;
 
    // convert the huffman code to the symbol id
-   c = ((j->code_buffer >> (32 - k)) & stbi__bmask[k]) + h->delta[k];
-   STBI_ASSERT((((j->code_buffer) >> (32 - h->size[c])) & stbi__bmask[h->size[c]]) == h->code[c]);
+   c = stbi__jpeg_peek(j, k) + h->delta[k];
+   STBI_ASSERT(stbi__jpeg_peek(j, h->size[c]) == h->code[c]);
 
    // convert the id to a symbol
    j->code_bits -= k;
@@ -1667,11 +1765,10 @@ stbi_inline static int stbi__extend_receive(stbi__jpeg *j, int n)
    int sgn;
    if (j->code_bits < n) stbi__grow_buffer_unsafe(j);
 
-   sgn = (stbi__int32)j->code_buffer >> 31; // sign bit is always in MSB
-   k = stbi_lrot(j->code_buffer, n);
-   STBI_ASSERT(n >= 0 && n < (int) (sizeof(stbi__bmask)/sizeof(*stbi__bmask)));
-   j->code_buffer = k & ~stbi__bmask[n];
-   k &= stbi__bmask[n];
+   STBI_ASSERT(n > 0 && n < (int) (sizeof(stbi__bmask)/sizeof(*stbi__bmask)));
+   sgn = (stbi__int32) stbi__jpeg_peek(j, 32) >> 31; // sign bit is always in MSB
+   k = stbi__jpeg_peek(j, n);
+   j->code_buffer <<= n;
    j->code_bits -= n;
    return k + (stbi__jbias[n] & ~sgn);
 }
@@ -1681,9 +1778,9 @@ stbi_inline static int stbi__jpeg_get_bits(stbi__jpeg *j, int n)
 {
    unsigned int k;
    if (j->code_bits < n) stbi__grow_buffer_unsafe(j);
-   k = stbi_lrot(j->code_buffer, n);
-   j->code_buffer = k & ~stbi__bmask[n];
-   k &= stbi__bmask[n];
+   STBI_ASSERT(n > 0);
+   k = stbi__jpeg_peek(j, n);
+   j->code_buffer <<= n;
    j->code_bits -= n;
    return k;
 }
@@ -1692,10 +1789,10 @@ stbi_inline static int stbi__jpeg_get_bit(stbi__jpeg *j)
 {
    unsigned int k;
    if (j->code_bits < 1) stbi__grow_buffer_unsafe(j);
-   k = j->code_buffer;
+   k = stbi__jpeg_peek(j, 1);
    j->code_buffer <<= 1;
    --j->code_bits;
-   return k & 0x80000000;
+   return k;
 }
 
 // given a value that's at position X in the zigzag stream,
@@ -1739,7 +1836,7 @@ static int stbi__jpeg_decode_block(stbi__jpeg *j, short data[64], stbi__huffman
       unsigned int zig;
       int c,r,s;
       if (j->code_bits < 16) stbi__grow_buffer_unsafe(j);
-      c = (j->code_buffer >> (32 - FAST_BITS)) & ((1 << FAST_BITS)-1);
+      c = stbi__jpeg_peek(j, FAST_BITS);
       r = fac[c];
       if (r) { // fast-AC path
          k += (r >> 4) & 15; // run
@@ -1813,7 +1910,7 @@ static int stbi__jpeg_decode_block_prog_ac(stbi__jpeg *j, short data[64], stbi__
          unsigned int zig;
          int c,r,s;
          if (j->code_bits < 16) stbi__grow_buffer_unsafe(j);
-         c = (j->code_buffer >> (32 - FAST_BITS)) & ((1 << FAST_BITS)-1);
+         c = stbi__jpeg_peek(j, FAST_BITS);
          r = fac[c];
          if (r) { // fast-AC path
             k += (r >> 4) & 15; // run
@@ -2448,6 +2545,156 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+#ifdef STBI__PARALLEL
+// decode MCUs [first,last) of a baseline scan, numbered in scan order
+static int stbi__jpeg_decode_mcus(stbi__jpeg *z, int first, int last)
+{
+   STBI_SIMD_ALIGN(short, data[64]);
+   int m;
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      int w = (z->img_comp[n].x+7) >> 3;
+      int ha = z->img_comp[n].ha;
+      for (m=first; m < last; ++m) {
+         int i = m % w, j = m / w;
+         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+         z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+      }
+   } else {
+      for (m=first; m < last; ++m) {
+         int i = m % z->img_mcu_x, j = m / z->img_mcu_x;
+         int k,x,y;
+         for (k=0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            for (y=0; y < z->img_comp[n].v; ++y) {
+               for (x=0; x < z->img_comp[n].h; ++x) {
+                  int x2 = (i*z->img_comp[n].h + x)*8;
+                  int y2 = (j*z->img_comp[n].v + y)*8;
+                  int ha = z->img_comp[n].ha;
+                  if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                  z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+               }
+            }
+         }
+      }
+   }
+   return 1;
+}
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc **segments; // where each restart interval's entropy coded data starts
+   int num_segments, num_mcus, num_tasks;
+   stbi__atomic mismatch;
+   stbi_uc *end;       // where the last interval left off, and the marker it ran into
+   int end_marker;
+} stbi__jpeg_segments;
+
+static void stbi__jpeg_decode_segments_task(void *data, int t)
+{
+   stbi__jpeg_segments *p = (stbi__jpeg_segments *) data;
+   int first = p->num_segments * t / p->num_tasks;
+   int last = p->num_segments * (t+1) / p->num_tasks;
+   stbi__context s;
+   stbi__jpeg *j = (stbi__jpeg *) stbi__malloc(sizeof(*j));
+   int seg;
+   if (!j) {
+      stbi__atomic_store(&p->mismatch, 1);
+      return;
+   }
+   // own copy of the entropy decoder state, shared tables and output planes
+   *j = *p->z;
+   j->s = &s;
+   for (seg=first; seg < last && !stbi__atomic_load(&p->mismatch); ++seg) {
+      int is_last = seg == p->num_segments-1;
+      int mcu_first = seg * j->restart_interval;
+      int mcu_last = is_last ? p->num_mcus : mcu_first + j->restart_interval;
+      stbi__start_mem(&s, p->segments[seg], (int) (p->z->s->img_buffer_end - p->segments[seg]));
+      stbi__jpeg_reset(j);
+      if (!stbi__jpeg_decode_mcus(j, mcu_first, mcu_last)) {
+         stbi__atomic_store(&p->mismatch, 1);
+         break;
+      }
+      // the checks the serial decoder makes when an interval's count runs out.
+      // an interval that didn't end right at its RSTn is corrupt data the
+      // serial decoder has its own way of giving up on
+      if (mcu_last - mcu_first == j->restart_interval) {
+         if (j->code_bits < 24) stbi__grow_buffer_unsafe(j);
+         if (STBI__RESTART(j->marker) == is_last) {
+            stbi__atomic_store(&p->mismatch, 1);
+            break;
+         }
+      }
+      if (is_last) {
+         p->end = s.img_buffer;
+         p->end_marker = j->marker;
+      }
+   }
+   STBI_FREE(j);
+}
+
+// decodes a baseline scan with restart intervals on several threads, one or
+// more intervals per task. returns 0 if it didn't, with nothing read: no
+// parallel request, no restart intervals, or the data isn't laid out the way
+// the serial decoder would decode it, which is then left to deal with it.
+static int stbi__parse_entropy_coded_data_parallel(stbi__jpeg *z)
+{
+   stbi__context *s = z->s;
+   stbi__jpeg_segments p;
+   stbi_uc *q = s->img_buffer, *end = s->img_buffer_end;
+   int n = 0, num_tasks;
+
+   if (!s->parallel || z->progressive || !z->restart_interval || s->read_from_callbacks)
+      return 0;
+   if (z->scan_n == 1) {
+      int c = z->order[0];
+      p.num_mcus = ((z->img_comp[c].x+7) >> 3) * ((z->img_comp[c].y+7) >> 3);
+   } else {
+      p.num_mcus = z->img_mcu_x * z->img_mcu_y;
+   }
+   p.num_segments = (p.num_mcus + z->restart_interval - 1) / z->restart_interval;
+   if (p.num_segments < 2) return 0;
+   p.segments = (stbi_uc **) stbi__malloc(p.num_segments * sizeof(*p.segments));
+   if (!p.segments) return 0;
+
+   // find the RSTn markers, all but the last interval should end in one
+   p.segments[n++] = q;
+   while (n < p.num_segments) {
+      q = (stbi_uc *) memchr(q, 0xff, end - q);
+      if (!q || q+1 >= end) break;
+      if (q[1] == 0) {
+         q += 2; // stuffed zero
+      } else if (STBI__RESTART(q[1])) {
+         q += 2;
+         p.segments[n++] = q;
+      } else {
+         break;
+      }
+   }
+   if (n != p.num_segments) {
+      STBI_FREE(p.segments);
+      return 0;
+   }
+
+   num_tasks = s->parallel->num_threads;
+   if (num_tasks > p.num_segments) num_tasks = p.num_segments;
+   p.z = z;
+   p.num_tasks = num_tasks;
+   p.mismatch = 0;
+   p.end = NULL;
+   p.end_marker = STBI__MARKER_none;
+   s->parallel->run(s->parallel->user, stbi__jpeg_decode_segments_task, &p, num_tasks);
+   STBI_FREE(p.segments);
+   if (stbi__atomic_load(&p.mismatch) || !p.end) return 0;
+
+   // leave off where the serial decoder would have
+   s->img_buffer = p.end;
+   z->marker = (unsigned char) p.end_marker;
+   return 1;
+}
+#endif
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
@@ -2827,8 +3074,12 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
    m = stbi__get_marker(j);
    while (!stbi__EOI(m)) {
       if (stbi__SOS(m)) {
+         int decoded = 0;
          if (!stbi__process_scan_header(j)) return 0;
-         if (!stbi__parse_entropy_coded_data(j)) return 0;
+         #ifdef STBI__PARALLEL
+         decoded = stbi__parse_entropy_coded_data_parallel(j);
+         #endif
+         if (!decoded && !stbi__parse_entropy_coded_data(j)) return 0;
          if (j->marker == STBI__MARKER_none ) {
             // handle 0s at the end of image data from IP Kamera 9060
             while (!stbi__at_eof(j->s)) {
@@ -2906,6 +3157,98 @@ static stbi_uc*  stbi__resample_row_h_2(stbi_uc *out, stbi_uc *in_near, stbi_uc
    return out;
 }
 
+#if defined(STBI_SSE2) || defined(STBI_NEON)
+static stbi_uc *stbi__resample_row_v_2_simd(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   // same filter as stbi__resample_row_v_2, 16 pixels at a time in 16 bits
+   // so the rounding matches exactly
+   int i=0;
+   for (; i+16 <= w; i += 16) {
+#if defined(STBI_SSE2)
+      // 3*x + y + 2 = 4*x + (y - x) + 2
+      __m128i zero  = _mm_setzero_si128();
+      __m128i bias  = _mm_set1_epi16(2);
+      __m128i nearb = _mm_loadu_si128((__m128i *) (in_near + i));
+      __m128i farb  = _mm_loadu_si128((__m128i *) (in_far + i));
+      __m128i nlo   = _mm_unpacklo_epi8(nearb, zero);
+      __m128i nhi   = _mm_unpackhi_epi8(nearb, zero);
+      __m128i flo   = _mm_unpacklo_epi8(farb, zero);
+      __m128i fhi   = _mm_unpackhi_epi8(farb, zero);
+      __m128i lo    = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(nlo, 2), _mm_sub_epi16(flo, nlo)), bias);
+      __m128i hi    = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(nhi, 2), _mm_sub_epi16(fhi, nhi)), bias);
+      _mm_storeu_si128((__m128i *) (out + i), _mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2)));
+#elif defined(STBI_NEON)
+      // 3*x + y = 4*x + (y - x), then round while narrowing
+      uint8x16_t nearb = vld1q_u8(in_near + i);
+      uint8x16_t farb  = vld1q_u8(in_far + i);
+      int16x8_t lo = vaddq_s16(vreinterpretq_s16_u16(vshll_n_u8(vget_low_u8(nearb), 2)),
+                               vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(farb), vget_low_u8(nearb))));
+      int16x8_t hi = vaddq_s16(vreinterpretq_s16_u16(vshll_n_u8(vget_high_u8(nearb), 2)),
+                               vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(farb), vget_high_u8(nearb))));
+      vst1q_u8(out + i, vcombine_u8(vqrshrun_n_s16(lo, 2), vqrshrun_n_s16(hi, 2)));
+#endif
+   }
+   for (; i < w; ++i)
+      out[i] = stbi__div4(3*in_near[i] + in_far[i] + 2);
+   STBI_NOTUSED(hs);
+   return out;
+}
+
+static stbi_uc *stbi__resample_row_h_2_simd(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   // same filter as stbi__resample_row_h_2, 8 input pixels at a time. the
+   // edges and whatever is left over go through the scalar loop.
+   int i;
+   stbi_uc *input = in_near;
+
+   if (w == 1) {
+      // if only one sample, can't do any interpolation
+      out[0] = out[1] = input[0];
+      return out;
+   }
+
+   out[0] = input[0];
+   out[1] = stbi__div4(input[0]*3 + input[1] + 2);
+   // each group reads one pixel either side of it, so it has to end before w-1
+   for (i=1; i+8 < w; i += 8) {
+#if defined(STBI_SSE2)
+      // even pixels = 3*cur + prev = cur*4 + (prev - cur)
+      // odd  pixels = 3*cur + next = cur*4 + (next - cur)
+      __m128i zero = _mm_setzero_si128();
+      __m128i bias = _mm_set1_epi16(2);
+      __m128i prev = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (input + i - 1)), zero);
+      __m128i curr = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (input + i)), zero);
+      __m128i next = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (input + i + 1)), zero);
+      __m128i curb = _mm_add_epi16(_mm_slli_epi16(curr, 2), bias);
+      __m128i even = _mm_srli_epi16(_mm_add_epi16(curb, _mm_sub_epi16(prev, curr)), 2);
+      __m128i odd  = _mm_srli_epi16(_mm_add_epi16(curb, _mm_sub_epi16(next, curr)), 2);
+      _mm_storeu_si128((__m128i *) (out + i*2), _mm_packus_epi16(_mm_unpacklo_epi16(even, odd), _mm_unpackhi_epi16(even, odd)));
+#elif defined(STBI_NEON)
+      uint8x8_t prev = vld1_u8(input + i - 1);
+      uint8x8_t curr = vld1_u8(input + i);
+      uint8x8_t next = vld1_u8(input + i + 1);
+      int16x8_t curs = vreinterpretq_s16_u16(vshll_n_u8(curr, 2));
+      uint8x8x2_t o;
+      o.val[0] = vqrshrun_n_s16(vaddq_s16(curs, vreinterpretq_s16_u16(vsubl_u8(prev, curr))), 2);
+      o.val[1] = vqrshrun_n_s16(vaddq_s16(curs, vreinterpretq_s16_u16(vsubl_u8(next, curr))), 2);
+      vst2_u8(out + i*2, o);
+#endif
+   }
+   for (; i < w-1; ++i) {
+      int n = 3*input[i]+2;
+      out[i*2+0] = stbi__div4(n+input[i-1]);
+      out[i*2+1] = stbi__div4(n+input[i+1]);
+   }
+   out[i*2+0] = stbi__div4(input[w-2]*3 + input[w-1] + 2);
+   out[i*2+1] = input[w-1];
+
+   STBI_NOTUSED(in_far);
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+#endif
+
 #define stbi__div16(x) ((stbi_uc) ((x) >> 4))
 
 static stbi_uc *stbi__resample_row_hv_2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
@@ -3124,10 +3467,10 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
    int i = 0;
 
 #ifdef STBI_SSE2
-   // step == 3 is pretty ugly on the final interleave, and i'm not convinced
-   // it's useful in practice (you wouldn't use it for textures, for example).
-   // so just accelerate step == 4 case.
-   if (step == 4) {
+   // step == 3 is what you get loading a jpeg with req_comp 0, so it's worth
+   // the uglier final interleave: squeeze the alpha bytes out of step 4's
+   // output.
+   if (step == 4 || step == 3) {
       // this is a fairly straightforward implementation and not super-optimized.
       __m128i signflip  = _mm_set1_epi8(-0x80);
       __m128i cr_const0 = _mm_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
@@ -3136,6 +3479,10 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
       __m128i cb_const1 = _mm_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
       __m128i y_bias = _mm_set1_epi8((char) (unsigned char) 128);
       __m128i xw = _mm_set1_epi16(255); // alpha channel
+      __m128i rgb0 = _mm_set_epi32(0, 0xffffff, 0, 0xffffff);                               // rgb of the 1st pixel in each 64 bits
+      __m128i rgb1 = _mm_set_epi32(0xffff, (int) 0xff000000, 0xffff, (int) 0xff000000);     // 2nd pixel's, once moved down a byte
+      __m128i rgb_lo = _mm_set_epi32(0, 0, 0x0000ffff, (int) 0xffffffff);                   // bytes 0..5
+      __m128i rgb_hi = _mm_set_epi32(0, (int) 0xffffffff, (int) 0xffff0000, 0);             // bytes 6..11
 
       for (; i+7 < count; i += 8) {
          // load
@@ -3177,16 +3524,27 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
          __m128i o1 = _mm_unpackhi_epi16(t0, t1);
 
          // store
-         _mm_storeu_si128((__m128i *) (out + 0), o0);
-         _mm_storeu_si128((__m128i *) (out + 16), o1);
-         out += 32;
+         if (step == 4) {
+            _mm_storeu_si128((__m128i *) (out + 0), o0);
+            _mm_storeu_si128((__m128i *) (out + 16), o1);
+            out += 32;
+         } else {
+            // rgbx rgbx per 64 bits -> rgbrgb in the low 48, then close the
+            // gap between the two halves to get 12 packed bytes per register
+            __m128i p0 = _mm_or_si128(_mm_and_si128(o0, rgb0), _mm_and_si128(_mm_srli_epi64(o0, 8), rgb1));
+            __m128i p1 = _mm_or_si128(_mm_and_si128(o1, rgb0), _mm_and_si128(_mm_srli_epi64(o1, 8), rgb1));
+            p0 = _mm_or_si128(_mm_and_si128(p0, rgb_lo), _mm_and_si128(_mm_srli_si128(p0, 2), rgb_hi));
+            p1 = _mm_or_si128(_mm_and_si128(p1, rgb_lo), _mm_and_si128(_mm_srli_si128(p1, 2), rgb_hi));
+            _mm_storeu_si128((__m128i *) (out + 0), _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+            _mm_storel_epi64((__m128i *) (out + 16), _mm_srli_si128(p1, 4));
+            out += 24;
+         }
       }
    }
 #endif
 
 #ifdef STBI_NEON
-   // in this version, step=3 support would be easy to add. but is there demand?
-   if (step == 4) {
+   if (step == 4 || step == 3) {
       // this is a fairly straightforward implementation and not super-optimized.
       uint8x8_t signflip = vdup_n_u8(0x80);
       int16x8_t cr_const0 = vdupq_n_s16(   (short) ( 1.40200f*4096.0f+0.5f));
@@ -3224,8 +3582,17 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
          o.val[3] = vdup_n_u8(255);
 
          // store, interleaving r/g/b/a
-         vst4_u8(out, o);
-         out += 8*4;
+         if (step == 4) {
+            vst4_u8(out, o);
+            out += 8*4;
+         } else {
+            uint8x8x3_t o3;
+            o3.val[0] = o.val[0];
+            o3.val[1] = o.val[1];
+            o3.val[2] = o.val[2];
+            vst3_u8(out, o3);
+            out += 8*3;
+         }
       }
    }
 #endif
@@ -3259,6 +3626,8 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
+   j->resample_row_v_2_kernel = stbi__resample_row_v_2;
+   j->resample_row_h_2_kernel = stbi__resample_row_h_2;
 
 #ifdef STBI_SSE2
    if (stbi__sse2_available()) {
@@ -3267,6 +3636,8 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
       j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
       #endif
       j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+      j->resample_row_v_2_kernel = stbi__resample_row_v_2_simd;
+      j->resample_row_h_2_kernel = stbi__resample_row_h_2_simd;
    }
 #endif
 
@@ -3276,6 +3647,8 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
    #endif
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+   j->resample_row_v_2_kernel = stbi__resample_row_v_2_simd;
+   j->resample_row_h_2_kernel = stbi__resample_row_h_2_simd;
 #endif
 }
 
@@ -3355,8 +3728,8 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
          r->line0   = r->line1 = z->img_comp[k].data;
 
          if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
+         else if (r->hs == 1 && r->vs == 2) r->resample = z->resample_row_v_2_kernel;
+         else if (r->hs == 2 && r->vs == 1) r->resample = z->resample_row_h_2_kernel;
          else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
          else                               r->resample = stbi__resample_row_generic;
       }
@@ -3457,7 +3830,7 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #ifndef STBI_NO_ZLIB
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
-#define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
+#define STBI__ZFAST_BITS  11 // accelerate all cases in default tables, most in dynamic ones
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 
 // zlib-style huffman encoding
@@ -3546,13 +3919,17 @@ typedef struct
 {
    stbi_uc *zbuffer, *zbuffer_end;
    int num_bits;
-   stbi__uint32 code_buffer;
+   stbi__uint64 code_buffer;
 
    char *zout;
    char *zout_start;
    char *zout_end;
    int   z_expandable;
 
+   #ifdef STBI__PARALLEL
+   stbi__atomic *progress; // if not NULL, bytes output so far, updated after every block
+   #endif
+
    stbi__zhuffman z_length, z_distance;
 } stbi__zbuf;
 
@@ -3562,20 +3939,42 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
    return *z->zbuffer++;
 }
 
+stbi_inline static stbi__uint64 stbi__zload64(const stbi_uc *p)
+{
+#if defined(STBI__X86_TARGET) || defined(STBI__X64_TARGET)
+   stbi__uint64 v;
+   memcpy(&v, p, 8); // little endian, unaligned loads are fine
+   return v;
+#else
+   return (stbi__uint64) p[0]       | ((stbi__uint64) p[1] <<  8) |
+         ((stbi__uint64) p[2] << 16) | ((stbi__uint64) p[3] << 24) |
+         ((stbi__uint64) p[4] << 32) | ((stbi__uint64) p[5] << 40) |
+         ((stbi__uint64) p[6] << 48) | ((stbi__uint64) p[7] << 56);
+#endif
+}
+
 static void stbi__fill_bits(stbi__zbuf *z)
 {
+   if (z->zbuffer_end - z->zbuffer >= 8) {
+      // refill with one load: keep as many whole bytes as fit, leaving 56..63
+      // bits. the bits above num_bits are the start of the next byte, which
+      // the next refill ORs in again at the same place.
+      z->code_buffer |= stbi__zload64(z->zbuffer) << z->num_bits;
+      z->zbuffer += (63 - z->num_bits) >> 3;
+      z->num_bits |= 56;
+      return;
+   }
    do {
-      STBI_ASSERT(z->code_buffer < (1U << z->num_bits));
-      z->code_buffer |= (unsigned int) stbi__zget8(z) << z->num_bits;
+      z->code_buffer |= (stbi__uint64) stbi__zget8(z) << z->num_bits;
       z->num_bits += 8;
-   } while (z->num_bits <= 24);
+   } while (z->num_bits <= 56);
 }
 
 stbi_inline static unsigned int stbi__zreceive(stbi__zbuf *z, int n)
 {
    unsigned int k;
    if (z->num_bits < n) stbi__fill_bits(z);
-   k = z->code_buffer & ((1 << n) - 1);
+   k = (unsigned int) (z->code_buffer & ((1 << n) - 1));
    z->code_buffer >>= n;
    z->num_bits -= n;
    return k;
@@ -3586,7 +3985,7 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf *a, stbi__zhuffman *z)
    int b,s,k;
    // not resolved by fast table, so compute it the slow way
    // use jpeg approach, which requires MSbits at top
-   k = stbi__bit_reverse(a->code_buffer, 16);
+   k = stbi__bit_reverse((int) (a->code_buffer & 0xffff), 16);
    for (s=STBI__ZFAST_BITS+1; ; ++s)
       if (k < z->maxcode[s])
          break;
@@ -3603,7 +4002,7 @@ stbi_inline static int stbi__zhuffman_decode(stbi__zbuf *a, stbi__zhuffman *z)
 {
    int b,s;
    if (a->num_bits < 16) stbi__fill_bits(a);
-   b = z->fast[a->code_buffer & STBI__ZFAST_MASK];
+   b = z->fast[(int) (a->code_buffer & STBI__ZFAST_MASK)];
    if (b) {
       s = b >> 9;
       a->code_buffer >>= s;
@@ -3680,6 +4079,10 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
          if (dist == 1) { // run of one byte; common in images.
             stbi_uc v = *p;
             if (len) { do *zout++ = v; while (--len); }
+         } else if (dist >= 8) { // source 8 bytes never overlaps what they're copied to
+            for (; len >= 8; len -= 8, zout += 8, p += 8)
+               memcpy(zout, p, 8);
+            if (len) { do *zout++ = *p++; while (--len); }
          } else {
             if (len) { do *zout++ = *p++; while (--len); }
          }
@@ -3741,21 +4144,30 @@ static int stbi__parse_uncomperssed_block(stbi__zbuf *a)
       stbi__zreceive(a, a->num_bits & 7); // discard
    // drain the bit-packed data into header
    k = 0;
-   while (a->num_bits > 0) {
+   while (a->num_bits > 0 && k < 4) {
       header[k++] = (stbi_uc) (a->code_buffer & 255); // suppress MSVC run-time check
       a->code_buffer >>= 8;
       a->num_bits -= 8;
    }
-   STBI_ASSERT(a->num_bits == 0);
    // now fill header the normal way
    while (k < 4)
       header[k++] = stbi__zget8(a);
    len  = header[1] * 256 + header[0];
    nlen = header[3] * 256 + header[2];
    if (nlen != (len ^ 0xffff)) return stbi__err("zlib corrupt","Corrupt PNG");
-   if (a->zbuffer + len > a->zbuffer_end) return stbi__err("read past buffer","Corrupt PNG");
    if (a->zout + len > a->zout_end)
       if (!stbi__zexpand(a, a->zout, len)) return 0;
+   // the 64-bit refill can leave a few more whole bytes in the bit buffer,
+   // those come first. any left over belong to the next block.
+   while (a->num_bits > 0 && len > 0) {
+      *a->zout++ = (char) (a->code_buffer & 255);
+      a->code_buffer >>= 8;
+      a->num_bits -= 8;
+      --len;
+   }
+   if (a->num_bits == 0)
+      a->code_buffer = 0; // lookahead bits of bytes about to be skipped
+   if (a->zbuffer + len > a->zbuffer_end) return stbi__err("read past buffer","Corrupt PNG");
    memcpy(a->zout, a->zbuffer, len);
    a->zbuffer += len;
    a->zout += len;
@@ -3813,6 +4225,10 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
          }
          if (!stbi__parse_huffman_block(a)) return 0;
       }
+      #ifdef STBI__PARALLEL
+      if (a->progress)
+         stbi__atomic_store(a->progress, (int) (a->zout - a->zout_start));
+      #endif
    } while (!final);
    return 1;
 }
@@ -3823,6 +4239,9 @@ static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
    a->z_expandable = exp;
+   #ifdef STBI__PARALLEL
+   a->progress = NULL;
+   #endif
 
    return stbi__parse_zlib(a, parse_header);
 }
@@ -3937,10 +4356,22 @@ static int stbi__check_png_header(stbi__context *s)
    return 1;
 }
 
+#ifdef STBI__PARALLEL
+// how far inflate has got, for unfiltering rows while it's still going
+typedef struct
+{
+   stbi__atomic avail;  // bytes of filtered rows inflated so far
+   stbi__atomic done;   // set when inflate has finished or failed
+} stbi__png_stream;
+#endif
+
 typedef struct
 {
    stbi__context *s;
    stbi_uc *idata, *expanded, *out;
+   #ifdef STBI__PARALLEL
+   stbi__png_stream *stream; // NULL unless the rows are still being inflated
+   #endif
 } stbi__png;
 
 
@@ -3977,6 +4408,116 @@ static int stbi__paeth(int a, int b, int c)
 
 static stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
+#ifdef STBI_SSE2
+// sub, avg and paeth depend on the pixel to the left, so these go a pixel at
+// a time with all of its channels in one register. 8-bit only, img_n 3 or 4,
+// out_n 4 when img_n is 3 and alpha gets added. not for the first row.
+
+stbi_inline static __m128i stbi__png_load_pixel(stbi_uc *p, int n)
+{
+   stbi__uint32 v;
+   if (n == 4)
+      memcpy(&v, p, 4);
+   else
+      v = p[0] | (p[1] << 8) | (p[2] << 16);
+   return _mm_cvtsi32_si128((int) v);
+}
+
+stbi_inline static void stbi__png_store_pixel(stbi_uc *p, int n, __m128i v, stbi__uint32 alpha)
+{
+   stbi__uint32 u = (stbi__uint32) _mm_cvtsi128_si32(v) | alpha;
+   if (n == 4) {
+      memcpy(p, &u, 4);
+   } else {
+      p[0] = (stbi_uc) u;
+      p[1] = (stbi_uc) (u >> 8);
+      p[2] = (stbi_uc) (u >> 16);
+   }
+}
+
+static void stbi__png_unfilter_row_sse2(stbi_uc *cur, stbi_uc *raw, stbi_uc *prior, stbi__uint32 x, int img_n, int out_n, int filter)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i a = zero; // left, as bytes; 16-bit lanes for paeth
+   __m128i c = zero; // upper left, 16-bit lanes
+   stbi__uint32 alpha = (img_n != out_n) ? 0xff000000u : 0;
+   stbi__uint32 i;
+
+   switch (filter) {
+      case STBI__F_sub:
+         for (i=0; i < x; ++i, raw += img_n, cur += out_n) {
+            a = _mm_add_epi8(stbi__png_load_pixel(raw, img_n), a);
+            stbi__png_store_pixel(cur, out_n, a, alpha);
+         }
+         break;
+      case STBI__F_up:
+         if (img_n == out_n) {
+            // no dependency along the row, go 16 bytes at a time
+            stbi__uint32 k, n = x*img_n;
+            for (k=0; k + 16 <= n; k += 16) {
+               __m128i d = _mm_loadu_si128((__m128i *) (raw + k));
+               __m128i b = _mm_loadu_si128((__m128i *) (prior + k));
+               _mm_storeu_si128((__m128i *) (cur + k), _mm_add_epi8(d, b));
+            }
+            for (; k < n; ++k)
+               cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+            break;
+         }
+         for (i=0; i < x; ++i, raw += img_n, cur += out_n, prior += out_n) {
+            __m128i d = _mm_add_epi8(stbi__png_load_pixel(raw, img_n), stbi__png_load_pixel(prior, img_n));
+            stbi__png_store_pixel(cur, out_n, d, alpha);
+         }
+         break;
+      case STBI__F_avg: {
+         __m128i one = _mm_set1_epi8(1);
+         for (i=0; i < x; ++i, raw += img_n, cur += out_n, prior += out_n) {
+            __m128i b = stbi__png_load_pixel(prior, img_n);
+            // _mm_avg_epu8 rounds up, png rounds down
+            __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+            a = _mm_add_epi8(stbi__png_load_pixel(raw, img_n), avg);
+            stbi__png_store_pixel(cur, out_n, a, alpha);
+         }
+         break;
+      }
+      case STBI__F_paeth:
+         for (i=0; i < x; ++i, raw += img_n, cur += out_n, prior += out_n) {
+            __m128i b = _mm_unpacklo_epi8(stbi__png_load_pixel(prior, img_n), zero);
+            __m128i pa = _mm_sub_epi16(b, c);   // p - a, where p = a + b - c
+            __m128i pb = _mm_sub_epi16(a, c);   // p - b
+            __m128i pc = _mm_add_epi16(pa, pb); // p - c
+            __m128i smallest, pred;
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            smallest = _mm_min_epi16(pa, _mm_min_epi16(pb, pc));
+            // same tie-breaking as stbi__paeth: a, then b, then c
+            pred = _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi16(pb, smallest), b),
+                                _mm_andnot_si128(_mm_cmpeq_epi16(pb, smallest), c));
+            pred = _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi16(pa, smallest), a),
+                                _mm_andnot_si128(_mm_cmpeq_epi16(pa, smallest), pred));
+            pred = _mm_add_epi8(stbi__png_load_pixel(raw, img_n), _mm_packus_epi16(pred, zero));
+            stbi__png_store_pixel(cur, out_n, pred, alpha);
+            a = _mm_unpacklo_epi8(pred, zero);
+            c = b;
+         }
+         break;
+   }
+}
+#endif
+
+#ifdef STBI__PARALLEL
+// waits until the first n bytes are inflated. 0 if inflate stopped before that
+static int stbi__png_stream_wait(stbi__png_stream *stream, stbi__uint32 n)
+{
+   while ((stbi__uint32) stbi__atomic_load(&stream->avail) < n) {
+      if (stbi__atomic_load(&stream->done))
+         return (stbi__uint32) stbi__atomic_load(&stream->avail) >= n;
+      stbi__yield();
+   }
+   return 1;
+}
+#endif
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -3985,6 +4526,9 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    stbi__uint32 img_len, img_width_bytes;
    int k;
    int img_n = s->img_n; // copy it into a local for later
+   #ifdef STBI_SSE2
+   int simd = depth == 8 && (img_n == 3 || img_n == 4) && stbi__sse2_available();
+   #endif
 
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
    a->out = (stbi_uc *) stbi__malloc(x * y * out_n); // extra bytes to write off the end into
@@ -4001,9 +4545,14 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    for (j=0; j < y; ++j) {
       stbi_uc *cur = a->out + stride*j;
       stbi_uc *prior = cur - stride;
-      int filter = *raw++;
+      int filter;
       int filter_bytes = img_n;
       int width = x;
+      #ifdef STBI__PARALLEL
+      if (a->stream && !stbi__png_stream_wait(a->stream, (j+1) * (img_width_bytes+1)))
+         return stbi__err("not enough pixels","Corrupt PNG");
+      #endif
+      filter = *raw++;
       if (filter > 4)
          return stbi__err("invalid filter","Corrupt PNG");
 
@@ -4017,6 +4566,14 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       // if first row, use special filter that doesn't sample previous row
       if (j == 0) filter = first_row_filter[filter];
 
+      #ifdef STBI_SSE2
+      if (simd && filter >= STBI__F_sub && filter <= STBI__F_paeth) {
+         stbi__png_unfilter_row_sse2(cur, raw, prior, x, img_n, out_n, filter);
+         raw += x*img_n;
+         continue;
+      }
+      #endif
+
       // handle first byte explicitly
       for (k=0; k < filter_bytes; ++k) {
          switch (filter) {
@@ -4198,6 +4755,71 @@ static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint3
    return 1;
 }
 
+#ifdef STBI__PARALLEL
+typedef struct
+{
+   stbi__png *png;
+   stbi__zbuf zbuf;
+   stbi__png_stream stream;
+   int parse_header, out_n, depth, color;
+   int inflated, unfiltered;
+   stbi__atomic role;
+} stbi__png_pipeline;
+
+// the first task to get here inflates and the second unfilters behind it, so
+// this works whether the runner has them run at the same time or in turn
+static void stbi__png_pipeline_task(void *data, int i)
+{
+   stbi__png_pipeline *p = (stbi__png_pipeline *) data;
+   STBI_NOTUSED(i);
+   if (stbi__atomic_inc(&p->role) == 0) {
+      p->inflated = stbi__parse_zlib(&p->zbuf, p->parse_header);
+      stbi__atomic_store(&p->stream.done, 1);
+   } else {
+      stbi__context *s = p->png->s;
+      p->unfiltered = stbi__create_png_image_raw(p->png, p->png->expanded, (stbi__uint32) (p->zbuf.zout_end - p->zbuf.zout_start),
+                                                 p->out_n, s->img_x, s->img_y, p->depth, p->color);
+   }
+}
+
+// inflate and stbi__create_png_image for non-interlaced images, as two tasks.
+// the rows go into a buffer of exactly the size they should be, so inflating
+// past it fails like the length check after a serial inflate does
+static int stbi__png_inflate_and_unfilter(stbi__png *z, stbi__uint32 ioff, int parse_header, int out_n, int depth, int color)
+{
+   stbi__context *s = z->s;
+   stbi__png_pipeline p;
+   stbi__uint32 img_len = ((((s->img_n * s->img_x * depth) + 7) >> 3) + 1) * s->img_y;
+
+   z->expanded = (stbi_uc *) stbi__malloc(img_len ? img_len : 1);
+   if (!z->expanded) return stbi__err("outofmem", "Out of memory");
+   p.png = z;
+   p.zbuf.zbuffer = z->idata;
+   p.zbuf.zbuffer_end = z->idata + ioff;
+   p.zbuf.zout_start = p.zbuf.zout = (char *) z->expanded;
+   p.zbuf.zout_end = (char *) z->expanded + img_len;
+   p.zbuf.z_expandable = 0;
+   p.zbuf.progress = &p.stream.avail;
+   p.stream.avail = 0;
+   p.stream.done = 0;
+   p.parse_header = parse_header;
+   p.out_n = out_n;
+   p.depth = depth;
+   p.color = color;
+   p.inflated = p.unfiltered = 0;
+   p.role = 0;
+
+   z->stream = &p.stream;
+   s->parallel->run(s->parallel->user, stbi__png_pipeline_task, &p, 2);
+   z->stream = NULL;
+   STBI_FREE(z->idata); z->idata = NULL;
+
+   if (!p.inflated || !p.unfiltered) return 0;
+   if (p.zbuf.zout != p.zbuf.zout_end) return stbi__err("not enough pixels","Corrupt PNG");
+   return 1;
+}
+#endif
+
 static int stbi__compute_transparency(stbi__png *z, stbi_uc tc[3], int out_n)
 {
    stbi__context *s = z->s;
@@ -4328,6 +4950,9 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
    z->expanded = NULL;
    z->idata = NULL;
    z->out = NULL;
+   #ifdef STBI__PARALLEL
+   z->stream = NULL;
+   #endif
 
    if (!stbi__check_png_header(s)) return 0;
 
@@ -4425,17 +5050,24 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if (scan != STBI__SCAN_load) return 1;
             if (z->idata == NULL) return stbi__err("no IDAT","Corrupt PNG");
-            // initial guess for decoded data size to avoid unnecessary reallocs
-            bpl = (s->img_x * depth + 7) / 8; // bytes per line, per component
-            raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
-            z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
-            if (z->expanded == NULL) return 0; // zlib should set error
-            STBI_FREE(z->idata); z->idata = NULL;
             if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
                s->img_out_n = s->img_n+1;
             else
                s->img_out_n = s->img_n;
-            if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, depth, color, interlace)) return 0;
+            #ifdef STBI__PARALLEL
+            if (s->parallel && !interlace) {
+               if (!stbi__png_inflate_and_unfilter(z, ioff, !is_iphone, s->img_out_n, depth, color)) return 0;
+            } else
+            #endif
+            {
+               // initial guess for decoded data size to avoid unnecessary reallocs
+               bpl = (s->img_x * depth + 7) / 8; // bytes per line, per component
+               raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
+               z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
+               if (z->expanded == NULL) return 0; // zlib should set error
+               STBI_FREE(z->idata); z->idata = NULL;
+               if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, depth, color, interlace)) return 0;
+            }
             if (has_trans)
                if (!stbi__compute_transparency(z, tc, s->img_out_n)) return 0;
             if (is_iphone && stbi__de_iphone_flag && s->img_out_n > 2)
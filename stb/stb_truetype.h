@@ -115,6 +115,12 @@
 //        #define STBTT_RASTERIZER_VERSION 1
 //   which will incur about a 15% speed hit.
 //
+//   On x86 and x64 builds that target SSE2, the new rasterizer turns coverage
+//   into pixels 16 at a time, and the oversampling prefilters use SSE2 too.
+//   The prefilters give the same pixels as the C code. The running coverage
+//   sum adds in a different order, so a pixel could in principle come out one
+//   level off from a plain C build. #define STBTT_NO_SIMD for the C code.
+//
 // ADDITIONAL DOCUMENTATION
 //
 //   Immediately after this block comment are a series of sample programs.
@@ -187,6 +193,8 @@
 //      if you don't do this, stb_truetype is forced to do the conversion on
 //      every call.
 //
+//    - To bake a big atlas on several threads, see stbtt_PackSetParallel.
+//
 //    - There are a lot of memory allocations. We should modify it to take
 //      a temp buffer and allocate from the temp buffer (without freeing),
 //      should help performance a lot.
@@ -576,6 +584,28 @@ STBTT_DEF void stbtt_PackSetOversampling(stbtt_pack_context *spc, unsigned int h
 // To use with PackFontRangesGather etc., you must set it before calls
 // call to PackFontRangesGatherRects.
 
+typedef struct
+{
+   void (*run)(void *user, void (*task)(void *task_data, int i), void *task_data, int count);
+   void *user;
+   int num_threads;
+} stbtt_parallel;
+
+STBTT_DEF void stbtt_PackSetParallel(stbtt_pack_context *spc, const stbtt_parallel *parallel);
+// Renders the glyphs of all following calls to stbtt_PackFontRange(s) and
+// stbtt_PackFontRangesRenderIntoRects on up to parallel->num_threads threads.
+// Gathering and packing the rects stays on the calling thread; after that
+// every glyph has its own rect, so they are rasterized and prefiltered
+// independently. Worth it for big atlases: CJK ranges, or many sizes.
+//
+// You provide the threads. run() must call task(task_data, i) once for each
+// i in [0, count), possibly at the same time, and return once they have all
+// returned. STBTT_malloc and STBTT_free must be thread-safe. The bitmap and
+// the packed chars come out the same as when rendered on one thread.
+//
+// Pass NULL, or set num_threads to 1, to render on the calling thread
+// again. The stbtt_parallel must stay valid until then or stbtt_PackEnd.
+
 STBTT_DEF void stbtt_GetPackedQuad(stbtt_packedchar *chardata, int pw, int ph,  // same data as above
                                int char_index,             // character to display
                                float *xpos, float *ypos,   // pointers to current position in screen pixel space
@@ -607,6 +637,7 @@ struct stbtt_pack_context {
    unsigned int   h_oversample, v_oversample;
    unsigned char *pixels;
    void  *nodes;
+   const stbtt_parallel *parallel;
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -939,6 +970,13 @@ typedef int stbtt__test_oversample_pow2[(STBTT_MAX_OVERSAMPLE & (STBTT_MAX_OVERS
 #define STBTT_RASTERIZER_VERSION 2
 #endif
 
+// SSE2 turns coverage into pixels and runs the oversampling prefilters when
+// the compiler targets it. #define STBTT_NO_SIMD to use plain C throughout.
+#if !defined(STBTT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define STBTT__SSE2
+#include <emmintrin.h>
+#endif
+
 //////////////////////////////////////////////////////////////////////////
 //
 // accessors to parse data from file
@@ -1755,9 +1793,8 @@ static void stbtt__fill_active_edges(unsigned char *scanline, int len, stbtt__ac
    }
 }
 
-static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e, int n, int vsubsample, int off_x, int off_y, void *userdata)
+static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e, int n, int vsubsample, int off_x, int off_y, stbtt__hheap *hh, void *userdata)
 {
-   stbtt__hheap hh = { 0, 0, 0 };
    stbtt__active_edge *active = NULL;
    int y,j=0;
    int max_weight = (255 / vsubsample);  // weight per vertical scanline
@@ -1787,7 +1824,7 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
                *step = z->next; // delete from list
                STBTT_assert(z->direction);
                z->direction = 0;
-               stbtt__hheap_free(&hh, z);
+               stbtt__hheap_free(hh, z);
             } else {
                z->x += z->dx; // advance to position for current scanline
                step = &((*step)->next); // advance through list
@@ -1816,7 +1853,7 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
          // insert all edges that start before the center of this scanline -- omit ones that also end on this scanline
          while (e->y0 <= scan_y) {
             if (e->y1 > scan_y) {
-               stbtt__active_edge *z = stbtt__new_active(&hh, e, off_x, scan_y, userdata);
+               stbtt__active_edge *z = stbtt__new_active(hh, e, off_x, scan_y, userdata);
                // find insertion point
                if (active == NULL)
                   active = z;
@@ -1847,7 +1884,12 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
       ++j;
    }
 
-   stbtt__hheap_cleanup(&hh, userdata);
+   // edges that outlive the bitmap go back to the heap, which may render more glyphs
+   while (active) {
+      stbtt__active_edge *z = active;
+      active = active->next;
+      stbtt__hheap_free(hh, z);
+   }
 
    if (scanline != scanline_data)
       STBTT_free(scanline, userdata);
@@ -2057,9 +2099,41 @@ static void stbtt__fill_active_edges_new(float *scanline, float *scanline_fill,
 }
 
 // directly AA rasterize edges w/o supersampling
-static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e, int n, int vsubsample, int off_x, int off_y, void *userdata)
+#ifdef STBTT__SSE2
+// the running sum and conversion at the end of each scanline, 16 pixels at a
+// time. the prefix sum is done in two shift-and-add steps per 4 floats, so
+// the additions happen in another order than in the C loop. returns how
+// many pixels it did, and the sum so far for the C loop to carry on with.
+static int stbtt__scanline_to_pixels_simd(unsigned char *out, float *scanline, float *scanline2, int len, float *sum)
+{
+   __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+   __m128 scale = _mm_set1_ps(255.0f);
+   __m128 half  = _mm_set1_ps(0.5f);
+   __m128 total = _mm_setzero_ps();
+   int i;
+   for (i=0; i+16 <= len; i += 16) {
+      __m128i m[4];
+      int k;
+      for (k=0; k < 4; ++k) {
+         __m128 d = _mm_loadu_ps(scanline2 + i + k*4);
+         __m128 c;
+         d = _mm_add_ps(d, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(d), 4)));
+         d = _mm_add_ps(d, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(d), 8)));
+         d = _mm_add_ps(d, total);
+         total = _mm_shuffle_ps(d, d, _MM_SHUFFLE(3,3,3,3));
+         c = _mm_and_ps(_mm_add_ps(_mm_loadu_ps(scanline + i + k*4), d), abs_mask);
+         c = _mm_min_ps(_mm_add_ps(_mm_mul_ps(c, scale), half), scale);
+         m[k] = _mm_cvttps_epi32(c);
+      }
+      _mm_storeu_si128((__m128i *) (out + i), _mm_packus_epi16(_mm_packs_epi32(m[0], m[1]), _mm_packs_epi32(m[2], m[3])));
+   }
+   *sum = _mm_cvtss_f32(total);
+   return i;
+}
+#endif
+
+static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e, int n, int vsubsample, int off_x, int off_y, stbtt__hheap *hh, void *userdata)
 {
-   stbtt__hheap hh = { 0, 0, 0 };
    stbtt__active_edge *active = NULL;
    int y,j=0, i;
    float scanline_data[129], *scanline, *scanline2;
@@ -2091,7 +2165,7 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
             *step = z->next; // delete from list
             STBTT_assert(z->direction);
             z->direction = 0;
-            stbtt__hheap_free(&hh, z);
+            stbtt__hheap_free(hh, z);
          } else {
             step = &((*step)->next); // advance through list
          }
@@ -2100,7 +2174,7 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
       // insert all edges that start before the bottom of this scanline
       while (e->y0 <= scan_y_bottom) {
          if (e->y0 != e->y1) {
-            stbtt__active_edge *z = stbtt__new_active(&hh, e, off_x, scan_y_top, userdata);
+            stbtt__active_edge *z = stbtt__new_active(hh, e, off_x, scan_y_top, userdata);
             STBTT_assert(z->ey >= scan_y_top);
             // insert at front
             z->next = active;
@@ -2115,7 +2189,11 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
 
       {
          float sum = 0;
-         for (i=0; i < result->w; ++i) {
+         i = 0;
+         #ifdef STBTT__SSE2
+         i = stbtt__scanline_to_pixels_simd(result->pixels + j*result->stride, scanline, scanline2, result->w, &sum);
+         #endif
+         for (; i < result->w; ++i) {
             float k;
             int m;
             sum += scanline2[i];
@@ -2138,7 +2216,12 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
       ++j;
    }
 
-   stbtt__hheap_cleanup(&hh, userdata);
+   // edges that outlive the bitmap go back to the heap, which may render more glyphs
+   while (active) {
+      stbtt__active_edge *z = active;
+      active = active->next;
+      stbtt__hheap_free(hh, z);
+   }
 
    if (scanline != scanline_data)
       STBTT_free(scanline, userdata);
@@ -2240,7 +2323,7 @@ typedef struct
    float x,y;
 } stbtt__point;
 
-static void stbtt__rasterize(stbtt__bitmap *result, stbtt__point *pts, int *wcount, int windings, float scale_x, float scale_y, float shift_x, float shift_y, int off_x, int off_y, int invert, void *userdata)
+static void stbtt__rasterize(stbtt__bitmap *result, stbtt__point *pts, int *wcount, int windings, float scale_x, float scale_y, float shift_x, float shift_y, int off_x, int off_y, int invert, stbtt__hheap *hh, void *userdata)
 {
    float y_scale_inv = invert ? -scale_y : scale_y;
    stbtt__edge *e;
@@ -2292,7 +2375,7 @@ static void stbtt__rasterize(stbtt__bitmap *result, stbtt__point *pts, int *wcou
    stbtt__sort_edges(e, n);
 
    // now, traverse the scanlines and find the intersections on each scanline, use xor winding rule
-   stbtt__rasterize_sorted_edges(result, e, n, vsubsample, off_x, off_y, userdata);
+   stbtt__rasterize_sorted_edges(result, e, n, vsubsample, off_x, off_y, hh, userdata);
 
    STBTT_free(e, userdata);
 }
@@ -2395,18 +2478,26 @@ error:
    return NULL;
 }
 
-STBTT_DEF void stbtt_Rasterize(stbtt__bitmap *result, float flatness_in_pixels, stbtt_vertex *vertices, int num_verts, float scale_x, float scale_y, float shift_x, float shift_y, int x_off, int y_off, int invert, void *userdata)
+// stbtt_Rasterize with the active edges allocated from hh, which the caller cleans up
+static void stbtt__rasterize_shape(stbtt__bitmap *result, float flatness_in_pixels, stbtt_vertex *vertices, int num_verts, float scale_x, float scale_y, float shift_x, float shift_y, int x_off, int y_off, int invert, stbtt__hheap *hh, void *userdata)
 {
    float scale = scale_x > scale_y ? scale_y : scale_x;
    int winding_count, *winding_lengths;
    stbtt__point *windings = stbtt_FlattenCurves(vertices, num_verts, flatness_in_pixels / scale, &winding_lengths, &winding_count, userdata);
    if (windings) {
-      stbtt__rasterize(result, windings, winding_lengths, winding_count, scale_x, scale_y, shift_x, shift_y, x_off, y_off, invert, userdata);
+      stbtt__rasterize(result, windings, winding_lengths, winding_count, scale_x, scale_y, shift_x, shift_y, x_off, y_off, invert, hh, userdata);
       STBTT_free(winding_lengths, userdata);
       STBTT_free(windings, userdata);
    }
 }
 
+STBTT_DEF void stbtt_Rasterize(stbtt__bitmap *result, float flatness_in_pixels, stbtt_vertex *vertices, int num_verts, float scale_x, float scale_y, float shift_x, float shift_y, int x_off, int y_off, int invert, void *userdata)
+{
+   stbtt__hheap hh = { 0, 0, 0 };
+   stbtt__rasterize_shape(result, flatness_in_pixels, vertices, num_verts, scale_x, scale_y, shift_x, shift_y, x_off, y_off, invert, &hh, userdata);
+   stbtt__hheap_cleanup(&hh, userdata);
+}
+
 STBTT_DEF void stbtt_FreeBitmap(unsigned char *bitmap, void *userdata)
 {
    STBTT_free(bitmap, userdata);
@@ -2454,7 +2545,7 @@ STBTT_DEF unsigned char *stbtt_GetGlyphBitmap(const stbtt_fontinfo *info, float
    return stbtt_GetGlyphBitmapSubpixel(info, scale_x, scale_y, 0.0f, 0.0f, glyph, width, height, xoff, yoff);
 }
 
-STBTT_DEF void stbtt_MakeGlyphBitmapSubpixel(const stbtt_fontinfo *info, unsigned char *output, int out_w, int out_h, int out_stride, float scale_x, float scale_y, float shift_x, float shift_y, int glyph)
+static void stbtt__make_glyph_bitmap(const stbtt_fontinfo *info, unsigned char *output, int out_w, int out_h, int out_stride, float scale_x, float scale_y, float shift_x, float shift_y, int glyph, stbtt__hheap *hh)
 {
    int ix0,iy0;
    stbtt_vertex *vertices;
@@ -2468,11 +2559,18 @@ STBTT_DEF void stbtt_MakeGlyphBitmapSubpixel(const stbtt_fontinfo *info, unsigne
    gbm.stride = out_stride;
 
    if (gbm.w && gbm.h)
-      stbtt_Rasterize(&gbm, 0.35f, vertices, num_verts, scale_x, scale_y, shift_x, shift_y, ix0,iy0, 1, info->userdata);
+      stbtt__rasterize_shape(&gbm, 0.35f, vertices, num_verts, scale_x, scale_y, shift_x, shift_y, ix0,iy0, 1, hh, info->userdata);
 
    STBTT_free(vertices, info->userdata);
 }
 
+STBTT_DEF void stbtt_MakeGlyphBitmapSubpixel(const stbtt_fontinfo *info, unsigned char *output, int out_w, int out_h, int out_stride, float scale_x, float scale_y, float shift_x, float shift_y, int glyph)
+{
+   stbtt__hheap hh = { 0, 0, 0 };
+   stbtt__make_glyph_bitmap(info, output, out_w, out_h, out_stride, scale_x, scale_y, shift_x, shift_y, glyph, &hh);
+   stbtt__hheap_cleanup(&hh, info->userdata);
+}
+
 STBTT_DEF void stbtt_MakeGlyphBitmap(const stbtt_fontinfo *info, unsigned char *output, int out_w, int out_h, int out_stride, float scale_x, float scale_y, int glyph)
 {
    stbtt_MakeGlyphBitmapSubpixel(info, output, out_w, out_h, out_stride, scale_x, scale_y, 0.0f,0.0f, glyph);
@@ -2674,6 +2772,7 @@ STBTT_DEF int stbtt_PackBegin(stbtt_pack_context *spc, unsigned char *pixels, in
    spc->stride_in_bytes = stride_in_bytes != 0 ? stride_in_bytes : pw;
    spc->h_oversample = 1;
    spc->v_oversample = 1;
+   spc->parallel = NULL;
 
    stbrp_init_target(context, pw-padding, ph-padding, nodes, num_nodes);
 
@@ -2689,6 +2788,11 @@ STBTT_DEF void stbtt_PackEnd  (stbtt_pack_context *spc)
    STBTT_free(spc->pack_info, spc->user_allocator_context);
 }
 
+STBTT_DEF void stbtt_PackSetParallel(stbtt_pack_context *spc, const stbtt_parallel *parallel)
+{
+   spc->parallel = parallel;
+}
+
 STBTT_DEF void stbtt_PackSetOversampling(stbtt_pack_context *spc, unsigned int h_oversample, unsigned int v_oversample)
 {
    STBTT_assert(h_oversample <= STBTT_MAX_OVERSAMPLE);
@@ -2701,11 +2805,71 @@ STBTT_DEF void stbtt_PackSetOversampling(stbtt_pack_context *spc, unsigned int h
 
 #define STBTT__OVER_MASK  (STBTT_MAX_OVERSAMPLE-1)
 
+#if defined(STBTT__SSE2) && STBTT_MAX_OVERSAMPLE <= 8
+// the divides below are a 16-bit multiply-high by 65536/kernel_width rounded
+// up, which is exact for kernel_width <= 8 and totals up to 8*255
+
+static void stbtt__h_prefilter_simd(unsigned char *pixels, int w, int h, int stride_in_bytes, unsigned int kernel_width)
+{
+   // each output is the mean of its input and the kernel_width-1 inputs to
+   // its left. going right to left, 8 at a time, those are still unchanged.
+   __m128i zero  = _mm_setzero_si128();
+   __m128i recip = _mm_set1_epi16((short) (65536 / kernel_width + 1));
+   int kw = (int) kernel_width;
+   int i,j,t;
+   for (j=0; j < h; ++j) {
+      for (i=w-8; i >= kw-1; i -= 8) {
+         __m128i total = zero;
+         for (t=0; t < kw; ++t)
+            total = _mm_add_epi16(total, _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (pixels + i - t)), zero));
+         _mm_storel_epi64((__m128i *) (pixels + i), _mm_packus_epi16(_mm_mulhi_epu16(total, recip), zero));
+      }
+      // the first columns, whose box starts left of the bitmap
+      for (i += 7; i >= 0; --i) {
+         unsigned int total = 0;
+         for (t=0; t < kw && t <= i; ++t)
+            total += pixels[i-t];
+         pixels[i] = (unsigned char) (total / kernel_width);
+      }
+      pixels += stride_in_bytes;
+   }
+}
+
+// returns how many columns it did, a multiple of 8
+static int stbtt__v_prefilter_simd(unsigned char *pixels, int w, int h, int stride_in_bytes, unsigned int kernel_width)
+{
+   // 8 columns at a time, top to bottom. the rows leaving the box have been
+   // overwritten by then, so the last 8 input rows are kept in a ring.
+   __m128i zero  = _mm_setzero_si128();
+   __m128i recip = _mm_set1_epi16((short) (65536 / kernel_width + 1));
+   __m128i ring[8];
+   int kw = (int) kernel_width;
+   int i,j,t;
+   for (j=0; j+8 <= w; j += 8) {
+      __m128i total = zero;
+      for (t=0; t < 8; ++t)
+         ring[t] = zero;
+      for (i=0; i < h; ++i) {
+         unsigned char *p = pixels + j + i*stride_in_bytes;
+         __m128i in = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) p), zero);
+         total = _mm_sub_epi16(_mm_add_epi16(total, in), ring[(i-kw) & 7]);
+         ring[i & 7] = in;
+         _mm_storel_epi64((__m128i *) p, _mm_packus_epi16(_mm_mulhi_epu16(total, recip), zero));
+      }
+   }
+   return j;
+}
+#endif
+
 static void stbtt__h_prefilter(unsigned char *pixels, int w, int h, int stride_in_bytes, unsigned int kernel_width)
 {
    unsigned char buffer[STBTT_MAX_OVERSAMPLE];
    int safe_w = w - kernel_width;
    int j;
+   #if defined(STBTT__SSE2) && STBTT_MAX_OVERSAMPLE <= 8
+   stbtt__h_prefilter_simd(pixels, w, h, stride_in_bytes, kernel_width);
+   return;
+   #endif
    for (j=0; j < h; ++j) {
       int i;
       unsigned int total;
@@ -2767,6 +2931,14 @@ static void stbtt__v_prefilter(unsigned char *pixels, int w, int h, int stride_i
    unsigned char buffer[STBTT_MAX_OVERSAMPLE];
    int safe_h = h - kernel_width;
    int j;
+   #if defined(STBTT__SSE2) && STBTT_MAX_OVERSAMPLE <= 8
+   {
+      // the columns left over go through the loop below
+      int done = stbtt__v_prefilter_simd(pixels, w, h, stride_in_bytes, kernel_width);
+      pixels += done;
+      w -= done;
+   }
+   #endif
    for (j=0; j < w; ++j) {
       int i;
       unsigned int total;
@@ -2864,28 +3036,26 @@ STBTT_DEF int stbtt_PackFontRangesGatherRects(stbtt_pack_context *spc, stbtt_fon
    return k;
 }
 
-// rects array must be big enough to accommodate all characters in the given ranges
-STBTT_DEF int stbtt_PackFontRangesRenderIntoRects(stbtt_pack_context *spc, stbtt_fontinfo *info, stbtt_pack_range *ranges, int num_ranges, stbrp_rect *rects)
+// renders every num_tasks'th rect, starting at the task'th, allocating active edges from hh
+static int stbtt__pack_render_rects(stbtt_pack_context *spc, stbtt_fontinfo *info, stbtt_pack_range *ranges, int num_ranges, stbrp_rect *rects, int task, int num_tasks, stbtt__hheap *hh)
 {
    int i,j,k, return_value = 1;
 
-   // save current values
-   int old_h_over = spc->h_oversample;
-   int old_v_over = spc->v_oversample;
-
    k = 0;
    for (i=0; i < num_ranges; ++i) {
       float fh = ranges[i].font_size;
       float scale = fh > 0 ? stbtt_ScaleForPixelHeight(info, fh) : stbtt_ScaleForMappingEmToPixels(info, -fh);
+      unsigned int h_oversample = ranges[i].h_oversample;
+      unsigned int v_oversample = ranges[i].v_oversample;
       float recip_h,recip_v,sub_x,sub_y;
-      spc->h_oversample = ranges[i].h_oversample;
-      spc->v_oversample = ranges[i].v_oversample;
-      recip_h = 1.0f / spc->h_oversample;
-      recip_v = 1.0f / spc->v_oversample;
-      sub_x = stbtt__oversample_shift(spc->h_oversample);
-      sub_y = stbtt__oversample_shift(spc->v_oversample);
-      for (j=0; j < ranges[i].num_chars; ++j) {
+      recip_h = 1.0f / h_oversample;
+      recip_v = 1.0f / v_oversample;
+      sub_x = stbtt__oversample_shift(h_oversample);
+      sub_y = stbtt__oversample_shift(v_oversample);
+      for (j=0; j < ranges[i].num_chars; ++j, ++k) {
          stbrp_rect *r = &rects[k];
+         if (k % num_tasks != task)
+            continue;
          if (r->was_packed) {
             stbtt_packedchar *bc = &ranges[i].chardata_for_range[j];
             int advance, lsb, x0,y0,x1,y1;
@@ -2900,28 +3070,28 @@ STBTT_DEF int stbtt_PackFontRangesRenderIntoRects(stbtt_pack_context *spc, stbtt
             r->h -= pad;
             stbtt_GetGlyphHMetrics(info, glyph, &advance, &lsb);
             stbtt_GetGlyphBitmapBox(info, glyph,
-                                    scale * spc->h_oversample,
-                                    scale * spc->v_oversample,
+                                    scale * h_oversample,
+                                    scale * v_oversample,
                                     &x0,&y0,&x1,&y1);
-            stbtt_MakeGlyphBitmapSubpixel(info,
-                                          spc->pixels + r->x + r->y*spc->stride_in_bytes,
-                                          r->w - spc->h_oversample+1,
-                                          r->h - spc->v_oversample+1,
-                                          spc->stride_in_bytes,
-                                          scale * spc->h_oversample,
-                                          scale * spc->v_oversample,
-                                          0,0,
-                                          glyph);
-
-            if (spc->h_oversample > 1)
+            stbtt__make_glyph_bitmap(info,
+                                     spc->pixels + r->x + r->y*spc->stride_in_bytes,
+                                     r->w - h_oversample+1,
+                                     r->h - v_oversample+1,
+                                     spc->stride_in_bytes,
+                                     scale * h_oversample,
+                                     scale * v_oversample,
+                                     0,0,
+                                     glyph, hh);
+
+            if (h_oversample > 1)
                stbtt__h_prefilter(spc->pixels + r->x + r->y*spc->stride_in_bytes,
                                   r->w, r->h, spc->stride_in_bytes,
-                                  spc->h_oversample);
+                                  h_oversample);
 
-            if (spc->v_oversample > 1)
+            if (v_oversample > 1)
                stbtt__v_prefilter(spc->pixels + r->x + r->y*spc->stride_in_bytes,
                                   r->w, r->h, spc->stride_in_bytes,
-                                  spc->v_oversample);
+                                  v_oversample);
 
             bc->x0       = (stbtt_int16)  r->x;
             bc->y0       = (stbtt_int16)  r->y;
@@ -2935,15 +3105,73 @@ STBTT_DEF int stbtt_PackFontRangesRenderIntoRects(stbtt_pack_context *spc, stbtt
          } else {
             return_value = 0; // if any fail, report failure
          }
-
-         ++k;
       }
    }
 
-   // restore original values
-   spc->h_oversample = old_h_over;
-   spc->v_oversample = old_v_over;
+   return return_value;
+}
+
+typedef struct
+{
+   stbtt__hheap hh;
+   int return_value;
+} stbtt__pack_worker;
+
+typedef struct
+{
+   stbtt_pack_context *spc;
+   stbtt_fontinfo *info;
+   stbtt_pack_range *ranges;
+   int num_ranges;
+   stbrp_rect *rects;
+   int num_tasks;
+   stbtt__pack_worker *workers;
+} stbtt__pack_job;
+
+static void stbtt__pack_render_task(void *task_data, int i)
+{
+   stbtt__pack_job *job = (stbtt__pack_job *) task_data;
+   stbtt__pack_worker *w = &job->workers[i];
+   w->return_value = stbtt__pack_render_rects(job->spc, job->info, job->ranges, job->num_ranges, job->rects, i, job->num_tasks, &w->hh);
+}
+
+// rects array must be big enough to accommodate all characters in the given ranges
+STBTT_DEF int stbtt_PackFontRangesRenderIntoRects(stbtt_pack_context *spc, stbtt_fontinfo *info, stbtt_pack_range *ranges, int num_ranges, stbrp_rect *rects)
+{
+   const stbtt_parallel *parallel = spc->parallel;
+   stbtt__hheap hh = { 0, 0, 0 };
+   int i, n = 0, return_value;
+
+   for (i=0; i < num_ranges; ++i)
+      n += ranges[i].num_chars;
+
+   if (parallel && parallel->num_threads > 1 && n > 1) {
+      // rects are dealt out round robin; neighbours in a range cost about the
+      // same, so every task gets a similar share of the work
+      stbtt__pack_job job;
+      job.spc = spc;
+      job.info = info;
+      job.ranges = ranges;
+      job.num_ranges = num_ranges;
+      job.rects = rects;
+      job.num_tasks = parallel->num_threads < n ? parallel->num_threads : n;
+      job.workers = (stbtt__pack_worker *) STBTT_malloc(sizeof(*job.workers) * job.num_tasks, info->userdata);
+      if (job.workers) {
+         STBTT_memset(job.workers, 0, sizeof(*job.workers) * job.num_tasks);
+         parallel->run(parallel->user, stbtt__pack_render_task, &job, job.num_tasks);
+         return_value = 1;
+         for (i=0; i < job.num_tasks; ++i) {
+            return_value &= job.workers[i].return_value;
+            stbtt__hheap_cleanup(&job.workers[i].hh, info->userdata);
+         }
+         STBTT_free(job.workers, info->userdata);
+         return return_value;
+      }
+      // out of memory for the workers; render here instead
+   }
 
+   return_value = stbtt__pack_render_rects(spc, info, ranges, num_ranges, rects, 0, 1, &hh);
+   stbtt__hheap_cleanup(&hh, info->userdata);
    return return_value;
 }
 
@@ -91,10 +91,8 @@ extern "C" {
 // can use a simpler allocation model: you pass in a buffer from
 // which stb_vorbis will allocate _all_ its memory (including the
 // temp memory). "open" may fail with a VORBIS_outofmem if you
-// do not pass in enough data; there is no way to determine how
-// much you do need except to succeed (at which point you can
-// query get_info to find the exact amount required. yes I know
-// this is lame).
+// do not pass in enough data; stb_vorbis_memory_required() below
+// tells you the exact amount for a given stream.
 //
 // If you pass in a non-NULL buffer of the type below, allocation
 // will occur from it as described above. Otherwise just pass NULL
@@ -106,6 +104,14 @@ typedef struct
    int   alloc_buffer_length_in_bytes;
 } stb_vorbis_alloc;
 
+extern int stb_vorbis_memory_required(const unsigned char *data, int len, int *error);
+// parses the headers of an ogg vorbis stream in memory (using malloc, which
+// is freed again) and returns the smallest alloc_buffer_length_in_bytes with
+// which stb_vorbis_open_memory() succeeds on it and decodes without any
+// further allocation. returns 0 and sets *error if the headers don't parse.
+// anything allocated after opening, like stb_vorbis_build_seek_table(),
+// needs more on top of this.
+
 
 ///////////   FUNCTIONS USEABLE WITH ALL INPUT MODES
 
@@ -143,6 +149,30 @@ extern int stb_vorbis_get_sample_offset(stb_vorbis *f);
 // of the memory buffer. In pushdata mode it returns 0.
 extern unsigned int stb_vorbis_get_file_offset(stb_vorbis *f);
 
+#ifdef STB_VORBIS_PROFILE
+// per-stage decode time (in STB_VORBIS_PROFILE_TICKS units, rdtsc by default)
+// and huffman lookup counts, accumulated since open or the last reset
+enum STBVorbisProfileStage
+{
+   STB_VORBIS_PROFILE_floor,     // floor curve decode and synthesis
+   STB_VORBIS_PROFILE_residue,   // residue decode: huffman plus VQ accumulation
+   STB_VORBIS_PROFILE_coupling,  // inverse channel coupling
+   STB_VORBIS_PROFILE_imdct,
+   STB_VORBIS_PROFILE_stages
+};
+
+typedef struct
+{
+   double ticks[STB_VORBIS_PROFILE_stages];
+   unsigned int huffman_fast;    // codewords found in the fast-huffman table
+   unsigned int huffman_pairs;   // codeword pairs found in the pair table
+   unsigned int huffman_slow;    // codewords that needed the binary/linear search
+} stb_vorbis_profile;
+
+extern stb_vorbis_profile stb_vorbis_get_profile(stb_vorbis *f);
+extern void stb_vorbis_reset_profile(stb_vorbis *f);
+#endif
+
 ///////////   PUSHDATA API
 
 #ifndef STB_VORBIS_NO_PUSHDATA_API
@@ -278,6 +308,35 @@ extern unsigned int stb_vorbis_stream_length_in_samples(stb_vorbis *f);
 extern float        stb_vorbis_stream_length_in_seconds(stb_vorbis *f);
 // these functions return the total length of the vorbis stream
 
+typedef struct
+{
+   unsigned int page_start;   // byte offset of an Ogg page in the stream
+   unsigned int sample;       // its granule position (last sample it finishes)
+} stb_vorbis_seek_entry;
+
+extern int stb_vorbis_build_seek_table(stb_vorbis *f);
+// reads every page header of the stream once and keeps a table of granule
+// positions and page offsets. seek_frame() and seek() then find their page
+// with a binary search in memory instead of probing the file, so a seek costs
+// the same few reads wherever it lands. this also finds the stream length.
+// returns the number of entries, or 0 on failure (in which case seeking
+// falls back to probing).
+
+extern int stb_vorbis_set_seek_table(stb_vorbis *f, const stb_vorbis_seek_entry *entries, int count);
+extern const stb_vorbis_seek_entry *stb_vorbis_get_seek_table(stb_vorbis *f, int *count);
+// install a table built earlier for the same stream (the entries are copied),
+// or get the current one (NULL if there is none). set returns 0 if the
+// entries are not in increasing order or point outside the stream.
+
+#ifndef STB_VORBIS_NO_STDIO
+extern int stb_vorbis_save_seek_table(stb_vorbis *f, const char *filename);
+extern int stb_vorbis_load_seek_table(stb_vorbis *f, const char *filename);
+// store the table in a small sidecar file, or load it from one, to skip the
+// scan in build_seek_table(). the sidecar records the length of the stream in
+// bytes and loading fails if that doesn't match, so a sidecar left over from
+// an older version of the file is not used.
+#endif
+
 extern int stb_vorbis_get_frame_float(stb_vorbis *f, int *channels, float ***output);
 // decode the next frame and return the number of samples. the number of
 // channels returned are stored in *channels (which can be NULL--it is always
@@ -446,6 +505,8 @@ enum STBVorbisError
 //     supported value is 24. with larger numbers, more decodings are O(1),
 //     but the table size is larger so worse cache missing, so you'll have
 //     to probe (and try multiple ogg vorbis files) to find the sweet spot.
+//     The bit reservoir is 64 bits wide, so any supported length can be
+//     looked up without an extra refill.
 #ifndef STB_VORBIS_FAST_HUFFMAN_LENGTH
 #define STB_VORBIS_FAST_HUFFMAN_LENGTH   10
 #endif
@@ -455,6 +516,21 @@ enum STBVorbisError
 //     is used in similar fashion to the fast-huffman size to set initial
 //     parameters for the binary search
 
+// STB_VORBIS_NO_HUFFMAN_PAIRS
+//     VQ codebooks get a second table, the same size as the fast-huffman
+//     table, that decodes two consecutive codewords at once when both fit
+//     in STB_VORBIS_FAST_HUFFMAN_LENGTH bits. Residue decode uses it while
+//     at least two vectors remain in a partition. Defining this symbol
+//     saves the memory (4 bytes per entry per VQ codebook).
+// #define STB_VORBIS_NO_HUFFMAN_PAIRS
+
+// STB_VORBIS_PROFILE
+//     time the decode stages (floor, residue, coupling, imdct) of every
+//     packet and count huffman lookups; read them back with
+//     stb_vorbis_get_profile(). STB_VORBIS_PROFILE_TICKS() can be defined
+//     to supply the timer; by default it's rdtsc on x86 and clock() elsewhere.
+// #define STB_VORBIS_PROFILE
+
 // STB_VORBIS_FAST_HUFFMAN_INT
 //     The fast huffman tables are much more efficient if they can be
 //     stored as 16-bit results instead of 32-bit results. This restricts
@@ -514,6 +590,13 @@ enum STBVorbisError
 //     you'd ever want to do it except for debugging.
 // #define STB_VORBIS_NO_DEFER_FLOOR
 
+// STB_VORBIS_NO_SIMD
+//     disables the SIMD versions of the inverse MDCT butterflies. SSE2 is
+//     used on x64 and on x86 builds that target SSE2, and AVX when the
+//     compiler targets it (e.g. /arch:AVX2 or -mavx2). As with stb_image,
+//     NEON must be requested explicitly by defining STB_VORBIS_NEON.
+// #define STB_VORBIS_NO_SIMD
+
 
 
 
@@ -524,6 +607,11 @@ enum STBVorbisError
    #define STB_VORBIS_NO_STDIO
 #endif
 
+#if defined(STB_VORBIS_DIVIDES_IN_CODEBOOK) && !defined(STB_VORBIS_NO_HUFFMAN_PAIRS)
+   // the pair table holds raw codeword indices, which this mode can't use directly
+   #define STB_VORBIS_NO_HUFFMAN_PAIRS
+#endif
+
 #if defined(STB_VORBIS_NO_CRT) && !defined(STB_VORBIS_NO_STDIO)
    #define STB_VORBIS_NO_STDIO 1
 #endif
@@ -568,6 +656,20 @@ enum STBVorbisError
    #endif
 #endif
 
+#ifndef STB_VORBIS_NO_SIMD
+   #if defined(__AVX__)
+      #define STB_VORBIS_AVX
+      #include <immintrin.h>
+   #elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+      #define STB_VORBIS_SSE2
+      #include <emmintrin.h>
+   #elif defined(STB_VORBIS_NEON)
+      #include <arm_neon.h>
+   #endif
+#else
+   #undef STB_VORBIS_NEON
+#endif
+
 #if STB_VORBIS_MAX_CHANNELS > 256
 #error "Value of STB_VORBIS_MAX_CHANNELS outside of allowed range"
 #endif
@@ -587,6 +689,11 @@ typedef unsigned short uint16;
 typedef   signed short  int16;
 typedef unsigned int   uint32;
 typedef   signed int    int32;
+#ifdef _MSC_VER
+typedef unsigned __int64 uint64;
+#else
+typedef unsigned long long uint64;
+#endif
 
 #ifndef TRUE
 #define TRUE 1
@@ -615,6 +722,20 @@ typedef uint16 codetype;
 #define FAST_HUFFMAN_TABLE_SIZE   (1 << STB_VORBIS_FAST_HUFFMAN_LENGTH)
 #define FAST_HUFFMAN_TABLE_MASK   (FAST_HUFFMAN_TABLE_SIZE - 1)
 
+#ifndef STB_VORBIS_NO_HUFFMAN_PAIRS
+// indexed like fast_huffman: the codeword following the one found in
+// fast_huffman, if both fit in the table bits
+typedef struct
+{
+   #ifdef STB_VORBIS_FAST_HUFFMAN_SHORT
+    int16  second;
+   #else
+    int32  second;
+   #endif
+   uint8   length;   // total length of both codewords; 0 if no pair
+} FastHuffmanPair;
+#endif
+
 typedef struct
 {
    int dimensions, entries;
@@ -633,6 +754,9 @@ typedef struct
    #else
     int32  fast_huffman[FAST_HUFFMAN_TABLE_SIZE];
    #endif
+   #ifndef STB_VORBIS_NO_HUFFMAN_PAIRS
+   FastHuffmanPair *fast_huffman_pair;
+   #endif
    uint32 *sorted_codewords;
    int    *sorted_values;
    int     sorted_entries;
@@ -749,10 +873,17 @@ struct stb_vorbis
 
    ProbedPage p_first, p_last;
 
+   stb_vorbis_seek_entry *seek_table;
+   int seek_table_count;
+
   // memory management
    stb_vorbis_alloc alloc;
    int setup_offset;
    int temp_offset;
+   // what setup_offset and temp_offset would be without a buffer, and the
+   // most alloc_buffer would have held at once; for stb_vorbis_memory_required
+   int malloc_temp_in_use;
+   unsigned int alloc_high_water;
 
   // run-time results
    int eof;
@@ -812,7 +943,7 @@ struct stb_vorbis
    int next_seg;
    int last_seg;  // flag that we're on the last segment
    int last_seg_which; // what was the segment number of the last seg?
-   uint32 acc;
+   uint64 acc;
    int valid_bits;
    int packet_bytes;
    int end_seg_with_known_loc;
@@ -820,6 +951,12 @@ struct stb_vorbis
    int discard_samples_deferred;
    uint32 samples_output;
 
+#ifdef STB_VORBIS_PROFILE
+   stb_vorbis_profile profile;
+   int profile_stage; // -1 outside of packet decode
+   uint64 profile_start;
+#endif
+
   // push mode scanning
    int page_crc_tests; // only in push_mode: number of tests active; -1 if not searching
 #ifndef STB_VORBIS_NO_PUSHDATA_API
@@ -838,6 +975,38 @@ extern int my_prof(int slot);
 #define stb_prof(x)  ((void) 0)
 #endif
 
+#ifdef STB_VORBIS_PROFILE
+   #ifndef STB_VORBIS_PROFILE_TICKS
+      #if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+         #include <intrin.h>
+         #define STB_VORBIS_PROFILE_TICKS()  __rdtsc()
+      #elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+         #include <x86intrin.h>
+         #define STB_VORBIS_PROFILE_TICKS()  __rdtsc()
+      #else
+         #include <time.h>
+         #define STB_VORBIS_PROFILE_TICKS()  clock()
+      #endif
+   #endif
+
+static void profile_stage(struct stb_vorbis *f, int stage)
+{
+   uint64 now = (uint64) STB_VORBIS_PROFILE_TICKS();
+   if (f->profile_stage >= 0)
+      f->profile.ticks[f->profile_stage] += (double) (now - f->profile_start);
+   f->profile_stage = stage;
+   f->profile_start = now;
+}
+
+   #define stb_stage(f,s)    profile_stage(f, STB_VORBIS_PROFILE_##s)
+   #define stb_stage_end(f)  profile_stage(f, -1)
+   #define stb_count(f,x)    (++(f)->profile.x)
+#else
+   #define stb_stage(f,s)    ((void) 0)
+   #define stb_stage_end(f)  ((void) 0)
+   #define stb_count(f,x)    ((void) 0)
+#endif
+
 #if defined(STB_VORBIS_NO_PUSHDATA_API)
    #define IS_PUSH_MODE(f)   FALSE
 #elif defined(STB_VORBIS_NO_PULLDATA_API)
@@ -889,10 +1058,18 @@ static void *make_block_array(void *mem, int count, int size)
    return p;
 }
 
+static void track_alloc_high_water(vorb *f)
+{
+   unsigned int in_use = f->setup_memory_required + f->malloc_temp_in_use;
+   if (in_use > f->alloc_high_water)
+      f->alloc_high_water = in_use;
+}
+
 static void *setup_malloc(vorb *f, int sz)
 {
    sz = (sz+3) & ~3;
    f->setup_memory_required += sz;
+   track_alloc_high_water(f);
    if (f->alloc.alloc_buffer) {
       void *p = (char *) f->alloc.alloc_buffer + f->setup_offset;
       if (f->setup_offset + sz > f->temp_offset) return NULL;
@@ -916,6 +1093,8 @@ static void *setup_temp_malloc(vorb *f, int sz)
       f->temp_offset -= sz;
       return (char *) f->alloc.alloc_buffer + f->temp_offset;
    }
+   f->malloc_temp_in_use += sz;
+   track_alloc_high_water(f);
    return malloc(sz);
 }
 
@@ -925,6 +1104,7 @@ static void setup_temp_free(vorb *f, void *p, int sz)
       f->temp_offset += (sz+3)&~3;
       return;
    }
+   f->malloc_temp_in_use -= (sz+3)&~3;
    free(p);
 }
 
@@ -1092,6 +1272,26 @@ static void compute_accelerated_huffman(Codebook *c)
    }
 }
 
+#ifndef STB_VORBIS_NO_HUFFMAN_PAIRS
+// for every fast-huffman entry, find the codeword that follows it in the
+// remaining table bits, if any
+static void compute_huffman_pairs(Codebook *c)
+{
+   int i;
+   for (i=0; i < FAST_HUFFMAN_TABLE_SIZE; ++i) {
+      int first = c->fast_huffman[i], second, len;
+      c->fast_huffman_pair[i].length = 0;
+      if (first < 0) continue;
+      len = c->codeword_lengths[first];
+      second = c->fast_huffman[i >> len];
+      if (second >= 0 && len + c->codeword_lengths[second] <= STB_VORBIS_FAST_HUFFMAN_LENGTH) {
+         c->fast_huffman_pair[i].second = second;
+         c->fast_huffman_pair[i].length = (uint8) (len + c->codeword_lengths[second]);
+      }
+   }
+}
+#endif
+
 #ifdef _MSC_VER
 #define STBV_CDECL __cdecl
 #else
@@ -1542,12 +1742,12 @@ static uint32 get_bits(vorb *f, int n)
             f->valid_bits = INVALID_BITS;
             return 0;
          }
-         f->acc += z << f->valid_bits;
+         f->acc += (uint64) z << f->valid_bits;
          f->valid_bits += 8;
       }
    }
    if (f->valid_bits < 0) return 0;
-   z = f->acc & ((1 << n)-1);
+   z = (uint32) (f->acc & ((1 << n)-1));
    f->acc >>= n;
    f->valid_bits -= n;
    return z;
@@ -1557,18 +1757,19 @@ static uint32 get_bits(vorb *f, int n)
 // expand the buffer to as many bits as possible without reading off end of packet
 // it might be nice to allow f->valid_bits and f->acc to be stored in registers,
 // e.g. cache them locally and decode locally
+// the accumulator is 64 bits, so one refill covers several short codewords
 static __forceinline void prep_huffman(vorb *f)
 {
-   if (f->valid_bits <= 24) {
+   if (f->valid_bits <= 56) {
       if (f->valid_bits == 0) f->acc = 0;
       do {
          int z;
          if (f->last_seg && !f->bytes_in_seg) return;
          z = get8_packet_raw(f);
          if (z == EOP) return;
-         f->acc += (unsigned) z << f->valid_bits;
+         f->acc += (uint64) z << f->valid_bits;
          f->valid_bits += 8;
-      } while (f->valid_bits <= 24);
+      } while (f->valid_bits <= 56);
    }
 }
 
@@ -1583,13 +1784,14 @@ static int codebook_decode_scalar_raw(vorb *f, Codebook *c)
 {
    int i;
    prep_huffman(f);
+   stb_count(f, huffman_slow);
 
    assert(c->sorted_codewords || c->codewords);
    // cases to use binary search: sorted_codewords && !c->codewords
    //                             sorted_codewords && c->entries > 8
    if (c->entries > 8 ? c->sorted_codewords!=NULL : !c->codewords) {
       // binary search
-      uint32 code = bit_reverse(f->acc);
+      uint32 code = bit_reverse((uint32) f->acc);
       int x=0, n=c->sorted_entries, len;
 
       while (n > 1) {
@@ -1641,13 +1843,14 @@ static int codebook_decode_scalar_raw(vorb *f, Codebook *c)
 #define DECODE_RAW(var, f,c)                                  \
    if (f->valid_bits < STB_VORBIS_FAST_HUFFMAN_LENGTH)        \
       prep_huffman(f);                                        \
-   var = f->acc & FAST_HUFFMAN_TABLE_MASK;                    \
+   var = (int) (f->acc & FAST_HUFFMAN_TABLE_MASK);            \
    var = c->fast_huffman[var];                                \
    if (var >= 0) {                                            \
       int n = c->codeword_lengths[var];                       \
       f->acc >>= n;                                           \
       f->valid_bits -= n;                                     \
       if (f->valid_bits < 0) { f->valid_bits = 0; var = -1; } \
+      stb_count(f, huffman_fast);                             \
    } else {                                                   \
       var = codebook_decode_scalar_raw(f,c);                  \
    }
@@ -1660,12 +1863,13 @@ static int codebook_decode_scalar(vorb *f, Codebook *c)
    if (f->valid_bits < STB_VORBIS_FAST_HUFFMAN_LENGTH)
       prep_huffman(f);
    // fast huffman table lookup
-   i = f->acc & FAST_HUFFMAN_TABLE_MASK;
+   i = (int) (f->acc & FAST_HUFFMAN_TABLE_MASK);
    i = c->fast_huffman[i];
    if (i >= 0) {
       f->acc >>= c->codeword_lengths[i];
       f->valid_bits -= c->codeword_lengths[i];
       if (f->valid_bits < 0) { f->valid_bits = 0; return -1; }
+      stb_count(f, huffman_fast);
       return i;
    }
    return codebook_decode_scalar_raw(f,c);
@@ -1685,6 +1889,29 @@ static int codebook_decode_scalar(vorb *f, Codebook *c)
   #define DECODE_VQ(var,f,c)   DECODE(var,f,c)
 #endif
 
+#ifndef STB_VORBIS_NO_HUFFMAN_PAIRS
+// decode two VQ codewords with a single lookup if they're both short;
+// otherwise decode one as DECODE_VQ does and set var2 to -1. only use
+// this when the caller is certain to consume the second codeword next.
+#define DECODE_VQ_PAIR(var,var2,f,c)                          \
+   if (f->valid_bits < STB_VORBIS_FAST_HUFFMAN_LENGTH)        \
+      prep_huffman(f);                                        \
+   {                                                          \
+      int k = (int) (f->acc & FAST_HUFFMAN_TABLE_MASK);       \
+      int n = c->fast_huffman_pair[k].length;                 \
+      if (n && n <= f->valid_bits) {                          \
+         var  = c->fast_huffman[k];                           \
+         var2 = c->fast_huffman_pair[k].second;               \
+         f->acc >>= n;                                        \
+         f->valid_bits -= n;                                  \
+         stb_count(f, huffman_pairs);                         \
+      } else {                                                \
+         var2 = -1;                                           \
+         DECODE_VQ(var,f,c);                                  \
+      }                                                       \
+   }
+#endif
+
 
 
 
@@ -1797,13 +2024,27 @@ static int codebook_decode_deinterleave_repeat(vorb *f, Codebook *c, float **out
    int c_inter = *c_inter_p;
    int p_inter = *p_inter_p;
    int i,z, effective = c->dimensions;
+   #ifndef STB_VORBIS_NO_HUFFMAN_PAIRS
+   int z2 = -1;
+   #endif
 
    // type 0 is only legal in a scalar context
    if (c->lookup_type == 0)   return error(f, VORBIS_invalid_stream);
 
    while (total_decode > 0) {
       float last = CODEBOOK_ELEMENT_BASE(c);
-      DECODE_VQ(z,f,c);
+      #ifndef STB_VORBIS_NO_HUFFMAN_PAIRS
+      if (z2 >= 0) {
+         z = z2;
+         z2 = -1;
+      } else if (total_decode > c->dimensions) {
+         // at least one more vector follows this one
+         DECODE_VQ_PAIR(z,z2,f,c);
+      } else
+      #endif
+      {
+         DECODE_VQ(z,f,c);
+      }
       #ifndef STB_VORBIS_DIVIDES_IN_CODEBOOK
       assert(!c->sparse || z < c->sorted_entries);
       #endif
@@ -1868,13 +2109,27 @@ static int codebook_decode_deinterleave_repeat_2(vorb *f, Codebook *c, float **o
    int c_inter = *c_inter_p;
    int p_inter = *p_inter_p;
    int i,z, effective = c->dimensions;
+   #ifndef STB_VORBIS_NO_HUFFMAN_PAIRS
+   int z2 = -1;
+   #endif
 
    // type 0 is only legal in a scalar context
    if (c->lookup_type == 0)   return error(f, VORBIS_invalid_stream);
 
    while (total_decode > 0) {
       float last = CODEBOOK_ELEMENT_BASE(c);
-      DECODE_VQ(z,f,c);
+      #ifndef STB_VORBIS_NO_HUFFMAN_PAIRS
+      if (z2 >= 0) {
+         z = z2;
+         z2 = -1;
+      } else if (total_decode > c->dimensions) {
+         // at least one more vector follows this one
+         DECODE_VQ_PAIR(z,z2,f,c);
+      } else
+      #endif
+      {
+         DECODE_VQ(z,f,c);
+      }
 
       if (z < 0) {
          if (!f->bytes_in_seg)
@@ -2449,6 +2704,103 @@ void inverse_mdct(float *buffer, int n, vorb *f, int blocktype)
 #endif
 
 
+#if defined(STB_VORBIS_AVX) || defined(STB_VORBIS_SSE2) || defined(STB_VORBIS_NEON)
+// SIMD step 3 butterflies. Every step 3 loop below works on runs of four
+// (re,im) pairs stored downwards from e0 and e2:
+//
+//    e0[-2p-1..-2p] += e2[-2p-1..-2p]
+//    e2[-2p-1..-2p]  = (e0 - e2) rotated by twiddle p
+//
+// which is two 4-wide or one 8-wide operation. Twiddle p is (A[p*k1], A[p*k1+1]).
+// In memory order lane 2j holds the 'k01' term and lane 2j+1 the 'k00' term of
+// a pair, so the complex multiply is d*aa + swap_pairs(d)*ab, with ab holding
+// +sin in the even lanes and -sin in the odd ones.
+#define STB_VORBIS_SIMD_IMDCT
+
+#if defined(STB_VORBIS_AVX)
+typedef struct { __m256 aa, ab; } imdct_twiddle4;
+
+static __forceinline imdct_twiddle4 imdct_load_twiddles(float *A, int k1)
+{
+   imdct_twiddle4 t;
+   float *A1 = A+k1, *A2 = A+k1*2, *A3 = A+k1*3;
+   t.aa = _mm256_set_ps( A[0], A[0], A1[0], A1[0], A2[0], A2[0], A3[0], A3[0]);
+   t.ab = _mm256_set_ps(-A[1], A[1],-A1[1], A1[1],-A2[1], A2[1],-A3[1], A3[1]);
+   return t;
+}
+
+static __forceinline void imdct_butterfly4(float *e0, float *e2, imdct_twiddle4 t)
+{
+   __m256 x = _mm256_loadu_ps(e0-7);
+   __m256 y = _mm256_loadu_ps(e2-7);
+   __m256 d = _mm256_sub_ps(x, y);
+   __m256 s = _mm256_permute_ps(d, _MM_SHUFFLE(2,3,0,1));
+   _mm256_storeu_ps(e0-7, _mm256_add_ps(x, y));
+   _mm256_storeu_ps(e2-7, _mm256_add_ps(_mm256_mul_ps(d, t.aa), _mm256_mul_ps(s, t.ab)));
+}
+#elif defined(STB_VORBIS_SSE2)
+typedef struct { __m128 aa01, ab01, aa23, ab23; } imdct_twiddle4;
+
+static __forceinline imdct_twiddle4 imdct_load_twiddles(float *A, int k1)
+{
+   imdct_twiddle4 t;
+   float *A1 = A+k1, *A2 = A+k1*2, *A3 = A+k1*3;
+   t.aa01 = _mm_set_ps( A[0],  A[0], A1[0], A1[0]);
+   t.ab01 = _mm_set_ps(-A[1],  A[1],-A1[1], A1[1]);
+   t.aa23 = _mm_set_ps( A2[0], A2[0], A3[0], A3[0]);
+   t.ab23 = _mm_set_ps(-A2[1], A2[1],-A3[1], A3[1]);
+   return t;
+}
+
+static __forceinline void imdct_butterfly2_sse2(float *e0, float *e2, __m128 aa, __m128 ab)
+{
+   __m128 x = _mm_loadu_ps(e0-3);
+   __m128 y = _mm_loadu_ps(e2-3);
+   __m128 d = _mm_sub_ps(x, y);
+   __m128 s = _mm_shuffle_ps(d, d, _MM_SHUFFLE(2,3,0,1));
+   _mm_storeu_ps(e0-3, _mm_add_ps(x, y));
+   _mm_storeu_ps(e2-3, _mm_add_ps(_mm_mul_ps(d, aa), _mm_mul_ps(s, ab)));
+}
+
+static __forceinline void imdct_butterfly4(float *e0, float *e2, imdct_twiddle4 t)
+{
+   imdct_butterfly2_sse2(e0  , e2  , t.aa01, t.ab01);
+   imdct_butterfly2_sse2(e0-4, e2-4, t.aa23, t.ab23);
+}
+#else // STB_VORBIS_NEON
+typedef struct { float32x4_t aa01, ab01, aa23, ab23; } imdct_twiddle4;
+
+static __forceinline imdct_twiddle4 imdct_load_twiddles(float *A, int k1)
+{
+   imdct_twiddle4 t;
+   float *A1 = A+k1, *A2 = A+k1*2, *A3 = A+k1*3;
+   float aa01[4] = { A1[0], A1[0], A[0], A[0] }, ab01[4] = { A1[1], -A1[1], A[1], -A[1] };
+   float aa23[4] = { A3[0], A3[0], A2[0], A2[0] }, ab23[4] = { A3[1], -A3[1], A2[1], -A2[1] };
+   t.aa01 = vld1q_f32(aa01);
+   t.ab01 = vld1q_f32(ab01);
+   t.aa23 = vld1q_f32(aa23);
+   t.ab23 = vld1q_f32(ab23);
+   return t;
+}
+
+static __forceinline void imdct_butterfly2_neon(float *e0, float *e2, float32x4_t aa, float32x4_t ab)
+{
+   float32x4_t x = vld1q_f32(e0-3);
+   float32x4_t y = vld1q_f32(e2-3);
+   float32x4_t d = vsubq_f32(x, y);
+   float32x4_t s = vrev64q_f32(d);
+   vst1q_f32(e0-3, vaddq_f32(x, y));
+   vst1q_f32(e2-3, vaddq_f32(vmulq_f32(d, aa), vmulq_f32(s, ab)));
+}
+
+static __forceinline void imdct_butterfly4(float *e0, float *e2, imdct_twiddle4 t)
+{
+   imdct_butterfly2_neon(e0  , e2  , t.aa01, t.ab01);
+   imdct_butterfly2_neon(e0-4, e2-4, t.aa23, t.ab23);
+}
+#endif
+#endif // SIMD
+
 // the following were split out into separate functions while optimizing;
 // they could be pushed back up but eh. __forceinline showed no change;
 // they're probably already being inlined.
@@ -2459,6 +2811,14 @@ static void imdct_step3_iter0_loop(int n, float *e, int i_off, int k_off, float
    int i;
 
    assert((n & 3) == 0);
+   #ifdef STB_VORBIS_SIMD_IMDCT
+   for (i=(n>>2); i > 0; --i) {
+      imdct_butterfly4(ee0, ee2, imdct_load_twiddles(A, 8));
+      A += 32;
+      ee0 -= 8;
+      ee2 -= 8;
+   }
+   #else
    for (i=(n>>2); i > 0; --i) {
       float k00_20, k01_21;
       k00_20  = ee0[ 0] - ee2[ 0];
@@ -2495,16 +2855,27 @@ static void imdct_step3_iter0_loop(int n, float *e, int i_off, int k_off, float
       ee0 -= 8;
       ee2 -= 8;
    }
+   #endif
 }
 
 static void imdct_step3_inner_r_loop(int lim, float *e, int d0, int k_off, float *A, int k1)
 {
    int i;
+   #ifndef STB_VORBIS_SIMD_IMDCT
    float k00_20, k01_21;
+   #endif
 
    float *e0 = e + d0;
    float *e2 = e0 + k_off;
 
+   #ifdef STB_VORBIS_SIMD_IMDCT
+   for (i=lim >> 2; i > 0; --i) {
+      imdct_butterfly4(e0, e2, imdct_load_twiddles(A, k1));
+      A += k1*4;
+      e0 -= 8;
+      e2 -= 8;
+   }
+   #else
    for (i=lim >> 2; i > 0; --i) {
       k00_20 = e0[-0] - e2[-0];
       k01_21 = e0[-1] - e2[-1];
@@ -2545,11 +2916,15 @@ static void imdct_step3_inner_r_loop(int lim, float *e, int d0, int k_off, float
 
       A += k1;
    }
+   #endif
 }
 
 static void imdct_step3_inner_s_loop(int n, float *e, int i_off, int k_off, float *A, int a_off, int k0)
 {
    int i;
+   #ifdef STB_VORBIS_SIMD_IMDCT
+   imdct_twiddle4 t = imdct_load_twiddles(A, a_off);
+   #else
    float A0 = A[0];
    float A1 = A[0+1];
    float A2 = A[0+a_off];
@@ -2560,10 +2935,18 @@ static void imdct_step3_inner_s_loop(int n, float *e, int i_off, int k_off, floa
    float A7 = A[0+a_off*3+1];
 
    float k00,k11;
+   #endif
 
    float *ee0 = e  +i_off;
    float *ee2 = ee0+k_off;
 
+   #ifdef STB_VORBIS_SIMD_IMDCT
+   for (i=n; i > 0; --i) {
+      imdct_butterfly4(ee0, ee2, t);
+      ee0 -= k0;
+      ee2 -= k0;
+   }
+   #else
    for (i=n; i > 0; --i) {
       k00     = ee0[ 0] - ee2[ 0];
       k11     = ee0[-1] - ee2[-1];
@@ -2596,6 +2979,7 @@ static void imdct_step3_inner_s_loop(int n, float *e, int i_off, int k_off, floa
       ee0 -= k0;
       ee2 -= k0;
    }
+   #endif
 }
 
 static __forceinline void iter_54(float *z)
@@ -3236,11 +3620,13 @@ static int vorbis_decode_packet_rest(vorb *f, int *len, Mode *m, int left_start,
    n2 = n >> 1;
 
    stb_prof(1);
+   stb_stage(f, floor);
    for (i=0; i < f->channels; ++i) {
       int s = map->chan[i].mux, floor;
       zero_channel[i] = FALSE;
       floor = map->submap_floor[s];
       if (f->floor_types[floor] == 0) {
+         stb_stage_end(f);
          return error(f, VORBIS_invalid_stream);
       } else {
          Floor1 *g = &f->floor_config[floor].floor1;
@@ -3341,6 +3727,7 @@ static int vorbis_decode_packet_rest(vorb *f, int *len, Mode *m, int left_start,
       }
 
 // RESIDUE DECODE
+   stb_stage(f, residue);
    for (i=0; i < map->submaps; ++i) {
       float *residue_buffers[STB_VORBIS_MAX_CHANNELS];
       int r;
@@ -3367,6 +3754,7 @@ static int vorbis_decode_packet_rest(vorb *f, int *len, Mode *m, int left_start,
 
 // INVERSE COUPLING
    stb_prof(14);
+   stb_stage(f, coupling);
    for (i = map->coupling_steps-1; i >= 0; --i) {
       int n2 = n >> 1;
       float *m = f->channel_buffers[map->chan[i].magnitude];
@@ -3389,6 +3777,7 @@ static int vorbis_decode_packet_rest(vorb *f, int *len, Mode *m, int left_start,
    }
 
    // finish decoding the floors
+   stb_stage(f, floor);
 #ifndef STB_VORBIS_NO_DEFER_FLOOR
    stb_prof(15);
    for (i=0; i < f->channels; ++i) {
@@ -3411,9 +3800,11 @@ static int vorbis_decode_packet_rest(vorb *f, int *len, Mode *m, int left_start,
 
 // INVERSE MDCT
    stb_prof(16);
+   stb_stage(f, imdct);
    for (i=0; i < f->channels; ++i)
       inverse_mdct(f->channel_buffers[i], n, f, m->blockflag);
    stb_prof(0);
+   stb_stage_end(f);
 
    // this shouldn't be necessary, unless we exited on an error
    // and want to flush to get to the next packet
@@ -3817,6 +4208,13 @@ static int start_decoder(vorb *f)
 
       c->lookup_type = get_bits(f, 4);
       if (c->lookup_type > 2) return error(f, VORBIS_invalid_setup);
+      #ifndef STB_VORBIS_NO_HUFFMAN_PAIRS
+      if (c->lookup_type > 0) {
+         c->fast_huffman_pair = (FastHuffmanPair *) setup_malloc(f, sizeof(*c->fast_huffman_pair) * FAST_HUFFMAN_TABLE_SIZE);
+         if (c->fast_huffman_pair == NULL) return error(f, VORBIS_outofmem);
+         compute_huffman_pairs(c);
+      }
+      #endif
       if (c->lookup_type > 0) {
          uint16 *mults;
          c->minimum_value = float32_unpack(get_bits(f, 32));
@@ -4177,6 +4575,9 @@ static void vorbis_deinit(stb_vorbis *p)
          setup_free(p, c->multiplicands);
          setup_free(p, c->codewords);
          setup_free(p, c->sorted_codewords);
+         #ifndef STB_VORBIS_NO_HUFFMAN_PAIRS
+         setup_free(p, c->fast_huffman_pair);
+         #endif
          // c->sorted_values[-1] is the first entry in the array
          setup_free(p, c->sorted_values ? c->sorted_values-1 : NULL);
       }
@@ -4204,6 +4605,7 @@ static void vorbis_deinit(stb_vorbis *p)
       setup_free(p, p->window[i]);
       setup_free(p, p->bit_reverse[i]);
    }
+   setup_free(p, p->seek_table);
    #ifndef STB_VORBIS_NO_STDIO
    if (p->close_on_free) fclose(p->f);
    #endif
@@ -4229,6 +4631,9 @@ static void vorbis_init(stb_vorbis *p, stb_vorbis_alloc *z)
    p->stream = NULL;
    p->codebooks = NULL;
    p->page_crc_tests = -1;
+   #ifdef STB_VORBIS_PROFILE
+   p->profile_stage = -1;
+   #endif
    #ifndef STB_VORBIS_NO_STDIO
    p->close_on_free = FALSE;
    p->f = NULL;
@@ -4262,6 +4667,18 @@ int stb_vorbis_get_error(stb_vorbis *f)
    return e;
 }
 
+#ifdef STB_VORBIS_PROFILE
+stb_vorbis_profile stb_vorbis_get_profile(stb_vorbis *f)
+{
+   return f->profile;
+}
+
+void stb_vorbis_reset_profile(stb_vorbis *f)
+{
+   memset(&f->profile, 0, sizeof(f->profile));
+}
+#endif
+
 static stb_vorbis * vorbis_alloc(stb_vorbis *f)
 {
    stb_vorbis *p = (stb_vorbis *) setup_malloc(f, sizeof(*p));
@@ -4650,6 +5067,24 @@ static int seek_to_sample_coarse(stb_vorbis *f, uint32 sample_number)
    else
       sample_number -= padding;
 
+   if (f->seek_table) {
+      // the last page that finishes at or before the target
+      int lo = 0, hi = f->seek_table_count;
+      if (sample_number <= f->seek_table[0].sample) {
+         stb_vorbis_seek_start(f);
+         return 1;
+      }
+      while (hi - lo > 1) {
+         int m = (lo + hi) >> 1;
+         if (sample_number < f->seek_table[m].sample)
+            hi = m;
+         else
+            lo = m;
+      }
+      page_start = f->seek_table[lo].page_start;
+      goto found_page;
+   }
+
    left = f->p_first;
    while (left.last_decoded_sample == ~0U) {
       // (untested) the first page does not have a 'last_decoded_sample'
@@ -4727,6 +5162,7 @@ static int seek_to_sample_coarse(stb_vorbis *f, uint32 sample_number)
 
    // seek back to start of the last packet
    page_start = left.page_start;
+  found_page:
    set_file_offset(f, page_start);
    if (!start_page(f)) return error(f, VORBIS_seek_failed);
    end_pos = f->end_seg_with_known_loc;
@@ -4833,8 +5269,9 @@ int stb_vorbis_seek_frame(stb_vorbis *f, unsigned int sample_number)
          flush_packet(f);
       }
    }
-   // the next frame will start with the sample
-   assert(f->current_loc == sample_number);
+   // the next frame will start with the sample, unless the frame we pumped
+   // resynced to a page granule that jumps past it
+   if (f->current_loc != sample_number) return error(f, VORBIS_seek_failed);
    return 1;
 }
 
@@ -4945,6 +5382,169 @@ float stb_vorbis_stream_length_in_seconds(stb_vorbis *f)
    return stb_vorbis_stream_length_in_samples(f) / (float) f->sample_rate;
 }
 
+// walk the page headers from the first audio page to the last page, storing
+// the pages that have a granule position; returns the count, or -1 if the
+// chain of pages breaks. with table == NULL, it only counts.
+static int scan_seek_table(stb_vorbis *f, stb_vorbis_seek_entry *table)
+{
+   uint8 header[27], lacing[255];
+   uint32 page_start = f->first_audio_page_offset;
+   int i, len, count = 0;
+
+   for (;;) {
+      uint32 lo, hi;
+      if (!set_file_offset(f, page_start))                  return -1;
+      if (!getn(f, header, 27))                             return -1;
+      if (memcmp(header, ogg_page_header, 4))               return -1;
+      if (!getn(f, lacing, header[26]))                     return -1;
+      len = 0;
+      for (i=0; i < header[26]; ++i)
+         len += lacing[i];
+
+      lo = header[6] + (header[7] << 8) + (header[8] << 16) + ((uint32) header[9] << 24);
+      hi = header[10] + (header[11] << 8) + (header[12] << 16) + ((uint32) header[13] << 24);
+      if (lo != 0xffffffff || hi != 0xffffffff) {
+         if (hi) lo = 0xfffffffe; // saturate
+         if (table) {
+            table[count].page_start = page_start;
+            table[count].sample     = lo;
+         }
+         ++count;
+      }
+      if (header[5] & PAGEFLAG_last_page)
+         return count;
+      page_start += 27 + header[26] + len;
+   }
+}
+
+// takes ownership of table, which must be from setup_malloc
+static void install_seek_table(stb_vorbis *f, stb_vorbis_seek_entry *table, int count)
+{
+   setup_free(f, f->seek_table);
+   f->seek_table = table;
+   f->seek_table_count = count;
+   // the last entry is the last page, which is what stream_length reads
+   f->total_samples = table[count-1].sample;
+}
+
+int stb_vorbis_build_seek_table(stb_vorbis *f)
+{
+   unsigned int restore_offset;
+   stb_vorbis_seek_entry *table = NULL;
+   int count;
+
+   if (IS_PUSH_MODE(f)) return error(f, VORBIS_invalid_api_mixing);
+   restore_offset = stb_vorbis_get_file_offset(f);
+
+   count = scan_seek_table(f, NULL);
+   if (count > 0)
+      table = (stb_vorbis_seek_entry *) setup_malloc(f, sizeof(*table) * count);
+   if (table && scan_seek_table(f, table) == count)
+      install_seek_table(f, table, count);
+   else {
+      setup_free(f, table);
+      count = 0;
+   }
+
+   set_file_offset(f, restore_offset);
+   return count;
+}
+
+int stb_vorbis_set_seek_table(stb_vorbis *f, const stb_vorbis_seek_entry *entries, int count)
+{
+   stb_vorbis_seek_entry *table;
+   int i;
+
+   if (IS_PUSH_MODE(f)) return error(f, VORBIS_invalid_api_mixing);
+   if (count <= 0) return 0;
+   for (i=0; i < count; ++i) {
+      if (entries[i].page_start < f->first_audio_page_offset) return 0;
+      if (f->stream_len && entries[i].page_start >= f->stream_len) return 0;
+      if (i > 0 && (entries[i].page_start <= entries[i-1].page_start || entries[i].sample < entries[i-1].sample))
+         return 0;
+   }
+   table = (stb_vorbis_seek_entry *) setup_malloc(f, sizeof(*table) * count);
+   if (!table) return error(f, VORBIS_outofmem);
+   memcpy(table, entries, sizeof(*table) * count);
+   install_seek_table(f, table, count);
+   return 1;
+}
+
+const stb_vorbis_seek_entry *stb_vorbis_get_seek_table(stb_vorbis *f, int *count)
+{
+   if (count) *count = f->seek_table_count;
+   return f->seek_table;
+}
+
+#ifndef STB_VORBIS_NO_STDIO
+// sidecar layout, every field a little-endian uint32: "OVST", version,
+// stream length in bytes, entry count, then page_start/sample pairs
+#define SEEK_TABLE_FILE_VERSION 1
+
+static void seek_table_put32(FILE *out, uint32 x)
+{
+   fputc(x & 255, out);
+   fputc((x >> 8) & 255, out);
+   fputc((x >> 16) & 255, out);
+   fputc((x >> 24) & 255, out);
+}
+
+static uint32 seek_table_get32(FILE *in)
+{
+   uint8 b[4];
+   if (fread(b, 4, 1, in) != 1) return 0;
+   return b[0] + (b[1] << 8) + (b[2] << 16) + ((uint32) b[3] << 24);
+}
+
+int stb_vorbis_save_seek_table(stb_vorbis *f, const char *filename)
+{
+   FILE *out;
+   int i, ok;
+   if (!f->seek_table) return 0;
+   out = fopen(filename, "wb");
+   if (!out) return 0;
+   seek_table_put32(out, 0x5453564f); // "OVST"
+   seek_table_put32(out, SEEK_TABLE_FILE_VERSION);
+   seek_table_put32(out, f->stream_len);
+   seek_table_put32(out, f->seek_table_count);
+   for (i=0; i < f->seek_table_count; ++i) {
+      seek_table_put32(out, f->seek_table[i].page_start);
+      seek_table_put32(out, f->seek_table[i].sample);
+   }
+   ok = !ferror(out);
+   if (fclose(out)) ok = 0;
+   return ok;
+}
+
+int stb_vorbis_load_seek_table(stb_vorbis *f, const char *filename)
+{
+   stb_vorbis_seek_entry *entries;
+   FILE *in;
+   uint32 count, i;
+   int ok = 0;
+
+   in = fopen(filename, "rb");
+   if (!in) return 0;
+   if (seek_table_get32(in) == 0x5453564f
+         && seek_table_get32(in) == SEEK_TABLE_FILE_VERSION
+         && seek_table_get32(in) == f->stream_len
+         && (count = seek_table_get32(in)) > 0 && count < (1u << 24)) {
+      entries = (stb_vorbis_seek_entry *) malloc(sizeof(*entries) * count);
+      if (entries) {
+         for (i=0; i < count; ++i) {
+            entries[i].page_start = seek_table_get32(in);
+            entries[i].sample     = seek_table_get32(in);
+         }
+         if (!feof(in) && !ferror(in))
+            ok = stb_vorbis_set_seek_table(f, entries, (int) count);
+         free(entries);
+      }
+   }
+   fclose(in);
+   return ok;
+}
+#endif // STB_VORBIS_NO_STDIO
+
 
 
 int stb_vorbis_get_frame_float(stb_vorbis *f, int *channels, float ***output)
@@ -5012,6 +5612,21 @@ stb_vorbis * stb_vorbis_open_filename(const char *filename, int *error, stb_vorb
 }
 #endif // STB_VORBIS_NO_STDIO
 
+int stb_vorbis_memory_required(const unsigned char *data, int len, int *error)
+{
+   unsigned int required;
+   stb_vorbis *f = stb_vorbis_open_memory(data, len, error, NULL);
+   if (f == NULL) return 0;
+   // the peak while parsing the setup header, or the final setup memory
+   // (which includes the stb_vorbis itself) plus the per-frame temp memory
+   // that open checks for
+   required = f->setup_memory_required + f->temp_memory_required;
+   if (f->alloc_high_water > required)
+      required = f->alloc_high_water;
+   stb_vorbis_close(f);
+   return (int) required;
+}
+
 stb_vorbis * stb_vorbis_open_memory(const unsigned char *data, int len, int *error, stb_vorbis_alloc *alloc)
 {
    stb_vorbis *f, p;
@@ -5256,19 +5871,24 @@ int stb_vorbis_get_samples_short(stb_vorbis *f, int channels, short **buffer, in
    return n;
 }
 
-#ifndef STB_VORBIS_NO_STDIO
-int stb_vorbis_decode_filename(const char *filename, int *channels, int *sample_rate, short **output)
+// decodes all of v into a malloced buffer. the buffer is sized from the
+// stream length up front, so it normally isn't reallocated while decoding;
+// growing is only a fallback for streams whose last granule is missing or
+// wrong.
+static int decode_whole_stream(stb_vorbis *v, int *channels, int *sample_rate, short **output)
 {
-   int data_len, offset, total, limit, error;
+   int data_len, offset, total, limit;
+   unsigned int length;
    short *data;
-   stb_vorbis *v = stb_vorbis_open_filename(filename, &error, NULL);
-   if (v == NULL) return -1;
    limit = v->channels * 4096;
    *channels = v->channels;
    if (sample_rate)
       *sample_rate = v->sample_rate;
    offset = data_len = 0;
    total = limit;
+   length = stb_vorbis_stream_length_in_samples(v);
+   if (length > 0 && length < (unsigned int) (0x7fffffff / sizeof(*data) / v->channels) - 4096)
+      total = length * v->channels + limit;
    data = (short *) malloc(total * sizeof(*data));
    if (data == NULL) {
       stb_vorbis_close(v);
@@ -5295,45 +5915,23 @@ int stb_vorbis_decode_filename(const char *filename, int *channels, int *sample_
    stb_vorbis_close(v);
    return data_len;
 }
+
+#ifndef STB_VORBIS_NO_STDIO
+int stb_vorbis_decode_filename(const char *filename, int *channels, int *sample_rate, short **output)
+{
+   int error;
+   stb_vorbis *v = stb_vorbis_open_filename(filename, &error, NULL);
+   if (v == NULL) return -1;
+   return decode_whole_stream(v, channels, sample_rate, output);
+}
 #endif // NO_STDIO
 
 int stb_vorbis_decode_memory(const uint8 *mem, int len, int *channels, int *sample_rate, short **output)
 {
-   int data_len, offset, total, limit, error;
-   short *data;
+   int error;
    stb_vorbis *v = stb_vorbis_open_memory(mem, len, &error, NULL);
    if (v == NULL) return -1;
-   limit = v->channels * 4096;
-   *channels = v->channels;
-   if (sample_rate)
-      *sample_rate = v->sample_rate;
-   offset = data_len = 0;
-   total = limit;
-   data = (short *) malloc(total * sizeof(*data));
-   if (data == NULL) {
-      stb_vorbis_close(v);
-      return -2;
-   }
-   for (;;) {
-      int n = stb_vorbis_get_frame_short_interleaved(v, v->channels, data+offset, total-offset);
-      if (n == 0) break;
-      data_len += n;
-      offset += n * v->channels;
-      if (offset + limit > total) {
-         short *data2;
-         total *= 2;
-         data2 = (short *) realloc(data, total * sizeof(*data));
-         if (data2 == NULL) {
-            free(data);
-            stb_vorbis_close(v);
-            return -2;
-         }
-         data = data2;
-      }
-   }
-   *output = data;
-   stb_vorbis_close(v);
-   return data_len;
+   return decode_whole_stream(v, channels, sample_rate, output);
 }
 #endif // STB_VORBIS_NO_INTEGER_CONVERSION
 
@@ -1,50 +1,636 @@
+#include <stddef.h>
+
 #include "text.h"
 
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb/stb_truetype.h"
 
-unsigned char ttf_buffer[1<<20];
-unsigned char temp_bitmap[512*512];
+// The atlas is cut into shelves: strips across its whole width holding square
+// cells of one power-of-two size. A glyph takes the smallest cell that fits it
+// with a texel to spare, so the empty gutter keeps linear filtering from
+// bleeding in the neighbours. A cell is reused by any glyph of its size, and a
+// shelf that has gone stale is given back to the free space as a whole.
+//
+// The texels are kept in g_atlas too. A shelf remembers the columns rendered
+// into since its last upload, and those are sent before the quads are drawn.
+//
+// Above the atlas, a string is laid out once into a run: its glyphs and their
+// pen positions, kerned and aligned. Runs are looked up by a hash of the text,
+// font, size and alignment, so text that doesn't change costs the glyph
+// lookups and nothing else. Quads are written to a streaming vertex buffer.
+
+static const int k_atlas_size      = 512;
+static const int k_row_unit        = 8;    // Smallest cell. Shelves start on multiples of it.
+static const int k_max_cell        = 128;  // Bigger glyphs are not drawn.
+static const int k_max_shelves     = k_atlas_size / k_row_unit;
+static const int k_max_cells       = k_atlas_size / k_row_unit;  // Per shelf.
+static const int k_subpixel_steps  = 4;    // Horizontal pen positions cached per pixel.
+static const int k_size_steps      = 8;    // Sizes are cached in eighths of a pixel.
+static const int k_glyph_hash_size = 1024;
+static const int k_max_batch       = 128;  // Glyphs per draw.
+static const int k_stream_size     = 128 * 1024;
+static const int k_max_fonts       = 4;
+static const int k_max_runs        = 64;
+static const int k_first_kern      = 32;   // The kerning table covers printable ASCII.
+static const int k_num_kern        = 95;
+
+struct Font {
+    unsigned char* data;
+    stbtt_fontinfo info;
+    int            ascent, descent, line_gap;  // Font units, as all below.
+    int            ascii_glyphs[128];
+    int            ascii_advances[128];
+    short*         ascii_kern;  // k_num_kern squared pairs, NULL when the font has no kerning.
+};
+
+struct GlyphShelf {
+    int      height;              // Only valid on the row a shelf starts at.
+    int      cell;                // 0 for free space.
+    int      dirty_x0, dirty_x1;  // Columns to upload, none when x1 <= x0.
+    uint32_t last_used;
+};
+
+struct GlyphSlot {
+    uint64_t key;
+    bool     used;
+    int      w, h;        // Bitmap size, smaller than the cell.
+    int      xoff, yoff;  // Bitmap top left from the pen, y down.
+    uint32_t last_used;
+    int      next;        // Hash chain, -1 ends it.
+};
+
+struct RunGlyph {
+    int   glyph;
+    float x, y;  // Pen position from the anchor. y goes down, one line height per line.
+};
+
+struct TextVertex {
+    float x, y;
+    float s, t;
+};
+
+// A laid out string. Evicted runs keep their buffers for the next one.
+struct TextRun {
+    uint64_t  hash;  // 0 for an unused run.
+    int       font, size_q;
+    TextAlign align;
+    char*     text;  // Copy, to tell strings with the same hash apart.
+    int       text_capacity;
+    RunGlyph* glyphs;
+    int       num_glyphs, glyph_capacity;
+    uint32_t  last_used;
+};
+
+static Font           g_fonts[k_max_fonts];
+static int            g_num_fonts;
+static uint8_t        g_atlas[k_atlas_size * k_atlas_size];
+static GLuint         g_atlas_tex;
+static GlyphShelf     g_shelves[k_max_shelves];             // By first row / k_row_unit.
+static GlyphSlot      g_slots[k_max_shelves * k_max_cells];  // By shelf * k_max_cells + cell.
+static int            g_glyph_hash[k_glyph_hash_size];
+static uint32_t       g_glyph_clock;  // Ticks once per batch. Glyphs of the current one are never evicted.
+static TextRun        g_runs[k_max_runs];
+static GLStreamBuffer g_text_stream;
+static uint32_t       g_run_clock;
+static TextCacheStats g_text_stats;
+
+static uint64_t glyph_key(int font, int size_q, int sub_x, int glyph)
+{
+    return ((uint64_t)font << 40) | ((uint64_t)sub_x << 32) | ((uint64_t)size_q << 16) | (uint64_t)glyph;
+}
+
+static int glyph_bucket(uint64_t key)
+{
+    return (int)((key * 0x9e3779b97f4a7c15ULL) >> 32) & (k_glyph_hash_size - 1);
+}
+
+static int next_shelf(int shelf)
+{
+    return shelf + g_shelves[shelf].height / k_row_unit;
+}
+
+static void mark_dirty(GlyphShelf* shelf, int x0, int x1)
+{
+    if (shelf->dirty_x1 <= shelf->dirty_x0) {
+        shelf->dirty_x0 = x0;
+        shelf->dirty_x1 = x1;
+    } else {
+        shelf->dirty_x0 = x0 < shelf->dirty_x0 ? x0 : shelf->dirty_x0;
+        shelf->dirty_x1 = x1 > shelf->dirty_x1 ? x1 : shelf->dirty_x1;
+    }
+}
+
+static void touch_slot(int slot)
+{
+    g_slots[slot].last_used = g_glyph_clock;
+    g_shelves[slot / k_max_cells].last_used = g_glyph_clock;
+}
+
+static void evict_slot(int slot)
+{
+    int* link = &g_glyph_hash[glyph_bucket(g_slots[slot].key)];
+    while (*link != slot) {
+        link = &g_slots[*link].next;
+    }
+    *link = g_slots[slot].next;
+    g_slots[slot].used = false;
+    ++g_text_stats.evictions;
+}
+
+// Empties a shelf and merges all runs of free space.
+static void free_shelf(int shelf)
+{
+    for (int i = 0; i < k_max_cells; ++i) {
+        if (g_slots[shelf * k_max_cells + i].used) {
+            evict_slot(shelf * k_max_cells + i);
+        }
+    }
+    g_shelves[shelf].cell = 0;
+    for (int s = 0; s < k_max_shelves; s = next_shelf(s)) {
+        while (g_shelves[s].cell == 0 && next_shelf(s) < k_max_shelves && g_shelves[next_shelf(s)].cell == 0) {
+            g_shelves[s].height += g_shelves[next_shelf(s)].height;
+        }
+    }
+}
+
+// A slot for a glyph needing the given cell size, evicting what it has to.
+// -1 when everything that could make room holds a glyph of the current batch.
+static int alloc_slot(int cell)
+{
+    int cells_per_shelf = k_atlas_size / cell;
+    for (int s = 0; s < k_max_shelves; s = next_shelf(s)) {
+        if (g_shelves[s].cell == cell) {
+            for (int i = 0; i < cells_per_shelf; ++i) {
+                if (!g_slots[s * k_max_cells + i].used) {
+                    return s * k_max_cells + i;
+                }
+            }
+        }
+    }
+    for (;;) {
+        // A new shelf, cut from the smallest free run that takes it.
+        int best = -1;
+        for (int s = 0; s < k_max_shelves; s = next_shelf(s)) {
+            if (g_shelves[s].cell == 0 && g_shelves[s].height >= cell &&
+                (best < 0 || g_shelves[s].height < g_shelves[best].height)) {
+                best = s;
+            }
+        }
+        if (best >= 0) {
+            GlyphShelf* shelf = &g_shelves[best];
+            if (shelf->height > cell) {
+                GlyphShelf* rest = &g_shelves[best + cell / k_row_unit];
+                memset(rest, 0, sizeof(*rest));
+                rest->height = shelf->height - cell;
+            }
+            shelf->height = cell;
+            shelf->cell = cell;
+            shelf->dirty_x0 = shelf->dirty_x1 = 0;
+            return best * k_max_cells;
+        }
+        // Else the least recently used glyph of the same size.
+        int lru = -1;
+        for (int s = 0; s < k_max_shelves; s = next_shelf(s)) {
+            if (g_shelves[s].cell != cell || g_shelves[s].last_used == g_glyph_clock) {
+                continue;
+            }
+            for (int i = s * k_max_cells; i < s * k_max_cells + cells_per_shelf; ++i) {
+                if (g_slots[i].last_used != g_glyph_clock &&
+                    (lru < 0 || g_slots[i].last_used < g_slots[lru].last_used)) {
+                    lru = i;
+                }
+            }
+        }
+        if (lru >= 0) {
+            evict_slot(lru);
+            return lru;
+        }
+        // Else the stalest shelf of another size, until a free run is tall enough.
+        int stale = -1;
+        for (int s = 0; s < k_max_shelves; s = next_shelf(s)) {
+            if (g_shelves[s].cell != 0 && g_shelves[s].last_used != g_glyph_clock &&
+                (stale < 0 || g_shelves[s].last_used < g_shelves[stale].last_used)) {
+                stale = s;
+            }
+        }
+        if (stale < 0) {
+            return -1;
+        }
+        free_shelf(stale);
+    }
+}
+
+// The slot with the glyph's bitmap, rendered into the atlas on a miss. -1 if
+// it is too big for a cell or there is no room for it in this batch.
+static int find_glyph(int font, int size_q, int sub_x, int glyph)
+{
+    uint64_t key = glyph_key(font, size_q, sub_x, glyph);
+    int bucket = glyph_bucket(key);
+    for (int slot = g_glyph_hash[bucket]; slot >= 0; slot = g_slots[slot].next) {
+        if (g_slots[slot].key == key) {
+            ++g_text_stats.hits;
+            touch_slot(slot);
+            return slot;
+        }
+    }
+    ++g_text_stats.misses;
+
+    const stbtt_fontinfo* info = &g_fonts[font].info;
+    float scale = stbtt_ScaleForPixelHeight(info, (float)size_q / k_size_steps);
+    float shift_x = (float)sub_x / k_subpixel_steps;
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBoxSubpixel(info, glyph, scale, scale, shift_x, 0, &x0, &y0, &x1, &y1);
+    int w = x1 - x0;
+    int h = y1 - y0;
+    int cell = k_row_unit;
+    while (cell <= w || cell <= h) {
+        cell *= 2;
+    }
+    if (cell > k_max_cell) {
+        return -1;
+    }
+    int slot = alloc_slot(cell);
+    if (slot < 0) {
+        return -1;
+    }
+
+    int shelf = slot / k_max_cells;
+    int x = (slot % k_max_cells) * cell;
+    uint8_t* texels = g_atlas + shelf * k_row_unit * k_atlas_size + x;
+    for (int j = 0; j < cell; ++j) {
+        memset(texels + j * k_atlas_size, 0, cell);
+    }
+    if (w > 0 && h > 0) {
+        stbtt_MakeGlyphBitmapSubpixel(info, texels, w, h, k_atlas_size, scale, scale, shift_x, 0, glyph);
+    }
+    mark_dirty(&g_shelves[shelf], x, x + cell);
+
+    GlyphSlot* s = &g_slots[slot];
+    s->key = key;
+    s->used = true;
+    s->w = w;
+    s->h = h;
+    s->xoff = x0;
+    s->yoff = y0;
+    s->next = g_glyph_hash[bucket];
+    g_glyph_hash[bucket] = slot;
+    touch_slot(slot);
+    return slot;
+}
+
+// Sends what was rendered since the last call to the bound atlas texture.
+static void upload_dirty_shelves()
+{
+    bool pixel_store_set = false;
+    for (int s = 0; s < k_max_shelves; s = next_shelf(s)) {
+        GlyphShelf* shelf = &g_shelves[s];
+        if (shelf->dirty_x1 <= shelf->dirty_x0) {
+            continue;
+        }
+        if (!pixel_store_set) {
+            glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, k_atlas_size);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            pixel_store_set = true;
+        }
+        int y = s * k_row_unit;
+        int w = shelf->dirty_x1 - shelf->dirty_x0;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, shelf->dirty_x0, y, w, shelf->height, GL_ALPHA, GL_UNSIGNED_BYTE,
+                        g_atlas + y * k_atlas_size + shelf->dirty_x0);
+        ++g_text_stats.uploads;
+        g_text_stats.uploaded_bytes += (uint64_t)w * shelf->height;
+        shelf->dirty_x0 = shelf->dirty_x1 = 0;
+    }
+    if (pixel_store_set) {
+        glPopClientAttrib();
+    }
+}
+
+int text_load_font(const char* fname)
+{
+    if (g_num_fonts == k_max_fonts) {
+        return -1;
+    }
+    FILE* fd = fopen(fname, "rb");
+    if (!fd) {
+        return -1;
+    }
+    fseek(fd, 0, SEEK_END);
+    long size = ftell(fd);
+    fseek(fd, 0, SEEK_SET);
+    unsigned char* data = size > 0 ? (unsigned char*)malloc(size) : NULL;
+    bool ok = data && fread(data, 1, size, fd) == (size_t)size;
+    fclose(fd);
+
+    Font* font = &g_fonts[g_num_fonts];
+    int offset = ok ? stbtt_GetFontOffsetForIndex(data, 0) : -1;
+    if (offset < 0 || !stbtt_InitFont(&font->info, data, offset)) {
+        free(data);
+        return -1;
+    }
+    font->data = data;
+    stbtt_GetFontVMetrics(&font->info, &font->ascent, &font->descent, &font->line_gap);
+    for (int c = 0; c < 128; ++c) {
+        int lsb;
+        font->ascii_glyphs[c] = stbtt_FindGlyphIndex(&font->info, c);
+        stbtt_GetGlyphHMetrics(&font->info, font->ascii_glyphs[c], &font->ascii_advances[c], &lsb);
+    }
+    // stb_truetype reads the kern table with a binary search per pair. Pairs
+    // of text the game writes are looked up once here instead.
+    font->ascii_kern = NULL;
+    if (font->info.kern) {
+        font->ascii_kern = (short*)malloc(k_num_kern * k_num_kern * sizeof(short));
+    }
+    if (font->ascii_kern) {
+        for (int i = 0; i < k_num_kern; ++i) {
+            for (int j = 0; j < k_num_kern; ++j) {
+                font->ascii_kern[i * k_num_kern + j] = (short)stbtt_GetGlyphKernAdvance(
+                    &font->info, font->ascii_glyphs[k_first_kern + i], font->ascii_glyphs[k_first_kern + j]);
+            }
+        }
+    }
+    return g_num_fonts++;
+}
+
+// Next codepoint of a UTF-8 string, moving *text past it. Malformed sequences
+// come out as U+FFFD, one per byte that can't start a sequence.
+static int next_codepoint(const char** text)
+{
+    const unsigned char* s = (const unsigned char*)*text;
+    int c = s[0];
+    int n, min;
+    if (c < 0x80) {
+        *text += 1;
+        return c;
+    } else if (c >= 0xc2 && c < 0xe0) {
+        n = 1; min = 0x80; c &= 0x1f;
+    } else if (c >= 0xe0 && c < 0xf0) {
+        n = 2; min = 0x800; c &= 0x0f;
+    } else if (c >= 0xf0 && c < 0xf5) {
+        n = 3; min = 0x10000; c &= 0x07;
+    } else {
+        *text += 1;
+        return 0xfffd;
+    }
+    for (int i = 1; i <= n; ++i) {
+        if ((s[i] & 0xc0) != 0x80) {  // Also stops at the terminator.
+            *text += i;
+            return 0xfffd;
+        }
+        c = (c << 6) | (s[i] & 0x3f);
+    }
+    *text += n + 1;
+    if (c < min || c > 0x10ffff || (c >= 0xd800 && c < 0xe000)) {
+        return 0xfffd;
+    }
+    return c;
+}
+
+static int font_glyph(const Font* font, int c)
+{
+    return c < 128 ? font->ascii_glyphs[c] : stbtt_FindGlyphIndex(&font->info, c);
+}
+
+static int font_advance(const Font* font, int c, int glyph)
+{
+    if (c < 128) {
+        return font->ascii_advances[c];
+    }
+    int advance, lsb;
+    stbtt_GetGlyphHMetrics(&font->info, glyph, &advance, &lsb);
+    return advance;
+}
+
+static int font_kern(const Font* font, int c1, int glyph1, int c2, int glyph2)
+{
+    if (!font->ascii_kern) {
+        return 0;
+    }
+    unsigned i1 = (unsigned)(c1 - k_first_kern);
+    unsigned i2 = (unsigned)(c2 - k_first_kern);
+    if (i1 < (unsigned)k_num_kern && i2 < (unsigned)k_num_kern) {
+        return font->ascii_kern[i1 * k_num_kern + i2];
+    }
+    return stbtt_GetGlyphKernAdvance(&font->info, glyph1, glyph2);
+}
+
+static uint64_t run_hash(int font, int size_q, TextAlign align, const char* text)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    h = (h ^ (uint64_t)font) * 0x100000001b3ULL;
+    h = (h ^ (uint64_t)size_q) * 0x100000001b3ULL;
+    h = (h ^ (uint64_t)align) * 0x100000001b3ULL;
+    for (const char* p = text; *p; ++p) {
+        h = (h ^ (unsigned char)*p) * 0x100000001b3ULL;
+    }
+    return h ? h : 1;
+}
+
+static void shift_line(TextRun* run, int first, float width, TextAlign align)
+{
+    float shift = align == TextAlign::RIGHT ? -width : align == TextAlign::CENTER ? -0.5f * width : 0;
+    for (int i = first; i < run->num_glyphs; ++i) {
+        run->glyphs[i].x += shift;
+    }
+}
+
+// Fills a run with the glyphs of text that have something to draw.
+static bool layout_run(TextRun* run, const Font* font, float scale, const char* text)
+{
+    int len = (int)strlen(text);
+    if (run->text_capacity < len + 1 || run->glyph_capacity < len) {
+        // A byte makes at most one glyph.
+        char* new_text = (char*)realloc(run->text, len + 1);
+        if (new_text) {
+            run->text = new_text;
+            run->text_capacity = len + 1;
+        }
+        RunGlyph* new_glyphs = (RunGlyph*)realloc(run->glyphs, (len ? len : 1) * sizeof(RunGlyph));
+        if (new_glyphs) {
+            run->glyphs = new_glyphs;
+            run->glyph_capacity = len;
+        }
+        if (!new_text || !new_glyphs) {
+            return false;
+        }
+    }
+    memcpy(run->text, text, len + 1);
+
+    float line_height = (font->ascent - font->descent + font->line_gap) * scale;
+    float x = 0, y = 0;
+    int line_start = 0;
+    int prev_c = -1, prev_glyph = 0;
+    run->num_glyphs = 0;
+    while (*text) {
+        int c = next_codepoint(&text);
+        if (c == '\n') {
+            shift_line(run, line_start, x, run->align);
+            line_start = run->num_glyphs;
+            x = 0;
+            y += line_height;
+            prev_c = -1;
+            continue;
+        }
+        int glyph = font_glyph(font, c);
+        if (prev_c >= 0) {
+            x += font_kern(font, prev_c, prev_glyph, c, glyph) * scale;
+        }
+        if (!stbtt_IsGlyphEmpty(&font->info, glyph)) {
+            RunGlyph* g = &run->glyphs[run->num_glyphs++];
+            g->glyph = glyph;
+            g->x = x;
+            g->y = y;
+        }
+        x += font_advance(font, c, glyph) * scale;
+        prev_c = c;
+        prev_glyph = glyph;
+    }
+    shift_line(run, line_start, x, run->align);
+    return true;
+}
+
+// The cached run for the string, laid out again in the least recently used
+// run on a miss. NULL if there's no memory for it.
+static const TextRun* find_run(int font_i, int size_q, TextAlign align, const char* text)
+{
+    uint64_t hash = run_hash(font_i, size_q, align, text);
+    ++g_run_clock;
+    TextRun* lru = &g_runs[0];
+    for (int i = 0; i < k_max_runs; ++i) {
+        TextRun* run = &g_runs[i];
+        if (run->hash == hash && run->font == font_i && run->size_q == size_q && run->align == align &&
+            strcmp(run->text, text) == 0) {
+            ++g_text_stats.run_hits;
+            run->last_used = g_run_clock;
+            return run;
+        }
+        if (run->last_used < lru->last_used) {
+            lru = run;
+        }
+    }
+    ++g_text_stats.run_misses;
+    const Font* font = &g_fonts[font_i];
+    lru->hash = 0;
+    lru->font = font_i;
+    lru->size_q = size_q;
+    lru->align = align;
+    if (!layout_run(lru, font, stbtt_ScaleForPixelHeight(&font->info, (float)size_q / k_size_steps), text)) {
+        return NULL;
+    }
+    lru->hash = hash;
+    lru->last_used = g_run_clock;
+    return lru;
+}
+
+void text_draw(int font_i, float size, float x, float y, const char* text, TextAlign align)
+{
+    if (font_i < 0 || font_i >= g_num_fonts) {
+        return;
+    }
+    const Font* font = &g_fonts[font_i];
+    int size_q = (int)(size * k_size_steps + 0.5f);
+    if (size_q <= 0 || size_q > 0xffff) {
+        return;
+    }
+    const TextRun* run = find_run(font_i, size_q, align, text);
+    if (!run) {
+        return;
+    }
+    float scale = stbtt_ScaleForPixelHeight(&font->info, (float)size_q / k_size_steps);
+    float baseline = floorf(y - font->ascent * scale + 0.5f);
+
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, g_atlas_tex);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    for (int first = 0; first < run->num_glyphs; first += k_max_batch) {
+        int   slots[k_max_batch];
+        float pens[k_max_batch];
+        float baselines[k_max_batch];
+        int   num_glyphs = 0;
+        ++g_glyph_clock;
+        for (int i = first; i < run->num_glyphs && i < first + k_max_batch; ++i) {
+            const RunGlyph* rg = &run->glyphs[i];
+            float pen = floorf(x + rg->x);
+            int sub_x = (int)((x + rg->x - pen) * k_subpixel_steps + 0.5f);
+            if (sub_x == k_subpixel_steps) {
+                pen += 1;
+                sub_x = 0;
+            }
+            int slot = find_glyph(font_i, size_q, sub_x, rg->glyph);
+            if (slot >= 0 && g_slots[slot].w > 0 && g_slots[slot].h > 0) {
+                slots[num_glyphs] = slot;
+                pens[num_glyphs] = pen;
+                baselines[num_glyphs] = baseline - floorf(rg->y + 0.5f);
+                ++num_glyphs;
+            }
+        }
+        upload_dirty_shelves();
+
+        size_t offset;
+        TextVertex* v = NULL;
+        if (num_glyphs > 0) {
+            v = (TextVertex*)gl_stream_map(&g_text_stream, num_glyphs * 4 * sizeof(TextVertex), &offset);
+        }
+        if (!v) {
+            continue;
+        }
+        for (int i = 0; i < num_glyphs; ++i) {
+            const GlyphSlot* g = &g_slots[slots[i]];
+            int shelf = slots[i] / k_max_cells;
+            float s0 = (float)((slots[i] % k_max_cells) * g_shelves[shelf].cell) / k_atlas_size;
+            float t0 = (float)(shelf * k_row_unit) / k_atlas_size;
+            float s1 = s0 + (float)g->w / k_atlas_size;
+            float t1 = t0 + (float)g->h / k_atlas_size;
+            // Bitmaps are top down, the window is y up.
+            float x0 = (2.0f * (pens[i] + g->xoff) / g_win_width) - 1;
+            float x1 = (2.0f * (pens[i] + g->xoff + g->w) / g_win_width) - 1;
+            float y1 = (2.0f * (baselines[i] - g->yoff) / g_win_height) - 1;
+            float y0 = (2.0f * (baselines[i] - g->yoff - g->h) / g_win_height) - 1;
+            *v++ = { x0, y0, s0, t1 };
+            *v++ = { x1, y0, s1, t1 };
+            *v++ = { x1, y1, s1, t0 };
+            *v++ = { x0, y1, s0, t0 };
+        }
+        if (gl_stream_unmap(&g_text_stream)) {
+            glVertexPointer(2, GL_FLOAT, sizeof(TextVertex), (const GLvoid*)(offset + offsetof(TextVertex, x)));
+            glTexCoordPointer(2, GL_FLOAT, sizeof(TextVertex), (const GLvoid*)(offset + offsetof(TextVertex, s)));
+            glDrawArrays(GL_QUADS, 0, num_glyphs * 4);
+        }
+    }
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-stbtt_bakedchar cdata[96]; // ASCII 32..126 is 95 glyphs
-GLuint ftex;
+TextCacheStats text_cache_stats()
+{
+    return g_text_stats;
+}
 
 void my_stbtt_initfont(void)
 {
-   fread(ttf_buffer, 1, 1<<20, fopen("c:/windows/fonts/times.ttf", "rb"));
-   stbtt_BakeFontBitmap(ttf_buffer,0, 32.0, temp_bitmap,512,512, 32,96, cdata); // no guarantee this fits!
-   // can free ttf_buffer at this point
-   glGenTextures(1, &ftex);
-   glBindTexture(GL_TEXTURE_2D, ftex);
-   glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, 512,512, 0, GL_ALPHA, GL_UNSIGNED_BYTE, temp_bitmap);
-   // can free temp_bitmap at this point
+    memset(g_atlas, 0, sizeof(g_atlas));
+    memset(g_shelves, 0, sizeof(g_shelves));
+    memset(g_slots, 0, sizeof(g_slots));
+    memset(g_glyph_hash, 0xff, sizeof(g_glyph_hash));
+    memset(&g_text_stats, 0, sizeof(g_text_stats));
+    g_shelves[0].height = k_atlas_size;
+
+    glGenTextures(1, &g_atlas_tex);
+    glBindTexture(GL_TEXTURE_2D, g_atlas_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, k_atlas_size, k_atlas_size, 0, GL_ALPHA, GL_UNSIGNED_BYTE, g_atlas);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    gl_stream_init(&g_text_stream, GL_ARRAY_BUFFER, k_stream_size);
+    text_load_font("c:/windows/fonts/times.ttf");
 }
 
 void my_stbtt_print(float x, float y, char *text)
 {
-   // assume orthographic projection with units = screen pixels, origin at top left
-   glColor3f(0.5,0.5,0);
-   glEnable(GL_TEXTURE_2D);
-   glBindTexture(GL_TEXTURE_2D, ftex);
-   glBegin(GL_QUADS);
-   while (*text) {
-      if (*text >= 32 && *text < 128) {
-         stbtt_aligned_quad q;
-         stbtt_GetBakedQuad(cdata, 512,512, *text-32, &x,&y,&q,1);//1=opengl & d3d10+,0=d3d9
-         q.x0 = (2.0f * q.x0 / g_win_width) -1;
-         q.y0 = (2.0f * q.y0 / g_win_height)-1 ;
-         q.x1 = (2.0f * q.x1 / g_win_width) -1;
-         q.y1 = (2.0f * q.y1 / g_win_height)-1 ;
-         glTexCoord2f(q.s0,q.t1); glVertex2f(q.x0,q.y0);
-         glTexCoord2f(q.s1,q.t1); glVertex2f(q.x1,q.y0);
-         glTexCoord2f(q.s1,q.t0); glVertex2f(q.x1,q.y1);
-         glTexCoord2f(q.s0,q.t0); glVertex2f(q.x0,q.y1);
-      }
-      ++text;
-   }
-   glEnd();
+    glColor3f(0.5,0.5,0);
+    text_draw(0, 32.0f, x, y, text);
 }
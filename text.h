@@ -1,4 +1,38 @@
 #pragma once
 
+// Text drawn from a glyph cache: bitmaps are rendered with stb_truetype the
+// first time a (font, glyph, size, subpixel offset) is drawn, kept in one
+// alpha atlas texture, and evicted least recently used first when it fills up.
+// Only the parts of the atlas that changed are uploaded. Strings are laid out
+// with kerning once and the layout is cached, keyed by a hash of the text.
+
+enum class TextAlign {
+    LEFT,    // x is where lines start.
+    CENTER,  // x is the middle of every line.
+    RIGHT,   // x is where lines end.
+};
+
+// Glyph cache counters since my_stbtt_initfont.
+struct TextCacheStats {
+    int      hits;
+    int      misses;          // Glyphs rendered into the atlas.
+    int      evictions;
+    int      uploads;         // glTexSubImage2D calls.
+    uint64_t uploaded_bytes;
+    int      run_hits;        // text_draw calls that reused a layout.
+    int      run_misses;
+};
+
+// Creates the atlas and loads the default font as font 0.
 void my_stbtt_initfont(void);
+// Draws with font 0 at 32 pixels, see text_draw.
 void my_stbtt_print(float x, float y, char *text);
+
+// Index of the font to pass to text_draw, -1 if it can't be read or there is
+// no room for another font.
+int text_load_font(const char* fname);
+// Draws UTF-8 text, with a new line for every '\n'. x and y are in pixels from
+// the bottom left of the window, y is the top of the first line. Uses the
+// current color.
+void text_draw(int font, float size, float x, float y, const char* text, TextAlign align = TextAlign::LEFT);
+TextCacheStats text_cache_stats();
@@ -0,0 +1,174 @@
+#include <sys/stat.h>
+
+static const int k_max_texcache_files = 32;
+
+static MappedFile g_texcache_views[k_max_texcache_files];
+static int        g_num_texcache_views;
+
+static uint64_t fnv1a64(const uint8_t* data, size_t size)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        h = (h ^ data[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static bool stat_source(const char* fname, uint64_t* size, int64_t* mtime)
+{
+#if defined(_WIN32)
+    struct _stat64 st;
+    if (_stat64(fname, &st) != 0) {
+        return false;
+    }
+#else
+    struct stat st;
+    if (stat(fname, &st) != 0) {
+        return false;
+    }
+#endif
+    *size = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+static uint64_t texcache_texel_size(const TexCacheHeader* header)
+{
+    return (uint64_t)header->w * header->h * header->num_components;
+}
+
+static bool texcache_valid(const MappedFile* view)
+{
+    if (view->size < k_pack_alignment) {
+        return false;
+    }
+    const TexCacheHeader* header = (const TexCacheHeader*)view->base;
+    return header->magic == k_texcache_magic && header->version == k_texcache_version &&
+           view->size - k_pack_alignment == texcache_texel_size(header);
+}
+
+static bool texcache_write(const char* cache_name, const TexCacheHeader* header, const uint8_t* texels)
+{
+    FILE* fd = fopen(cache_name, "wb");
+    if (!fd) {
+        return false;
+    }
+    uint8_t block[k_pack_alignment] = {};
+    memcpy(block, header, sizeof(*header));
+    bool ok = fwrite(block, sizeof(block), 1, fd) == 1 &&
+              fwrite(texels, 1, (size_t)texcache_texel_size(header), fd) == texcache_texel_size(header);
+    ok = fclose(fd) == 0 && ok;
+    if (!ok) {
+        remove(cache_name);  // A short file would only fail validation next time.
+    }
+    return ok;
+}
+
+static uint8_t* read_source(const char* fname, uint64_t size)
+{
+    FILE* fd = fopen(fname, "rb");
+    if (!fd) {
+        return NULL;
+    }
+    uint8_t* data = (uint8_t*)malloc(size > 0 ? (size_t)size : 1);
+    if (data && fread(data, 1, (size_t)size, fd) != size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fd);
+    return data;
+}
+
+uint8_t* texcache_load(const char* fname, int* w, int* h, int* num_components, TexCacheResult* result,
+                       const stbi_parallel* parallel)
+{
+    TexCacheResult dummy;
+    if (!result) {
+        result = &dummy;
+    }
+    *result = TexCacheResult::FAILED;
+
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (!stat_source(fname, &source_size, &source_mtime)) {
+        return NULL;
+    }
+    char cache_name[1024];
+    if (snprintf(cache_name, sizeof(cache_name), "%s.texcache", fname) >= (int)sizeof(cache_name) ||
+        g_num_texcache_views == k_max_texcache_files) {
+        cache_name[0] = '\0';  // No caching for this one, decode it every time.
+    }
+
+    MappedFile view = {};
+    TexCacheHeader header = {};
+    uint8_t* source = NULL;
+    if (cache_name[0] && map_file(&view, cache_name)) {
+        if (texcache_valid(&view)) {
+            header = *(const TexCacheHeader*)view.base;
+        }
+        if (header.magic && header.source_size == source_size && header.source_mtime != source_mtime) {
+            source = read_source(fname, source_size);
+            if (source && fnv1a64(source, (size_t)source_size) == header.source_hash) {
+                // Same contents. Stamp the new mtime so the next launch doesn't hash again.
+                unmap_file(&view);
+                header.source_mtime = source_mtime;
+                FILE* fd = fopen(cache_name, "r+b");
+                if (fd) {
+                    fwrite(&header, sizeof(header), 1, fd);
+                    fclose(fd);
+                }
+                if (map_file(&view, cache_name) && texcache_valid(&view)) {
+                    *result = TexCacheResult::HIT_REHASHED;
+                }
+            }
+        } else if (header.magic && header.source_size == source_size) {
+            *result = TexCacheResult::HIT;
+        }
+    }
+
+    if (*result != TexCacheResult::FAILED) {
+        free(source);
+        g_texcache_views[g_num_texcache_views++] = view;
+        *w = (int)header.w;
+        *h = (int)header.h;
+        *num_components = (int)header.num_components;
+        return (uint8_t*)view.base + k_pack_alignment;
+    }
+    unmap_file(&view);
+
+    if (!source) {
+        source = read_source(fname, source_size);
+    }
+    if (!source) {
+        return NULL;
+    }
+    uint8_t* texels = stbi_load_from_memory_parallel(source, (int)source_size, w, h, num_components, 0,
+                                                     parallel);
+    if (texels && cache_name[0]) {
+        header.magic = k_texcache_magic;
+        header.version = k_texcache_version;
+        header.source_size = source_size;
+        header.source_mtime = source_mtime;
+        header.source_hash = fnv1a64(source, (size_t)source_size);
+        header.w = *w;
+        header.h = *h;
+        header.num_components = *num_components;
+        header.reserved = 0;
+        if (!texcache_write(cache_name, &header, texels)) {
+            printf("[DEBUG] Could not write %s\n", cache_name);
+        }
+    }
+    free(source);
+    if (texels) {
+        *result = TexCacheResult::MISS;
+    }
+    return texels;
+}
+
+void texcache_release_all()
+{
+    for (int i = 0; i < g_num_texcache_views; ++i) {
+        unmap_file(&g_texcache_views[i]);
+    }
+    g_num_texcache_views = 0;
+}
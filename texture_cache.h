@@ -0,0 +1,37 @@
+#pragma once
+
+// Decoded texels for the loose image files, cached next to each one as
+// <file>.texcache so later launches map them instead of decoding the PNG.
+//
+// A cache file is a TexCacheHeader and the texels, k_pack_alignment bytes in.
+// It is up to date when the source's size and mtime match. When only the
+// mtime moved (a checkout, a copy) the source is hashed and the cache is
+// kept if the hash still matches.
+
+static const uint32_t k_texcache_magic   = 0x54574843;  // "CHWT"
+static const uint32_t k_texcache_version = 1;
+
+struct TexCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_size;
+    int64_t  source_mtime;
+    uint64_t source_hash;     // FNV-1a 64 of the source file.
+    uint32_t w, h, num_components;
+    uint32_t reserved;
+};
+
+enum class TexCacheResult {
+    HIT,          // Mapped, nothing decoded.
+    HIT_REHASHED, // Mtime changed but the contents didn't. Mapped.
+    MISS,         // Decoded, and the cache file written for next time.
+    FAILED,       // The source could not be read or decoded.
+};
+
+// Texels of fname, as stbi_load(fname, w, h, num_components, 0) would return
+// them. On a hit they are mapped and stay valid until texcache_release_all,
+// on a MISS they come from stb_image and belong to the caller. NULL on FAILED.
+// A MISS is decoded with stbi_load_from_memory_parallel when parallel is set.
+uint8_t* texcache_load(const char* fname, int* w, int* h, int* num_components,
+                       TexCacheResult* result = NULL, const stbi_parallel* parallel = NULL);
+void texcache_release_all();
@@ -0,0 +1,152 @@
+// audio_mix_bench - what the mixer costs per voice with 16 bit and with float samples.
+//
+// Decodes a song both ways (stb_vorbis_decode_filename for S16,
+// stb_vorbis_get_samples_float_interleaved for F32), then for 1 and 4 voices
+// mixes a minute of audio in PortAudio sized buffers through audio_mix and
+// reports the time per frame per voice next to the memory a second of each
+// format takes. Also checks the two formats mix to the same signal, within
+// the 16 bit rounding, apart from the samples the 16 bit decode clipped.
+//
+// Usage: audio_mix_bench [file.ogg]     (defaults to loop.ogg)
+//
+// Build from the repo root:
+//   cl /O2 /EHsc /Iportaudio\include tools\audio_mix_bench.cc portaudio_x64.lib
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void die_gracefully(char* msg)
+{
+    puts(msg);
+    exit(EXIT_FAILURE);
+}
+
+#include "../stb/stb_vorbis.c"
+#include "../audio.h"
+#include "../audio.cc"
+
+static const int k_bench_seconds = 60;
+static const int k_frames_per_buffer = 256;  // What audio_init asks PortAudio for.
+
+static double now_seconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static float* decode_float(const char* fname, int* num_samples)
+{
+    int error;
+    stb_vorbis* v = stb_vorbis_open_filename(fname, &error, NULL);
+    if (!v) {
+        return NULL;
+    }
+    int length = (int)stb_vorbis_stream_length_in_samples(v);
+    float* samples = (float*)malloc((size_t)length * 2 * sizeof(float));
+    *num_samples = 0;
+    for (;;) {
+        int n = stb_vorbis_get_samples_float_interleaved(v, 2, samples + *num_samples * 2,
+                                                         (length - *num_samples) * 2);
+        if (n == 0) {
+            break;
+        }
+        *num_samples += n;
+    }
+    stb_vorbis_close(v);
+    return samples;
+}
+
+// Returns seconds spent mixing k_bench_seconds of audio with num_voices copies of the sample.
+template <typename T>
+static double time_mix(T* samples, int num_samples, int num_voices)
+{
+    memset(g_audio_queues, 0, sizeof(g_audio_queues));
+    for (int v = 0; v < num_voices; ++v) {
+        audio_push_sample(v, samples, num_samples, -1);
+    }
+    static float out[k_frames_per_buffer * 2];
+    int num_buffers = 44100 * k_bench_seconds / k_frames_per_buffer;
+    double start = now_seconds();
+    for (int b = 0; b < num_buffers; ++b) {
+        audio_mix(out, k_frames_per_buffer);
+    }
+    return now_seconds() - start;
+}
+
+// Largest difference between the two formats, in 16 bit steps. Samples that
+// the 16 bit decode clipped are counted instead, float keeps those.
+static double compare_formats(short* s16, float* f32, int num_samples, int* num_clipped)
+{
+    static float a[k_frames_per_buffer * 2], b[k_frames_per_buffer * 2];
+    double worst = 0;
+    *num_clipped = 0;
+    for (int offset = 0; offset + k_frames_per_buffer <= num_samples; offset += k_frames_per_buffer) {
+        memset(a, 0, sizeof(a));
+        memset(b, 0, sizeof(b));
+        mix_run(a, s16 + offset * 2, k_frames_per_buffer);
+        mix_run(b, f32 + offset * 2, k_frames_per_buffer);
+        for (int i = 0; i < k_frames_per_buffer * 2; ++i) {
+            short s = s16[offset * 2 + i];
+            if (s == SHRT_MAX || s == SHRT_MIN) {
+                ++*num_clipped;
+                continue;
+            }
+            double d = fabs((double)a[i] - b[i]) * (1 << 16);
+            if (d > worst) {
+                worst = d;
+            }
+        }
+    }
+    return worst;
+}
+
+int main(int argc, char** argv)
+{
+    const char* fname = argc > 1 ? argv[1] : "loop.ogg";
+
+    int num_channels, sample_rate, num_f32;
+    short* s16;
+    int num_s16 = stb_vorbis_decode_filename(fname, &num_channels, &sample_rate, &s16);
+    float* f32 = decode_float(fname, &num_f32);
+    if (num_s16 <= 0 || !f32 || num_channels != 2 || num_s16 != num_f32) {
+        printf("%s: could not decode as 44100 stereo\n", fname);
+        return EXIT_FAILURE;
+    }
+
+#ifdef AUDIO_MIX_SSE2
+    printf("mixer: SSE2\n");
+#else
+    printf("mixer: scalar\n");
+#endif
+    printf("%s: %.2f s\n", fname, num_s16 / 44100.0);
+    printf("  memory per voice second: S16 %d KB, F32 %d KB\n",
+           (int)(44100 * 2 * sizeof(short) / 1024), (int)(44100 * 2 * sizeof(float) / 1024));
+
+    const int voice_counts[] = { 1, 4 };
+    for (int v : voice_counts) {
+        double t16 = time_mix(s16, num_s16, v);
+        double t32 = time_mix(f32, num_f32, v);
+        double frames = 44100.0 * k_bench_seconds;
+        printf("  %d voice%s: S16 %.2f ns, F32 %.2f ns per frame per voice (%.3f%% / %.3f%% of realtime)\n",
+               v, v == 1 ? " " : "s",
+               t16 * 1e9 / frames / v, t32 * 1e9 / frames / v,
+               t16 * 100 / k_bench_seconds, t32 * 100 / k_bench_seconds);
+    }
+
+    int num_clipped;
+    double diff = compare_formats(s16, f32, num_s16, &num_clipped);
+    bool ok = diff <= 0.5 + 1e-3;
+    printf("  S16 and F32 mix within %.3f of a 16 bit step %s (%d samples clipped in S16)\n",
+           diff, ok ? "ok" : "FAILED", num_clipped);
+
+    free(s16);
+    free(f32);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
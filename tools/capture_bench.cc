@@ -0,0 +1,135 @@
+// capture_bench - what frame capture costs the render loop.
+//
+// Makes frames the size of the window at a steady rate, as the game loop
+// would, and hands each to capture_frame. Reports the time capture_frame
+// took per frame, which is all the render loop pays, and how many frames were
+// written and dropped. Then reads the first frame back with stb_image and
+// checks it against what was captured, for the image outputs.
+//
+// Frames are a moving pattern, not the game; what the writer costs depends on
+// the size and the output, not on what is in the frame.
+//
+// Usage: capture_bench [-n frames] [-s WxH] [-r fps] target
+//   target as capture_open takes it, eg. frames/%05d.png or "|gzip > frames.gz"
+//   -r 0 hands frames over as fast as possible, to find where dropping starts.
+//
+// Build from the repo root:
+//   cl /O2 /EHsc tools\capture_bench.cc
+//   c++ -O2 tools/capture_bench.cc -o capture_bench -lpthread
+
+#include <chrono>
+#include <thread>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb/stb_image.h"
+
+#include "../frame_capture.h"
+#include "../frame_capture.cc"
+
+static double now_seconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Bottom row first, like glReadPixels gives it.
+static void make_frame(uint8_t* rgba, int w, int h, int frame)
+{
+    for (int y = 0; y < h; ++y) {
+        uint8_t* row = rgba + (size_t)(h - 1 - y) * w * 4;
+        for (int x = 0; x < w; ++x) {
+            row[x * 4 + 0] = (uint8_t)(x + frame);
+            row[x * 4 + 1] = (uint8_t)(y * 2);
+            row[x * 4 + 2] = (uint8_t)((x ^ y) + frame * 3);
+            row[x * 4 + 3] = 255;
+        }
+    }
+}
+
+// The first frame as written, against what it was made from.
+static bool check_first_frame(const char* target, const uint8_t* rgba, int w, int h)
+{
+    char fname[1024];
+    snprintf(fname, sizeof(fname), target, 0);
+    int fw, fh, n;
+    uint8_t* pixels = stbi_load(fname, &fw, &fh, &n, 3);
+    bool ok = pixels && fw == w && fh == h;
+    for (int y = 0; y < h && ok; ++y) {
+        const uint8_t* src = rgba + (size_t)(h - 1 - y) * w * 4;
+        for (int x = 0; x < w && ok; ++x) {
+            ok = memcmp(pixels + ((size_t)y * w + x) * 3, src + x * 4, 3) == 0;
+        }
+    }
+    stbi_image_free(pixels);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int num_frames = 300, w = 800, h = 600;
+    double fps = 60;
+    const char* target = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            num_frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            sscanf(argv[++i], "%dx%d", &w, &h);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            fps = atof(argv[++i]);
+        } else {
+            target = argv[i];
+        }
+    }
+    if (!target || num_frames < 1 || w < 1 || h < 1) {
+        printf("usage: capture_bench [-n frames] [-s WxH] [-r fps] target\n");
+        return EXIT_FAILURE;
+    }
+    if (!capture_open(target, w, h)) {
+        printf("%s: could not open\n", target);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t* first = (uint8_t*)malloc((size_t)w * h * 4);
+    uint8_t* frame = (uint8_t*)malloc((size_t)w * h * 4);
+    make_frame(first, w, h, 0);
+    double total = 0, worst = 0;
+    double start = now_seconds();
+    for (int i = 0; i < num_frames; ++i) {
+        make_frame(frame, w, h, i);
+        double t = now_seconds();
+        capture_frame(frame, true);
+        t = now_seconds() - t;
+        total += t;
+        worst = t > worst ? t : worst;
+        if (fps > 0) {
+            double next = start + (i + 1) / fps;
+            double wait = next - now_seconds();
+            if (wait > 0) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+            }
+        }
+    }
+    double loop = now_seconds() - start;
+    CaptureStats stats = capture_close();
+    double elapsed = now_seconds() - start;
+
+    printf("%dx%d, %d frames at %s%.0f fps\n", w, h, num_frames, fps > 0 ? "" : "up to ", num_frames / loop);
+    printf("  capture_frame  %.3f ms/frame, worst %.3f ms\n", total * 1000 / num_frames, worst * 1000);
+    printf("  written %d, dropped %d, %.1f frames/s to %s\n", stats.written, stats.dropped,
+           stats.written / elapsed, target);
+
+    bool ok = stats.written + stats.dropped == stats.frames;
+    if (ok && stats.written > 0 && (strstr(target, ".png") || strstr(target, ".ppm")) &&
+        strchr(target, '%') && stats.dropped == 0) {
+        ok = check_first_frame(target, first, w, h);
+        printf("  first frame reads back %s\n", ok ? "ok" : "FAILED");
+    }
+    free(frame);
+    free(first);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,328 @@
+// font_bench - time stb_truetype's rasterizer and baking a big atlas.
+//
+// For every font, takes every codepoint it has in the Basic Multilingual
+// Plane at a few pixel heights, and reports in glyphs per second:
+//   raster   stbtt_MakeGlyphBitmap of every glyph at every size, no
+//            oversampling: the rasterizer on its own.
+//   render   stbtt_PackFontRangesRenderIntoRects with 2x2 oversampling, the
+//            way a game with CJK text or several text sizes would bake its
+//            atlas: rasterizing plus the prefilters.
+// Both are run until about a quarter second has passed and the best run is
+// kept. Gathering and packing the rects is timed once.
+//
+// With -t N the render also runs on N threads through stbtt_PackSetParallel,
+// and the atlas and packed chars are checked against the one thread result.
+//
+// Usage: font_bench [-t threads] font.ttf ...
+//
+// Build from the repo root:
+//   cl /O2 tools\font_bench.c
+//   cc -O2 tools/font_bench.c -o font_bench -lm -lpthread
+// Define STBTT_NO_SIMD to compare against the C scanline conversion and
+// prefilters.
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "../stb/stb_truetype.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_BENCH_SECONDS 0.25
+#define MIN_BENCH_RUNS 3
+#define MAX_THREADS 16
+#define MAX_CODEPOINT 0xffff
+#define OVERSAMPLE 2
+
+static const float font_sizes[] = { 13.0f, 24.0f, 48.0f };
+#define NUM_SIZES ((int) (sizeof(font_sizes) / sizeof(font_sizes[0])))
+
+typedef struct
+{
+   void (*task)(void *task_data, int i);
+   void *task_data;
+   int i;
+} task_call;
+
+#ifdef _WIN32
+#include <windows.h>
+static double now_seconds()
+{
+   LARGE_INTEGER freq, t;
+   QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&t);
+   return (double)t.QuadPart / (double)freq.QuadPart;
+}
+
+static DWORD WINAPI task_thread(void *p)
+{
+   task_call *c = (task_call *) p;
+   c->task(c->task_data, c->i);
+   return 0;
+}
+
+// stbtt_parallel runner, a thread per task but the first.
+static void run_tasks(void *user, void (*task)(void *task_data, int i), void *task_data, int count)
+{
+   HANDLE threads[MAX_THREADS];
+   task_call calls[MAX_THREADS];
+   int i;
+   for (i=1; i < count; ++i) {
+      calls[i].task = task; calls[i].task_data = task_data; calls[i].i = i;
+      threads[i] = CreateThread(NULL, 0, task_thread, &calls[i], 0, NULL);
+   }
+   task(task_data, 0);
+   for (i=1; i < count; ++i) {
+      WaitForSingleObject(threads[i], INFINITE);
+      CloseHandle(threads[i]);
+   }
+}
+#else
+#include <pthread.h>
+#include <time.h>
+static double now_seconds()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *task_thread(void *p)
+{
+   task_call *c = (task_call *) p;
+   c->task(c->task_data, c->i);
+   return NULL;
+}
+
+// stbtt_parallel runner, a thread per task but the first.
+static void run_tasks(void *user, void (*task)(void *task_data, int i), void *task_data, int count)
+{
+   pthread_t threads[MAX_THREADS];
+   task_call calls[MAX_THREADS];
+   int i;
+   for (i=1; i < count; ++i) {
+      calls[i].task = task; calls[i].task_data = task_data; calls[i].i = i;
+      pthread_create(&threads[i], NULL, task_thread, &calls[i]);
+   }
+   task(task_data, 0);
+   for (i=1; i < count; ++i)
+      pthread_join(threads[i], NULL);
+}
+#endif
+
+static unsigned char *read_file(const char *fname, int *len)
+{
+   FILE *f = fopen(fname, "rb");
+   unsigned char *data;
+   if (!f) return NULL;
+   fseek(f, 0, SEEK_END);
+   *len = (int) ftell(f);
+   fseek(f, 0, SEEK_SET);
+   data = (unsigned char *) malloc(*len);
+   if (data && fread(data, 1, *len, f) != (size_t) *len) {
+      free(data);
+      data = NULL;
+   }
+   fclose(f);
+   return data;
+}
+
+typedef struct
+{
+   stbtt_fontinfo info;
+   int *codepoints;
+   int num_codepoints;
+   stbtt_pack_range ranges[NUM_SIZES];
+   stbrp_rect *packed;       // rects after packing; rendering moves them, so every run starts from a copy
+   stbrp_rect *rects;
+   int num_rects;
+   int size;                 // atlas is size x size
+   unsigned char *pixels;
+} atlas;
+
+static void free_atlas(atlas *a)
+{
+   int i;
+   for (i=0; i < NUM_SIZES; ++i)
+      free(a->ranges[i].chardata_for_range);
+   free(a->codepoints);
+   free(a->packed);
+   free(a->rects);
+   free(a->pixels);
+}
+
+// Gathers and packs every glyph into the smallest power of two atlas that takes them.
+static int pack_atlas(atlas *a, const unsigned char *ttf, double *t_pack)
+{
+   int c, i, area = 0;
+   double start;
+
+   memset(a, 0, sizeof(*a));
+   if (!stbtt_InitFont(&a->info, ttf, stbtt_GetFontOffsetForIndex(ttf, 0)))
+      return 0;
+   a->codepoints = (int *) malloc(sizeof(int) * (MAX_CODEPOINT + 1));
+   for (c=32; c <= MAX_CODEPOINT; ++c)
+      if (stbtt_FindGlyphIndex(&a->info, c))
+         a->codepoints[a->num_codepoints++] = c;
+   a->num_rects = a->num_codepoints * NUM_SIZES;
+   a->packed = (stbrp_rect *) malloc(sizeof(stbrp_rect) * a->num_rects);
+   a->rects = (stbrp_rect *) malloc(sizeof(stbrp_rect) * a->num_rects);
+   for (i=0; i < NUM_SIZES; ++i) {
+      a->ranges[i].font_size = font_sizes[i];
+      a->ranges[i].array_of_unicode_codepoints = a->codepoints;
+      a->ranges[i].num_chars = a->num_codepoints;
+      a->ranges[i].chardata_for_range = (stbtt_packedchar *) calloc(a->num_codepoints, sizeof(stbtt_packedchar));
+   }
+
+   start = now_seconds();
+   for (a->size = 256; ; a->size *= 2) {
+      stbtt_pack_context spc;
+      if (a->size > 16384)
+         return 0;
+      if (!stbtt_PackBegin(&spc, NULL, a->size, a->size, 0, 1, NULL))
+         return 0;
+      stbtt_PackSetOversampling(&spc, OVERSAMPLE, OVERSAMPLE);
+      stbtt_PackFontRangesGatherRects(&spc, &a->info, a->ranges, NUM_SIZES, a->packed);
+      if (area == 0) {
+         for (i=0; i < a->num_rects; ++i)
+            area += a->packed[i].w * a->packed[i].h;
+         while (a->size * a->size < area) a->size *= 2;
+      }
+      stbtt_PackFontRangesPackRects(&spc, a->packed, a->num_rects);
+      stbtt_PackEnd(&spc);
+      for (i=0; i < a->num_rects && a->packed[i].was_packed; ++i)
+         ;
+      if (i == a->num_rects)
+         break;
+   }
+   *t_pack = now_seconds() - start;
+   a->pixels = (unsigned char *) malloc((size_t) a->size * a->size);
+   return 1;
+}
+
+// Every glyph at every size into the atlas pixels, used as scratch.
+static double raster_glyphs(atlas *a)
+{
+   double t = now_seconds();
+   int i, c;
+   for (i=0; i < NUM_SIZES; ++i) {
+      float scale = stbtt_ScaleForPixelHeight(&a->info, font_sizes[i]);
+      for (c=0; c < a->num_codepoints; ++c) {
+         int glyph = stbtt_FindGlyphIndex(&a->info, a->codepoints[c]);
+         int x0,y0,x1,y1;
+         stbtt_GetGlyphBitmapBox(&a->info, glyph, scale, scale, &x0,&y0,&x1,&y1);
+         stbtt_MakeGlyphBitmap(&a->info, a->pixels, x1-x0, y1-y0, x1-x0, scale, scale, glyph);
+      }
+   }
+   return now_seconds() - t;
+}
+
+// Seconds spent in stbtt_PackFontRangesRenderIntoRects, not counting the
+// clear of the atlas in stbtt_PackBegin.
+static double render_atlas(atlas *a, const stbtt_parallel *parallel)
+{
+   stbtt_pack_context spc;
+   double t;
+   memcpy(a->rects, a->packed, sizeof(stbrp_rect) * a->num_rects);
+   stbtt_PackBegin(&spc, a->pixels, a->size, a->size, 0, 1, NULL);
+   stbtt_PackSetOversampling(&spc, OVERSAMPLE, OVERSAMPLE);
+   stbtt_PackSetParallel(&spc, parallel);
+   t = now_seconds();
+   stbtt_PackFontRangesRenderIntoRects(&spc, &a->info, a->ranges, NUM_SIZES, a->rects);
+   t = now_seconds() - t;
+   stbtt_PackEnd(&spc);
+   return t;
+}
+
+// Best time of at least MIN_BENCH_RUNS runs and MIN_BENCH_SECONDS.
+static double time_raster(atlas *a)
+{
+   double best = 1e9, start = now_seconds();
+   int runs;
+   for (runs = 0; runs < MIN_BENCH_RUNS || now_seconds() - start < MIN_BENCH_SECONDS; ++runs) {
+      double t = raster_glyphs(a);
+      if (t < best) best = t;
+   }
+   return best;
+}
+
+static double time_render(atlas *a, const stbtt_parallel *parallel)
+{
+   double best = 1e9, start = now_seconds();
+   int runs;
+   for (runs = 0; runs < MIN_BENCH_RUNS || now_seconds() - start < MIN_BENCH_SECONDS; ++runs) {
+      double t = render_atlas(a, parallel);
+      if (t < best) best = t;
+   }
+   return best;
+}
+
+int main(int argc, char **argv)
+{
+   stbtt_parallel parallel = { run_tasks, NULL, 1 };
+   int first = 1, i, ok = 1;
+   double total_glyphs = 0, total_raster = 0, total_render = 0;
+
+   if (argc >= 3 && strcmp(argv[1], "-t") == 0) {
+      parallel.num_threads = atoi(argv[2]);
+      if (parallel.num_threads < 1) parallel.num_threads = 1;
+      if (parallel.num_threads > MAX_THREADS) parallel.num_threads = MAX_THREADS;
+      first = 3;
+   }
+   if (first >= argc) {
+      printf("usage: font_bench [-t threads] font.ttf ...\n");
+      return EXIT_FAILURE;
+   }
+
+#ifdef STBTT__SSE2
+   printf("simd: SSE2\n");
+#else
+   printf("simd: none\n");
+#endif
+   printf("sizes:");
+   for (i=0; i < NUM_SIZES; ++i)
+      printf(" %g", font_sizes[i]);
+   printf(" px, %dx%d oversampling, threads: %d\n", OVERSAMPLE, OVERSAMPLE, parallel.num_threads);
+   for (i=first; i < argc; ++i) {
+      int len, r;
+      unsigned char *ttf = read_file(argv[i], &len);
+      const char *name = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+      atlas a;
+      double t_pack, t_raster, t_one, t_many;
+      if (!ttf || !pack_atlas(&a, ttf, &t_pack)) {
+         printf("%s: could not read or pack\n", argv[i]);
+         free(ttf);
+         return EXIT_FAILURE;
+      }
+      t_raster = time_raster(&a);
+      t_one = time_render(&a, NULL);
+      printf("%-28s %6d glyphs  %5dx%-5d  pack %7.2f ms  raster %9.0f  render %9.0f glyphs/s",
+             name, a.num_rects, a.size, a.size, t_pack * 1000, a.num_rects / t_raster, a.num_rects / t_one);
+      total_glyphs += a.num_rects;
+      total_raster += t_raster;
+      total_render += t_one;
+      if (parallel.num_threads > 1) {
+         unsigned char *one = (unsigned char *) malloc((size_t) a.size * a.size);
+         stbtt_packedchar *chars = (stbtt_packedchar *) malloc(sizeof(stbtt_packedchar) * a.num_codepoints * NUM_SIZES);
+         int same;
+         memcpy(one, a.pixels, (size_t) a.size * a.size);
+         for (r=0; r < NUM_SIZES; ++r)
+            memcpy(chars + r * a.num_codepoints, a.ranges[r].chardata_for_range, sizeof(stbtt_packedchar) * a.num_codepoints);
+         t_many = time_render(&a, &parallel);
+         same = memcmp(one, a.pixels, (size_t) a.size * a.size) == 0;
+         for (r=0; r < NUM_SIZES; ++r)
+            same &= memcmp(chars + r * a.num_codepoints, a.ranges[r].chardata_for_range, sizeof(stbtt_packedchar) * a.num_codepoints) == 0;
+         printf("  %d threads %9.0f glyphs/s (%.2fx) %s", parallel.num_threads,
+                a.num_rects / t_many, t_one / t_many, same ? "same" : "DIFFERENT");
+         ok &= same;
+         free(chars);
+         free(one);
+      }
+      printf("\n");
+      free_atlas(&a);
+      free(ttf);
+   }
+   printf("total: %.0f glyphs, raster %.0f glyphs/s, render %.0f glyphs/s\n",
+          total_glyphs, total_glyphs / total_raster, total_glyphs / total_render);
+   return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,167 @@
+// jpeg_bench - time stb_image's JPEG decoder, stage by stage.
+//
+// For every file, decodes it from memory until about a quarter second has
+// passed and keeps the best run of each of:
+//   entropy    huffman decoding of the scans, with the IDCT left out
+//   idct       the same with the IDCT, minus the above
+//   resample   upsampling the chroma and converting to RGB: a full
+//              stbi_load_from_memory minus the two stages before it
+// and reports each in megapixels of the image per second. Totals are over
+// all files given.
+//
+// Usage: jpeg_bench file.jpg ...
+//
+// The numbers depend on the chroma subsampling and on how much detail there
+// is to code, so compare runs over the same files. Use a mix of 4:2:0, 4:2:2
+// and 4:4:4 photos to cover the upsamplers.
+//
+// Build from the repo root:
+//   cl /O2 tools\jpeg_bench.c
+//   cc -O2 tools/jpeg_bench.c -o jpeg_bench -lm
+// Define STBI_NO_SIMD to compare against the scalar IDCT, upsampling and
+// color conversion.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb/stb_image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+static double now_seconds()
+{
+   LARGE_INTEGER freq, t;
+   QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&t);
+   return (double)t.QuadPart / (double)freq.QuadPart;
+}
+#else
+#include <time.h>
+static double now_seconds()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+#endif
+
+#define MIN_BENCH_SECONDS 0.25
+#define MIN_BENCH_RUNS 3
+
+enum { STAGE_ENTROPY, STAGE_DECODE, STAGE_FULL };
+
+static unsigned char *read_file(const char *fname, int *len)
+{
+   FILE *f = fopen(fname, "rb");
+   unsigned char *data;
+   if (!f) return NULL;
+   fseek(f, 0, SEEK_END);
+   *len = (int) ftell(f);
+   fseek(f, 0, SEEK_SET);
+   data = (unsigned char *) malloc(*len);
+   if (data && fread(data, 1, *len, f) != (size_t) *len) {
+      free(data);
+      data = NULL;
+   }
+   fclose(f);
+   return data;
+}
+
+static void no_idct(stbi_uc *out, int out_stride, short data[64])
+{
+   (void) out; (void) out_stride; (void) data;
+}
+
+// Runs the decoder up to the given stage, 0 on failure.
+static int run_stage(const unsigned char *jpg, int len, int stage)
+{
+   static stbi__jpeg j;  // too big for the stack on some platforms
+   stbi__context s;
+   int ok, w, h, n;
+   if (stage == STAGE_FULL) {
+      stbi_uc *pixels = stbi_load_from_memory(jpg, len, &w, &h, &n, 0);
+      stbi_image_free(pixels);
+      return pixels != NULL;
+   }
+   stbi__start_mem(&s, jpg, len);
+   j.s = &s;
+   stbi__setup_jpeg(&j);
+   if (stage == STAGE_ENTROPY)
+      j.idct_block_kernel = no_idct;
+   ok = stbi__decode_jpeg_image(&j);
+   stbi__cleanup_jpeg(&j);
+   return ok;
+}
+
+// Best time of at least MIN_BENCH_RUNS runs and MIN_BENCH_SECONDS, negative on failure.
+static double time_stage(const unsigned char *jpg, int len, int stage)
+{
+   double best = 1e9, start = now_seconds();
+   int runs;
+   for (runs = 0; runs < MIN_BENCH_RUNS || now_seconds() - start < MIN_BENCH_SECONDS; ++runs) {
+      double t = now_seconds();
+      if (!run_stage(jpg, len, stage)) return -1;
+      t = now_seconds() - t;
+      if (t < best) best = t;
+   }
+   return best;
+}
+
+int main(int argc, char **argv)
+{
+   double total_mp = 0, total[3] = { 0, 0, 0 };
+   int i;
+
+   if (argc < 2) {
+      printf("usage: jpeg_bench file.jpg ...\n");
+      return EXIT_FAILURE;
+   }
+#ifdef STBI_SSE2
+   printf("simd: %s\n", stbi__sse2_available() ? "SSE2" : "none");
+#elif defined(STBI_NEON)
+   printf("simd: NEON\n");
+#else
+   printf("simd: none\n");
+#endif
+   printf("%-24s %11s %3s %10s %10s %10s %10s  (MP/s)\n",
+          "", "size", "ch", "entropy", "idct", "resample", "total");
+   for (i=1; i < argc; ++i) {
+      int len, w, h, n, stage;
+      unsigned char *jpg = read_file(argv[i], &len);
+      double mp, t[3];
+      if (!jpg || !stbi_info_from_memory(jpg, len, &w, &h, &n)) {
+         printf("%s: could not read\n", argv[i]);
+         free(jpg);
+         return EXIT_FAILURE;
+      }
+      mp = (double) w * h / 1e6;
+      for (stage=STAGE_ENTROPY; stage <= STAGE_FULL; ++stage) {
+         t[stage] = time_stage(jpg, len, stage);
+         if (t[stage] < 0) {
+            printf("%s: could not decode\n", argv[i]);
+            free(jpg);
+            return EXIT_FAILURE;
+         }
+      }
+      // stages are measured cumulatively; noise can make a difference come out
+      // a hair negative on tiny images
+      if (t[STAGE_DECODE] < t[STAGE_ENTROPY]) t[STAGE_DECODE] = t[STAGE_ENTROPY];
+      if (t[STAGE_FULL] < t[STAGE_DECODE]) t[STAGE_FULL] = t[STAGE_DECODE];
+      printf("%-24s %5dx%-5d %3d %10.1f %10.1f %10.1f %10.1f\n", argv[i], w, h, n,
+             mp / t[STAGE_ENTROPY],
+             t[STAGE_DECODE] > t[STAGE_ENTROPY] ? mp / (t[STAGE_DECODE] - t[STAGE_ENTROPY]) : 0.0,
+             t[STAGE_FULL] > t[STAGE_DECODE] ? mp / (t[STAGE_FULL] - t[STAGE_DECODE]) : 0.0,
+             mp / t[STAGE_FULL]);
+      total_mp += mp;
+      for (stage=STAGE_ENTROPY; stage <= STAGE_FULL; ++stage)
+         total[stage] += t[stage];
+      free(jpg);
+   }
+   printf("total: %.2f MP in %.2f ms, %.1f MP/s  (entropy %.2f ms, idct %.2f ms, resample %.2f ms)\n",
+          total_mp, total[STAGE_FULL] * 1000, total_mp / total[STAGE_FULL],
+          total[STAGE_ENTROPY] * 1000, (total[STAGE_DECODE] - total[STAGE_ENTROPY]) * 1000,
+          (total[STAGE_FULL] - total[STAGE_DECODE]) * 1000);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,260 @@
+// pack_assets - build the asset pack the game maps at startup (see pack.h).
+//
+// Every file goes in under its own name. With -d, images (png, jpg, ...) are
+// stored decoded to RGBA and ogg files decoded to interleaved samples, so the
+// game skips decoding them. Decoded audio is float, like the game's mixer
+// wants it by default, or 16 bit with -s16 for half the size. Without -d the
+// files go in as they are and the game decodes them from the mapping.
+//
+// The pack is read back and checked with the game's own reader before exiting.
+//
+// Usage: pack_assets [-d] [-s16] out.pack file...
+//
+// Build from the repo root:
+//   cl /O2 /EHsc tools\pack_assets.cc
+//
+// The game looks for chew.pack next to the executable and falls back to the
+// loose files when it's not there:
+//   pack_assets -d chew.pack background.png jaw.png headtop.png insides.png ^
+//       circle.png gum_orange.png gum_blue.png dead.png duke.ogg loop.ogg
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb/stb_image.h"
+#include "../stb/stb_vorbis.c"
+
+#include "../pack.h"
+#include "../pack.cc"
+
+static const int k_max_pack_files = 256;
+
+struct PackInput {
+    const char* path;
+    PackEntry   entry;
+    uint8_t*    data;
+};
+
+static bool has_extension(const char* path, const char* ext)
+{
+    size_t n = strlen(path), e = strlen(ext);
+    return n > e && path[n - e - 1] == '.' && strcmp(path + n - e, ext) == 0;
+}
+
+static uint8_t* read_file(const char* path, uint64_t* size)
+{
+    FILE* fd = fopen(path, "rb");
+    if (!fd) {
+        return NULL;
+    }
+    fseek(fd, 0, SEEK_END);
+    long len = ftell(fd);
+    fseek(fd, 0, SEEK_SET);
+    uint8_t* data = (uint8_t*)malloc(len > 0 ? len : 1);
+    if (data && fread(data, 1, len, fd) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fd);
+    *size = (uint64_t)len;
+    return data;
+}
+
+template <typename T>
+static int get_samples_interleaved(stb_vorbis* v, int num_channels, T* dst, int num_values);
+
+template <>
+int get_samples_interleaved(stb_vorbis* v, int num_channels, short* dst, int num_values)
+{
+    return stb_vorbis_get_samples_short_interleaved(v, num_channels, dst, num_values);
+}
+
+template <>
+int get_samples_interleaved(stb_vorbis* v, int num_channels, float* dst, int num_values)
+{
+    return stb_vorbis_get_samples_float_interleaved(v, num_channels, dst, num_values);
+}
+
+template <typename T>
+static bool decode_ogg(const char* path, PackInput* in)
+{
+    int error;
+    stb_vorbis* v = stb_vorbis_open_filename(path, &error, NULL);
+    if (!v) {
+        return false;
+    }
+    stb_vorbis_info info = stb_vorbis_get_info(v);
+    int length = (int)stb_vorbis_stream_length_in_samples(v);
+    T* samples = (T*)malloc(((size_t)length + 1) * info.channels * sizeof(T));
+    int num_samples = 0;
+    for (;;) {
+        int n = get_samples_interleaved(v, info.channels, samples + num_samples * info.channels,
+                                        (length - num_samples) * info.channels);
+        if (n == 0) {
+            break;
+        }
+        num_samples += n;
+    }
+    stb_vorbis_close(v);
+
+    in->entry.payload = sizeof(T) == sizeof(float) ? PackPayload::PCM_F32 : PackPayload::PCM_S16;
+    in->entry.params[0] = info.channels;
+    in->entry.params[1] = info.sample_rate;
+    in->entry.params[2] = num_samples;
+    in->entry.size = (uint64_t)num_samples * info.channels * sizeof(T);
+    in->data = (uint8_t*)samples;
+    return true;
+}
+
+static bool load_input(const char* path, bool decode, bool s16, PackInput* in)
+{
+    memset(&in->entry, 0, sizeof(in->entry));
+    in->path = path;
+    const char* name = strrchr(path, '/');
+    const char* back = strrchr(path, '\\');
+    if (back > name) {
+        name = back;
+    }
+    name = name ? name + 1 : path;
+    if (strlen(name) >= (size_t)k_pack_max_name) {
+        printf("%s: name longer than %d characters\n", path, k_pack_max_name - 1);
+        return false;
+    }
+    strcpy(in->entry.name, name);
+
+    if (decode && has_extension(path, "ogg")) {
+        return s16 ? decode_ogg<short>(path, in) : decode_ogg<float>(path, in);
+    }
+    int w, h, num_components;
+    if (decode && stbi_info(path, &w, &h, &num_components)) {
+        in->data = stbi_load(path, &w, &h, &num_components, 4);
+        if (!in->data) {
+            return false;
+        }
+        in->entry.payload = PackPayload::RGBA8;
+        in->entry.params[0] = w;
+        in->entry.params[1] = h;
+        in->entry.size = (uint64_t)w * h * 4;
+        return true;
+    }
+    in->entry.payload = PackPayload::FILE;
+    in->data = read_file(path, &in->entry.size);
+    return in->data != NULL;
+}
+
+static bool write_pack(const char* out_path, PackInput* inputs, int num_inputs)
+{
+    PackHeader header = {};
+    header.magic = k_pack_magic;
+    header.version = k_pack_version;
+    header.num_entries = num_inputs;
+    header.alignment = k_pack_alignment;
+
+    uint64_t offset = sizeof(PackHeader) + (uint64_t)num_inputs * sizeof(PackEntry);
+    for (int i = 0; i < num_inputs; ++i) {
+        offset = (offset + k_pack_alignment - 1) & ~(uint64_t)(k_pack_alignment - 1);
+        inputs[i].entry.offset = offset;
+        offset += inputs[i].entry.size;
+    }
+
+    FILE* fd = fopen(out_path, "wb");
+    if (!fd) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fd) == 1;
+    for (int i = 0; i < num_inputs; ++i) {
+        ok = ok && fwrite(&inputs[i].entry, sizeof(PackEntry), 1, fd) == 1;
+    }
+    static const uint8_t zeros[k_pack_alignment] = {};
+    uint64_t written = sizeof(PackHeader) + (uint64_t)num_inputs * sizeof(PackEntry);
+    for (int i = 0; i < num_inputs && ok; ++i) {
+        const PackEntry* e = &inputs[i].entry;
+        ok = fwrite(zeros, 1, (size_t)(e->offset - written), fd) == e->offset - written;
+        ok = ok && fwrite(inputs[i].data, 1, (size_t)e->size, fd) == e->size;
+        written = e->offset + e->size;
+    }
+    return fclose(fd) == 0 && ok;
+}
+
+// Maps the pack back and compares every entry with what was written.
+static bool verify_pack(const char* out_path, PackInput* inputs, int num_inputs)
+{
+    AssetPack pack;
+    if (!pack_open(&pack, out_path)) {
+        return false;
+    }
+    bool ok = pack.num_entries == num_inputs;
+    for (int i = 0; i < num_inputs && ok; ++i) {
+        const PackEntry* e = pack_find(&pack, inputs[i].entry.name);
+        ok = e && memcmp(e, &inputs[i].entry, sizeof(PackEntry)) == 0 &&
+             memcmp(pack_data(&pack, e), inputs[i].data, (size_t)e->size) == 0;
+    }
+    pack_close(&pack);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    bool decode = false;
+    bool s16 = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg) {
+        if (strcmp(argv[arg], "-d") == 0) {
+            decode = true;
+        } else if (strcmp(argv[arg], "-s16") == 0) {
+            s16 = true;
+        } else {
+            break;
+        }
+    }
+    if (argc - arg < 2) {
+        printf("usage: pack_assets [-d] [-s16] out.pack file...\n");
+        return EXIT_FAILURE;
+    }
+    const char* out_path = argv[arg++];
+    int num_inputs = argc - arg;
+    if (num_inputs > k_max_pack_files) {
+        printf("at most %d files per pack\n", k_max_pack_files);
+        return EXIT_FAILURE;
+    }
+
+    static PackInput inputs[k_max_pack_files];
+    uint64_t total_size = 0;
+    for (int i = 0; i < num_inputs; ++i) {
+        PackInput* in = &inputs[i];
+        if (!load_input(argv[arg + i], decode, s16, in)) {
+            printf("%s: could not read or decode\n", argv[arg + i]);
+            return EXIT_FAILURE;
+        }
+        for (int j = 0; j < i; ++j) {
+            if (strcmp(inputs[j].entry.name, in->entry.name) == 0) {
+                printf("%s: name already in the pack\n", in->path);
+                return EXIT_FAILURE;
+            }
+        }
+        static const char* payload_names[] = { "file", "rgba8", "pcm s16", "pcm f32" };
+        printf("  %-24s %-8s %10llu bytes\n", in->entry.name,
+               payload_names[(int)in->entry.payload], (unsigned long long)in->entry.size);
+        total_size += in->entry.size;
+    }
+
+    if (!write_pack(out_path, inputs, num_inputs)) {
+        printf("%s: could not write\n", out_path);
+        return EXIT_FAILURE;
+    }
+    if (!verify_pack(out_path, inputs, num_inputs)) {
+        printf("%s: reading the pack back FAILED\n", out_path);
+        return EXIT_FAILURE;
+    }
+    printf("%s: %d files, %llu bytes of payload\n", out_path, num_inputs,
+           (unsigned long long)total_size);
+
+    for (int i = 0; i < num_inputs; ++i) {
+        free(inputs[i].data);
+    }
+    return EXIT_SUCCESS;
+}
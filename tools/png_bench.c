@@ -0,0 +1,231 @@
+// png_bench - time stb_image's PNG decoder.
+//
+// For every file, decodes it from memory until about a quarter second has
+// passed and reports the best run in MB/s of decoded pixels. The IDAT chunks
+// are also inflated on their own with stbi_zlib_decode_malloc, which splits
+// the time into inflate and the rest (unfilter and format conversion).
+// Totals are over all files given.
+//
+// With -t N the decode goes through stbi_load_from_memory_parallel with N
+// threads, which overlaps inflate with unfiltering.
+//
+// Usage: png_bench [-t threads] [file.png ...]     (defaults to the game's images)
+//
+// Pass any folder of PNGs for a bigger corpus, eg. png_bench corpus/*.png
+//
+// Build from the repo root:
+//   cl /O2 tools\png_bench.c
+//   cc -O2 tools/png_bench.c -o png_bench -lm -lpthread
+// Define STBI_NO_SIMD to compare against the scalar unfilter.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb/stb_image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_BENCH_SECONDS 0.25
+#define MIN_BENCH_RUNS 3
+#define MAX_THREADS 16
+
+typedef struct
+{
+   void (*task)(void *task_data, int i);
+   void *task_data;
+   int i;
+} task_call;
+
+#ifdef _WIN32
+#include <windows.h>
+static double now_seconds()
+{
+   LARGE_INTEGER freq, t;
+   QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&t);
+   return (double)t.QuadPart / (double)freq.QuadPart;
+}
+
+static DWORD WINAPI task_thread(void *p)
+{
+   task_call *c = (task_call *) p;
+   c->task(c->task_data, c->i);
+   return 0;
+}
+
+// stbi_parallel runner, a thread per task but the first.
+static void run_tasks(void *user, void (*task)(void *task_data, int i), void *task_data, int count)
+{
+   HANDLE threads[MAX_THREADS];
+   task_call calls[MAX_THREADS];
+   int i;
+   for (i=1; i < count; ++i) {
+      calls[i].task = task; calls[i].task_data = task_data; calls[i].i = i;
+      threads[i] = CreateThread(NULL, 0, task_thread, &calls[i], 0, NULL);
+   }
+   task(task_data, 0);
+   for (i=1; i < count; ++i) {
+      WaitForSingleObject(threads[i], INFINITE);
+      CloseHandle(threads[i]);
+   }
+}
+#else
+#include <pthread.h>
+#include <time.h>
+static double now_seconds()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *task_thread(void *p)
+{
+   task_call *c = (task_call *) p;
+   c->task(c->task_data, c->i);
+   return NULL;
+}
+
+// stbi_parallel runner, a thread per task but the first.
+static void run_tasks(void *user, void (*task)(void *task_data, int i), void *task_data, int count)
+{
+   pthread_t threads[MAX_THREADS];
+   task_call calls[MAX_THREADS];
+   int i;
+   for (i=1; i < count; ++i) {
+      calls[i].task = task; calls[i].task_data = task_data; calls[i].i = i;
+      pthread_create(&threads[i], NULL, task_thread, &calls[i]);
+   }
+   task(task_data, 0);
+   for (i=1; i < count; ++i)
+      pthread_join(threads[i], NULL);
+}
+#endif
+
+static stbi_parallel parallel = { run_tasks, NULL, 1 };
+
+static unsigned char *read_file(const char *fname, int *len)
+{
+   FILE *f = fopen(fname, "rb");
+   unsigned char *data;
+   if (!f) return NULL;
+   fseek(f, 0, SEEK_END);
+   *len = (int) ftell(f);
+   fseek(f, 0, SEEK_SET);
+   data = (unsigned char *) malloc(*len);
+   if (data && fread(data, 1, *len, f) != (size_t) *len) {
+      free(data);
+      data = NULL;
+   }
+   fclose(f);
+   return data;
+}
+
+static unsigned int get32be(const unsigned char *p)
+{
+   return ((unsigned int) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// Concatenates the IDAT chunks, which is the zlib stream the decoder inflates.
+static unsigned char *extract_idat(const unsigned char *png, int len, int *idat_len)
+{
+   unsigned char *idat = (unsigned char *) malloc(len);
+   int pos = 8;
+   *idat_len = 0;
+   while (idat && pos + 12 <= len) {
+      unsigned int chunk_len = get32be(png + pos);
+      if (chunk_len > (unsigned int) (len - pos - 12)) break;
+      if (memcmp(png + pos + 4, "IDAT", 4) == 0) {
+         memcpy(idat + *idat_len, png + pos + 8, chunk_len);
+         *idat_len += chunk_len;
+      }
+      pos += 12 + chunk_len;
+   }
+   return idat;
+}
+
+// Best time of at least MIN_BENCH_RUNS runs and MIN_BENCH_SECONDS.
+static double time_decode(const unsigned char *png, int len)
+{
+   double best = 1e9, start = now_seconds();
+   int runs;
+   for (runs = 0; runs < MIN_BENCH_RUNS || now_seconds() - start < MIN_BENCH_SECONDS; ++runs) {
+      int w, h, n;
+      double t = now_seconds();
+      stbi_uc *pixels = stbi_load_from_memory_parallel(png, len, &w, &h, &n, 0, &parallel);
+      t = now_seconds() - t;
+      stbi_image_free(pixels);
+      if (t < best) best = t;
+   }
+   return best;
+}
+
+static double time_inflate(const unsigned char *idat, int len)
+{
+   double best = 1e9, start = now_seconds();
+   int runs;
+   for (runs = 0; runs < MIN_BENCH_RUNS || now_seconds() - start < MIN_BENCH_SECONDS; ++runs) {
+      int out_len;
+      double t = now_seconds();
+      char *out = stbi_zlib_decode_malloc((const char *) idat, len, &out_len);
+      t = now_seconds() - t;
+      free(out);
+      if (t < best) best = t;
+   }
+   return best;
+}
+
+int main(int argc, char **argv)
+{
+   static const char *default_files[] = {
+      "background.png", "jaw.png", "headtop.png", "insides.png",
+      "circle.png", "gum_orange.png", "gum_blue.png", "dead.png",
+   };
+   const char **files = (const char **) argv + 1;
+   int num_files = argc - 1, i;
+   double total_mb = 0, total_decode = 0, total_inflate = 0;
+
+   if (num_files >= 2 && strcmp(files[0], "-t") == 0) {
+      parallel.num_threads = atoi(files[1]);
+      if (parallel.num_threads < 1) parallel.num_threads = 1;
+      if (parallel.num_threads > MAX_THREADS) parallel.num_threads = MAX_THREADS;
+      files += 2;
+      num_files -= 2;
+   }
+   if (num_files == 0) {
+      files = default_files;
+      num_files = sizeof(default_files) / sizeof(default_files[0]);
+   }
+
+#ifdef STBI_SSE2
+   printf("unfilter: %s\n", stbi__sse2_available() ? "SSE2" : "scalar");
+#else
+   printf("unfilter: scalar\n");
+#endif
+   printf("threads: %d\n", parallel.num_threads);
+   for (i=0; i < num_files; ++i) {
+      int len, idat_len, w, h, n;
+      unsigned char *png = read_file(files[i], &len), *idat;
+      double mb, t_decode, t_inflate;
+      if (!png || !stbi_info_from_memory(png, len, &w, &h, &n)) {
+         printf("%s: could not read\n", files[i]);
+         free(png);
+         return EXIT_FAILURE;
+      }
+      idat = extract_idat(png, len, &idat_len);
+      mb = (double) w * h * n / (1024 * 1024);
+      t_decode = time_decode(png, len);
+      t_inflate = time_inflate(idat, idat_len);
+      printf("%-24s %5dx%-5d %d ch  %8.1f MB/s  (inflate %4.1f%%)\n",
+             files[i], w, h, n, mb / t_decode, t_inflate * 100 / t_decode);
+      total_mb += mb;
+      total_decode += t_decode;
+      total_inflate += t_inflate;
+      free(idat);
+      free(png);
+   }
+   printf("total: %.1f MB in %.2f ms, %.1f MB/s  (inflate %.2f ms, the rest %.2f ms)\n",
+          total_mb, total_decode * 1000, total_mb / total_decode,
+          total_inflate * 1000, (total_decode - total_inflate) * 1000);
+   return EXIT_SUCCESS;
+}
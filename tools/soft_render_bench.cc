@@ -0,0 +1,207 @@
+// soft_render_bench - time the software renderer on a frame like the game's.
+//
+// Loads the game's images and draws the playing screen into an offscreen
+// framebuffer: the head with the jaw at an angle, both buttons and a full
+// queue of gum on each side, over the background. The game only draws full
+// screen images on the dead screen, the background stands in for those. Reports
+// the best time per frame of at least a quarter second of frames.
+//
+// With -o the frame is written as a PPM. With -c it is compared against a
+// reference image (PPM or PNG, anything stbi_load reads), and the exit code
+// says whether every channel is within -d of it. That is the regression check
+// for hosts without a GPU.
+//
+// Usage: soft_render_bench [-t threads] [-s WxH] [-o out.ppm] [-c ref.ppm] [-d max_diff]
+//
+// Build from the repo root:
+//   cl /O2 /EHsc tools\soft_render_bench.cc
+//   c++ -O2 tools/soft_render_bench.cc -o soft_render_bench -lpthread
+// Define SOFT_RENDER_NO_SIMD to compare against the scalar rasterizer.
+
+#include <chrono>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb/stb_image.h"
+
+#include "../vector.hh"
+#include "../soft_render.h"
+#include "../soft_render.cc"
+
+static const double k_min_bench_seconds = 0.25;
+static const int    k_min_bench_frames  = 3;
+
+enum Image { BACKGROUND, JAW, HEADTOP, INSIDES, CIRCLE, GUM_ORANGE, GUM_BLUE, NUM_IMAGES };
+
+static const char* k_image_files[NUM_IMAGES] = {
+    "background.png", "jaw.png", "headtop.png", "insides.png", "circle.png", "gum_orange.png", "gum_blue.png",
+};
+
+struct Texture {
+    int w, h;
+    uint8_t* texels;
+};
+
+static Texture g_textures[NUM_IMAGES];
+static float   g_aspect;
+
+static double now_seconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Texture coordinates as draw_sprite has them.
+static void sprite(Image img, v2f a, v2f b, v2f c, v2f d)
+{
+    static const v2f uv[4] = { { 0, 1 }, { 0, 0 }, { 1, 0 }, { 1, 1 } };
+    v2f pos[4] = { a, b, c, d };
+    soft_draw_quad(g_textures[img].texels, g_textures[img].w, g_textures[img].h, pos, uv);
+}
+
+static void square_sprite(Image img, float x, float y, float w)
+{
+    sprite(img, { x - w, y - g_aspect * w }, { x - w, y + g_aspect * w },
+           { x + w, y + g_aspect * w }, { x + w, y - g_aspect * w });
+}
+
+// Same layout as game_render, with the jaw up and turned.
+static void draw_frame()
+{
+    float jaw_vpos = -0.5f, jaw_angle = 0.3f;
+    float jaw_width = 0.4f, jaw_height = 0.7f;
+    float headtop_width = jaw_width * 1.1f, headtop_height = jaw_height * 0.8f;
+    v2f center = { 0, jaw_vpos + jaw_height / 2 + 0.3f };
+    auto rotated = [&](v2f p) -> v2f {
+        float c = cosf(jaw_angle), s = sinf(jaw_angle);
+        v2f r = { c * (p.x - center.x) + s * (p.y - center.y), c * (p.y - center.y) - s * (p.x - center.x) };
+        return { r.x + center.x, r.y + center.y };
+    };
+
+    sprite(BACKGROUND, { -1, -1 }, { -1, 1 }, { 1, 1 }, { 1, -1 });
+    sprite(INSIDES, { -0.8f * jaw_width, jaw_vpos + 0.7f + 0.7f * jaw_height },
+           { -0.8f * jaw_width, jaw_vpos + 0.7f - 0.7f * jaw_height },
+           { 0.8f * jaw_width, jaw_vpos + 0.7f - 0.7f * jaw_height },
+           { 0.8f * jaw_width, jaw_vpos + 0.7f + 0.7f * jaw_height });
+    sprite(JAW, rotated({ -jaw_width, jaw_vpos }), rotated({ -jaw_width, jaw_vpos + jaw_height }),
+           rotated({ jaw_width, jaw_vpos + jaw_height }), rotated({ jaw_width, jaw_vpos }));
+    sprite(HEADTOP, { -headtop_width, 0.45f - headtop_height }, { -headtop_width, 0.45f + headtop_height },
+           { headtop_width, 0.45f + headtop_height }, { headtop_width, 0.45f - headtop_height });
+    square_sprite(CIRCLE, -0.65f, -0.70f, 0.20f);
+    square_sprite(CIRCLE, 0.65f, -0.70f, 0.20f);
+    for (int i = 0; i < 16; ++i) {
+        square_sprite(i % 2 ? GUM_BLUE : GUM_ORANGE, -0.65f, 0.90f - i * 0.11f, 0.20f);
+        square_sprite(i % 3 ? GUM_ORANGE : GUM_BLUE, 0.65f, 0.85f - i * 0.11f, 0.20f);
+    }
+}
+
+static bool write_ppm(const char* fname, const uint8_t* pixels, int w, int h)
+{
+    FILE* fd = fopen(fname, "wb");
+    if (!fd) {
+        return false;
+    }
+    fprintf(fd, "P6\n%d %d\n255\n", w, h);
+    uint8_t* row = (uint8_t*)malloc((size_t)w * 3);
+    bool ok = row != NULL;
+    for (int y = 0; y < h && ok; ++y) {
+        for (int x = 0; x < w; ++x) {
+            memcpy(row + x * 3, pixels + ((size_t)y * w + x) * 4, 3);
+        }
+        ok = fwrite(row, 3, w, fd) == (size_t)w;
+    }
+    free(row);
+    return fclose(fd) == 0 && ok;
+}
+
+int main(int argc, char** argv)
+{
+    int num_threads = 1, w = 800, h = 600, max_diff = 2;
+    const char* out_name = NULL;
+    const char* ref_name = NULL;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-t") == 0) {
+            num_threads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            sscanf(argv[i + 1], "%dx%d", &w, &h);
+        } else if (strcmp(argv[i], "-o") == 0) {
+            out_name = argv[i + 1];
+        } else if (strcmp(argv[i], "-c") == 0) {
+            ref_name = argv[i + 1];
+        } else if (strcmp(argv[i], "-d") == 0) {
+            max_diff = atoi(argv[i + 1]);
+        }
+    }
+    if (num_threads < 1 || w <= 0 || h <= 0) {
+        printf("usage: soft_render_bench [-t threads] [-s WxH] [-o out.ppm] [-c ref.ppm] [-d max_diff]\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < NUM_IMAGES; ++i) {
+        int n;
+        g_textures[i].texels = stbi_load(k_image_files[i], &g_textures[i].w, &g_textures[i].h, &n, 4);
+        if (!g_textures[i].texels) {
+            printf("%s: could not load\n", k_image_files[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    g_aspect = (float)w / h;
+
+#if defined(SOFT_RENDER_SSE2)
+    printf("simd: SSE2\n");
+#else
+    printf("simd: none\n");
+#endif
+    soft_init(w, h, num_threads);
+    const uint8_t* pixels = NULL;
+    double best = 1e9, start = now_seconds();
+    int frames;
+    for (frames = 0; frames < k_min_bench_frames || now_seconds() - start < k_min_bench_seconds; ++frames) {
+        double t = now_seconds();
+        soft_begin_frame(0xffffffff);
+        draw_frame();
+        pixels = soft_end_frame();
+        t = now_seconds() - t;
+        best = t < best ? t : best;
+    }
+    printf("%dx%d, %d threads: %.3f ms/frame, %.1f Mpixels/s  (best of %d)\n",
+           w, h, num_threads, best * 1000, w * h / best / 1e6, frames);
+
+    bool ok = true;
+    if (out_name && !write_ppm(out_name, pixels, w, h)) {
+        printf("%s: could not write\n", out_name);
+        ok = false;
+    }
+    if (ref_name) {
+        int rw, rh, n;
+        uint8_t* ref = stbi_load(ref_name, &rw, &rh, &n, 4);
+        if (!ref || rw != w || rh != h) {
+            printf("%s: could not load, or not %dx%d\n", ref_name, w, h);
+            ok = false;
+        } else {
+            int worst = 0, num_off = 0;
+            for (int i = 0; i < w * h; ++i) {
+                int off = 0;
+                for (int c = 0; c < 3; ++c) {
+                    int d = abs(pixels[i * 4 + c] - ref[i * 4 + c]);
+                    off = d > off ? d : off;
+                }
+                worst = off > worst ? off : worst;
+                num_off += off > max_diff;
+            }
+            ok = ok && num_off == 0;
+            printf("against %s: max diff %d, %d pixels over %d  %s\n",
+                   ref_name, worst, num_off, max_diff, num_off == 0 ? "ok" : "FAILED");
+        }
+        stbi_image_free(ref);
+    }
+    soft_deinit();
+    for (int i = 0; i < NUM_IMAGES; ++i) {
+        stbi_image_free(g_textures[i].texels);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
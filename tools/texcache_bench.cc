@@ -0,0 +1,187 @@
+// texcache_bench - startup image loading with and without the texture cache.
+//
+// Loads the game's images three ways and reports the total for each:
+//   stbi_load   what startup did before the cache, decoding every PNG.
+//   cold        texcache_load with no cache files: decode, then write them.
+//   warm        texcache_load with the cache files in place: map only.
+// Warm texels are touched once, the way glTexImage2D would read them, so
+// page faults count. Then checks the cached texels against stbi_load, and
+// that touching a source's mtime without changing it keeps the cache.
+//
+// The cache files are left next to the images, like a launch of the game
+// would leave them.
+//
+// Usage: texcache_bench [image...]     (defaults to the game's images)
+//
+// Build from the repo root:
+//   cl /O2 /EHsc tools\texcache_bench.cc
+
+#include <chrono>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb/stb_image.h"
+
+#include "../pack.h"
+#include "../texture_cache.h"
+#include "../pack.cc"
+#include "../texture_cache.cc"
+
+static const int k_warm_runs = 5;
+
+static volatile uint32_t g_sink;  // Keeps the touched pages from being optimized out.
+
+static const char* k_game_images[] = {
+    "background.png", "jaw.png", "headtop.png", "insides.png",
+    "circle.png", "gum_orange.png", "gum_blue.png", "dead.png",
+};
+
+static double now_seconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Reads every page, so a mapping costs what the upload would make it cost.
+static uint32_t touch(const uint8_t* texels, size_t size)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < size; i += 4096) {
+        sum += texels[i];
+    }
+    return sum;
+}
+
+static void remove_caches(const char** images, int num_images)
+{
+    for (int i = 0; i < num_images; ++i) {
+        char cache_name[1024];
+        snprintf(cache_name, sizeof(cache_name), "%s.texcache", images[i]);
+        remove(cache_name);
+    }
+}
+
+// Seconds to load all images through the cache, or -1 if any result is not the expected one.
+static double time_texcache(const char** images, int num_images, TexCacheResult expected)
+{
+    uint32_t sum = 0;
+    double start = now_seconds();
+    for (int i = 0; i < num_images; ++i) {
+        int w, h, n;
+        TexCacheResult result;
+        uint8_t* texels = texcache_load(images[i], &w, &h, &n, &result);
+        if (!texels || result != expected) {
+            printf("%s: unexpected cache result %d\n", images[i], (int)result);
+            return -1;
+        }
+        sum += touch(texels, (size_t)w * h * n);
+        if (result == TexCacheResult::MISS) {
+            stbi_image_free(texels);
+        }
+    }
+    double elapsed = now_seconds() - start;
+    g_sink += sum;
+    texcache_release_all();
+    return elapsed;
+}
+
+static bool check_texels(const char** images, int num_images)
+{
+    bool ok = true;
+    for (int i = 0; i < num_images && ok; ++i) {
+        int w, h, n, cw, ch, cn;
+        uint8_t* expected = stbi_load(images[i], &w, &h, &n, 0);
+        uint8_t* cached = texcache_load(images[i], &cw, &ch, &cn);
+        ok = expected && cached && w == cw && h == ch && n == cn &&
+             memcmp(expected, cached, (size_t)w * h * n) == 0;
+        stbi_image_free(expected);
+    }
+    texcache_release_all();
+    return ok;
+}
+
+// Moves the first image's mtime forward, which should cost a hash and not a decode.
+static bool check_rehash(const char* image)
+{
+    struct stat st;
+    if (stat(image, &st) != 0) {
+        return false;
+    }
+#if defined(_WIN32)
+    struct _utimbuf times = { st.st_atime, st.st_mtime + 10 };
+    int err = _utime(image, &times);
+#else
+    struct utimbuf times = { st.st_atime, st.st_mtime + 10 };
+    int err = utime(image, &times);
+#endif
+    if (err != 0) {
+        return false;
+    }
+    int w, h, n;
+    TexCacheResult first, second;
+    texcache_load(image, &w, &h, &n, &first);
+    texcache_load(image, &w, &h, &n, &second);
+    texcache_release_all();
+    return first == TexCacheResult::HIT_REHASHED && second == TexCacheResult::HIT;
+}
+
+int main(int argc, char** argv)
+{
+    const char** images = k_game_images;
+    int num_images = (int)(sizeof(k_game_images) / sizeof(k_game_images[0]));
+    if (argc > 1) {
+        images = (const char**)argv + 1;
+        num_images = argc - 1;
+    }
+
+    size_t total_texels = 0;
+    double start = now_seconds();
+    for (int i = 0; i < num_images; ++i) {
+        int w, h, n;
+        uint8_t* texels = stbi_load(images[i], &w, &h, &n, 0);
+        if (!texels) {
+            printf("%s: could not load\n", images[i]);
+            return EXIT_FAILURE;
+        }
+        total_texels += (size_t)w * h * n;
+        stbi_image_free(texels);
+    }
+    double t_stbi = now_seconds() - start;
+
+    remove_caches(images, num_images);
+    double t_cold = time_texcache(images, num_images, TexCacheResult::MISS);
+    double t_warm = 1e9;
+    for (int run = 0; run < k_warm_runs && t_cold >= 0; ++run) {
+        double t = time_texcache(images, num_images, TexCacheResult::HIT);
+        if (t < 0) {
+            return EXIT_FAILURE;
+        }
+        t_warm = t < t_warm ? t : t_warm;
+    }
+    if (t_cold < 0) {
+        return EXIT_FAILURE;
+    }
+
+    printf("%d images, %.1f MB of texels\n", num_images, total_texels / (1024.0 * 1024.0));
+    printf("  stbi_load   %8.2f ms\n", t_stbi * 1000);
+    printf("  cold cache  %8.2f ms  (decode and write)\n", t_cold * 1000);
+    printf("  warm cache  %8.2f ms  (best of %d, %.1fx faster than stbi_load)\n",
+           t_warm * 1000, k_warm_runs, t_stbi / t_warm);
+
+    bool texels_ok = check_texels(images, num_images);
+    bool rehash_ok = check_rehash(images[0]);
+    printf("  cached texels match stbi_load %s\n", texels_ok ? "ok" : "FAILED");
+    printf("  touched mtime keeps the cache %s\n", rehash_ok ? "ok" : "FAILED");
+    return texels_ok && rehash_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
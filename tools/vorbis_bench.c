@@ -0,0 +1,321 @@
+// vorbis_bench - check stb_vorbis' inverse MDCT and time full decodes.
+//
+// For every file:
+//   - runs inverse_mdct on random spectra for both block sizes and compares
+//     it with a direct O(n^2) evaluation of the IMDCT,
+//   - decodes the whole file a few times from memory and reports how many
+//     times faster than realtime that is,
+//   - checks that the file opens and decodes out of a buffer of exactly
+//     stb_vorbis_memory_required() bytes, and not out of one any smaller,
+//   - seeks to random positions through stdio with and without a seek table
+//     (stb_vorbis_build_seek_table), checks both land on the same samples and
+//     round-trips the table through a sidecar file.
+//
+// Usage: vorbis_bench [file.ogg ...]     (defaults to the game's assets)
+//
+// Build from the repo root:
+//   cl /O2 tools\vorbis_bench.c                   (add /arch:AVX2 for the AVX path)
+//   cc -O2 -msse2 tools/vorbis_bench.c -o vorbis_bench -lm
+// Define STB_VORBIS_NO_SIMD to compare against the scalar butterflies, and
+// STB_VORBIS_PROFILE to get a per-stage breakdown of the decode.
+
+#include "../stb/stb_vorbis.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+static double now_seconds()
+{
+   LARGE_INTEGER freq, t;
+   QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&t);
+   return (double)t.QuadPart / (double)freq.QuadPart;
+}
+#else
+#include <time.h>
+static double now_seconds()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+#endif
+
+#define NUM_DECODE_RUNS 5
+#define NUM_IMDCT_TRIALS 4
+#define NUM_SEEKS 200
+#define SEEK_CHECK_SAMPLES 64
+
+#ifdef STB_VORBIS_PROFILE
+static void print_profile(stb_vorbis_profile *p)
+{
+   static const char *stage_names[STB_VORBIS_PROFILE_stages] = { "floor", "residue", "coupling", "imdct" };
+   double total = 0;
+   unsigned int lookups = p->huffman_fast + p->huffman_pairs + p->huffman_slow;
+   int i;
+   for (i=0; i < STB_VORBIS_PROFILE_stages; ++i)
+      total += p->ticks[i];
+   printf("  stages:");
+   for (i=0; i < STB_VORBIS_PROFILE_stages; ++i)
+      printf(" %s %.1f%%", stage_names[i], total > 0 ? p->ticks[i] * 100 / total : 0);
+   printf("\n");
+   printf("  huffman lookups: %u fast, %u pairs, %u slow (%.1f%% of lookups were pairs)\n",
+          p->huffman_fast, p->huffman_pairs, p->huffman_slow, lookups ? p->huffman_pairs * 100.0 / lookups : 0);
+}
+#endif
+
+static const char *simd_name()
+{
+#if defined(STB_VORBIS_AVX)
+   return "AVX";
+#elif defined(STB_VORBIS_SSE2)
+   return "SSE2";
+#elif defined(STB_VORBIS_NEON)
+   return "NEON";
+#else
+   return "scalar";
+#endif
+}
+
+// The formula inverse_mdct matches, taken from the disabled inverse_mdct_slow
+// in stb_vorbis.c (without any normalization, as noted there).
+static void inverse_mdct_reference(const float *in, double *out, int n)
+{
+   int i, j, n2 = n >> 1;
+   for (i=0; i < n; ++i) {
+      double acc = 0;
+      for (j=0; j < n2; ++j)
+         acc += in[j] * cos(M_PI / 2 / n * (2 * i + 1 + n/2.0)*(2*j+1));
+      out[i] = acc;
+   }
+}
+
+// Returns the worst error relative to the largest output sample.
+static double check_imdct(stb_vorbis *f, int blocktype)
+{
+   int n = f->blocksize[blocktype];
+   float  *buffer    = (float  *) malloc(n * sizeof(float));
+   float  *spectrum  = (float  *) malloc(n * sizeof(float));
+   double *reference = (double *) malloc(n * sizeof(double));
+   double worst = 0;
+   int trial, i;
+
+   for (trial=0; trial < NUM_IMDCT_TRIALS; ++trial) {
+      double max_err = 0, max_ref = 0;
+      for (i=0; i < n; ++i)
+         spectrum[i] = i < n/2 ? (float) rand() / RAND_MAX * 2 - 1 : 0;
+      memcpy(buffer, spectrum, n * sizeof(float));
+
+      inverse_mdct(buffer, n, f, blocktype);
+      inverse_mdct_reference(spectrum, reference, n);
+
+      for (i=0; i < n; ++i) {
+         double err = fabs(buffer[i] - reference[i]);
+         if (err > max_err) max_err = err;
+         if (fabs(reference[i]) > max_ref) max_ref = fabs(reference[i]);
+      }
+      if (max_err / max_ref > worst)
+         worst = max_err / max_ref;
+   }
+
+   free(buffer);
+   free(spectrum);
+   free(reference);
+   return worst;
+}
+
+static unsigned char *read_file(const char *filename, int *len)
+{
+   unsigned char *data;
+   FILE *fp = fopen(filename, "rb");
+   if (!fp) return NULL;
+   fseek(fp, 0, SEEK_END);
+   *len = (int) ftell(fp);
+   fseek(fp, 0, SEEK_SET);
+   data = (unsigned char *) malloc(*len);
+   if (data && fread(data, 1, *len, fp) != (size_t) *len) {
+      free(data);
+      data = NULL;
+   }
+   fclose(fp);
+   return data;
+}
+
+static int bench_file(const char *filename)
+{
+   int len, error, run, blocktype;
+   unsigned char *data = read_file(filename, &len);
+   stb_vorbis *f;
+   stb_vorbis_info info;
+   double best = 1e30, seconds_of_audio;
+   int ok = 1;
+
+   if (!data) {
+      printf("%s: could not read file\n", filename);
+      return 0;
+   }
+   f = stb_vorbis_open_memory(data, len, &error, NULL);
+   if (!f) {
+      printf("%s: stb_vorbis error %d\n", filename, error);
+      free(data);
+      return 0;
+   }
+   info = stb_vorbis_get_info(f);
+   seconds_of_audio = (double) stb_vorbis_stream_length_in_samples(f) / info.sample_rate;
+   printf("%s: %d channels, %d Hz, %.2f s\n", filename, info.channels, info.sample_rate, seconds_of_audio);
+
+   for (blocktype=0; blocktype < 2; ++blocktype) {
+      double err = check_imdct(f, blocktype);
+      int pass = err < 1e-4;
+      printf("  imdct n=%-5d max relative error %.2e %s\n", f->blocksize[blocktype], err, pass ? "ok" : "FAILED");
+      ok = ok && pass;
+   }
+
+   for (run=0; run < NUM_DECODE_RUNS; ++run) {
+      float **outputs;
+      double start = now_seconds(), elapsed;
+      stb_vorbis_seek_start(f);
+      #ifdef STB_VORBIS_PROFILE
+      stb_vorbis_reset_profile(f);
+      #endif
+      while (stb_vorbis_get_frame_float(f, NULL, &outputs) > 0)
+         ;
+      elapsed = now_seconds() - start;
+      if (elapsed < best) best = elapsed;
+   }
+   printf("  decode %.2f ms, %.1fx realtime (best of %d)\n", best * 1000, seconds_of_audio / best, NUM_DECODE_RUNS);
+   #ifdef STB_VORBIS_PROFILE
+   {
+      stb_vorbis_profile profile = stb_vorbis_get_profile(f);
+      print_profile(&profile);
+   }
+   #endif
+
+   {
+      int required = stb_vorbis_memory_required(data, len, &error);
+      stb_vorbis_alloc arena, short_arena;
+      stb_vorbis *g, *h;
+      int exact;
+      arena.alloc_buffer = (char *) malloc(required);
+      arena.alloc_buffer_length_in_bytes = required;
+      short_arena.alloc_buffer = (char *) malloc(required);
+      short_arena.alloc_buffer_length_in_bytes = required - 4;
+      g = stb_vorbis_open_memory(data, len, &error, &arena);
+      h = stb_vorbis_open_memory(data, len, &error, &short_arena);
+      exact = g != NULL && h == NULL;
+      if (g) {
+         float **outputs;
+         unsigned int decoded = 0;
+         int n;
+         while ((n = stb_vorbis_get_frame_float(g, NULL, &outputs)) > 0)
+            decoded += n;
+         exact = exact && decoded > 0 && stb_vorbis_get_error(g) == VORBIS__no_error;
+      }
+      printf("  memory required %d bytes (setup %u, temp %u) %s\n", required,
+             info.setup_memory_required, info.temp_memory_required, exact ? "ok" : "FAILED");
+      ok = ok && exact;
+      stb_vorbis_close(g);
+      stb_vorbis_close(h);
+      free(arena.alloc_buffer);
+      free(short_arena.alloc_buffer);
+   }
+
+   stb_vorbis_close(f);
+   free(data);
+   return ok;
+}
+
+// Seek to random positions with and without the table and compare what the
+// next few samples are.
+static int bench_seek(const char *filename)
+{
+   char sidecar[1024];
+   int error, i, count, ok = 1, mismatches = 0;
+   unsigned int length, *positions;
+   double start, build_time, probe_time = 0, table_time = 0;
+   stb_vorbis *probed = stb_vorbis_open_filename(filename, &error, NULL);
+   stb_vorbis *tabled = stb_vorbis_open_filename(filename, &error, NULL);
+   stb_vorbis *loaded;
+
+   if (!probed || !tabled) {
+      printf("  seek: could not open %s\n", filename);
+      stb_vorbis_close(probed);
+      stb_vorbis_close(tabled);
+      return 0;
+   }
+
+   start = now_seconds();
+   count = stb_vorbis_build_seek_table(tabled);
+   build_time = now_seconds() - start;
+   length = stb_vorbis_stream_length_in_samples(probed);
+   if (count == 0 || stb_vorbis_stream_length_in_samples(tabled) != length) {
+      printf("  seek table: FAILED to build\n");
+      ok = 0;
+   }
+
+   positions = (unsigned int *) malloc(NUM_SEEKS * sizeof(*positions));
+   for (i=0; i < NUM_SEEKS; ++i)
+      positions[i] = (unsigned int) (((double) rand() / RAND_MAX) * (length - SEEK_CHECK_SAMPLES));
+
+   for (i=0; ok && i < NUM_SEEKS; ++i) {
+      short a[SEEK_CHECK_SAMPLES * 2], b[SEEK_CHECK_SAMPLES * 2];
+      int ra, rb, na = 0, nb = 0;
+
+      start = now_seconds();
+      ra = stb_vorbis_seek(probed, positions[i]);
+      probe_time += now_seconds() - start;
+      start = now_seconds();
+      rb = stb_vorbis_seek(tabled, positions[i]);
+      table_time += now_seconds() - start;
+
+      if (ra) na = stb_vorbis_get_samples_short_interleaved(probed, 2, a, SEEK_CHECK_SAMPLES * 2);
+      if (rb) nb = stb_vorbis_get_samples_short_interleaved(tabled, 2, b, SEEK_CHECK_SAMPLES * 2);
+      if (ra != rb || na != nb || memcmp(a, b, na * 2 * sizeof(short)))
+         ++mismatches;
+   }
+   free(positions);
+   printf("  seek table: %d pages, built in %.2f ms\n", count, build_time * 1000);
+   printf("  seek: %.1f us probing, %.1f us with table (mean of %d), %d mismatches\n",
+          probe_time * 1e6 / NUM_SEEKS, table_time * 1e6 / NUM_SEEKS, NUM_SEEKS, mismatches);
+   ok = ok && mismatches == 0;
+
+   sprintf(sidecar, "%.1000s.seek", filename);
+   loaded = stb_vorbis_open_filename(filename, &error, NULL);
+   if (!stb_vorbis_save_seek_table(tabled, sidecar) || !loaded || !stb_vorbis_load_seek_table(loaded, sidecar)) {
+      printf("  seek table sidecar: FAILED\n");
+      ok = 0;
+   } else {
+      int loaded_count;
+      const stb_vorbis_seek_entry *entries = stb_vorbis_get_seek_table(loaded, &loaded_count);
+      int same = loaded_count == count
+         && !memcmp(entries, stb_vorbis_get_seek_table(tabled, NULL), count * sizeof(*entries));
+      printf("  seek table sidecar: %s\n", same ? "ok" : "FAILED");
+      ok = ok && same;
+   }
+   remove(sidecar);
+
+   stb_vorbis_close(loaded);
+   stb_vorbis_close(probed);
+   stb_vorbis_close(tabled);
+   return ok;
+}
+
+int main(int argc, char **argv)
+{
+   static const char *default_files[] = { "loop.ogg", "duke.ogg" };
+   const char **files = (const char **) argv + 1;
+   int num_files = argc - 1, i, ok = 1;
+
+   if (num_files == 0) {
+      files = default_files;
+      num_files = sizeof(default_files) / sizeof(default_files[0]);
+   }
+
+   printf("inverse MDCT butterflies: %s\n", simd_name());
+   for (i=0; i < num_files; ++i)
+      ok = bench_file(files[i]) && bench_seek(files[i]) && ok;
+   return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}